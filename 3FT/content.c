@@ -0,0 +1,1092 @@
+/*--------------------------------------------------------------------*/
+/* content.c                                                          */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+/* for mmap, and pthreads, under a strict ISO C compilation */
+#define _POSIX_C_SOURCE 200112L
+
+#ifdef FT_THREADSAFE
+#include <pthread.h>
+#endif
+
+#include <stddef.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lz.h"
+#include "content.h"
+
+/* The number of bytes in each chunk of a chunked buffer */
+enum { CHUNK_SIZE = 65536 };
+
+/* The number of buckets a store starts with; it doubles whenever the
+   buffers outnumber the buckets. */
+enum { INITIAL_BUCKETS = 64 };
+
+/*
+  One chunk of a chunked buffer, allocated as a single block together
+  with its CHUNK_SIZE bytes, which follow it. A chunk may be shared by
+  several buffers, and is changed in place only while it is not.
+*/
+struct chunk {
+    /* the number of buffers holding the chunk */
+    size_t ulRefs;
+};
+
+/*
+  A buffer of file contents. A flat buffer is allocated as a single
+  block together with its bytes, which follow it; a chunked buffer
+  keeps its bytes in a table of chunks.
+*/
+struct content {
+    /* the number of references held */
+    size_t ulRefs;
+    /* the number of bytes */
+    size_t ulLength;
+    /* for a flat buffer, the number of bytes there is room for; for
+       a compressed one, the number of bytes of the compressed form;
+       for a chunked one, the number of slots in psChunks */
+    size_t ulCapacity;
+    /* TRUE until the buffer is frozen */
+    boolean bWritable;
+    /* TRUE if the buffer keeps its bytes in chunks */
+    boolean bChunked;
+    /* TRUE if the block following the buffer holds its bytes in the
+       compressed form LZ_compress writes */
+    boolean bCompressed;
+    /* the mapping of a host file the bytes are in, its length, and
+       where in it they start, or NULL if the buffer is not mapped */
+    void *pvMapping;
+    size_t ulMappingLength;
+    size_t ulMappingOffset;
+    /* the buffer that owns the mapping, for a slice of one, or NULL if
+       the buffer owns its mapping or has none */
+    Content_T oMappedFrom;
+    /* the chunks, each NULL if no byte in it has been written, so that
+       it reads as zeros; the bytes after the end of the buffer in its
+       last chunk are always zero */
+    struct chunk **ppsChunks;
+    /* the store the buffer was interned in, or NULL if none; and, if
+       there is one, the hash of the bytes and the next buffer in the
+       same bucket of the store */
+    ContentStore_T oStore;
+    size_t ulHash;
+    Content_T oNextStored;
+};
+
+/* A chained hash table of interned buffers */
+struct contentStore {
+#ifdef FT_THREADSAFE
+    /* serializes changes to and searches of the table */
+    pthread_mutex_t sLock;
+#endif
+    /* the number of references held: the creator's, until it
+       releases the store, and one for each buffer in it */
+    size_t ulRefs;
+    /* the buckets, and the number of them (a power of 2) */
+    Content_T *poBuckets;
+    size_t ulBuckets;
+    /* the number of buffers in the table, and their bytes */
+    size_t ulContents;
+    size_t ulStoredBytes;
+    /* the number of references held to those buffers, and the bytes
+       they would take unshared; changed without the lock */
+    size_t ulReferences;
+    size_t ulReferencedBytes;
+};
+
+/* ------------------------------------------------------------------ */
+
+/*
+  Returns a new chunk holding CHUNK_SIZE bytes copied from pcBytes, or
+  zeros if pcBytes is NULL, and held by one buffer; or NULL if memory
+  could not be allocated.
+*/
+static struct chunk *Content_newChunk(const char *pcBytes) {
+    struct chunk *psChunk;
+
+    if(pcBytes == NULL)
+        return calloc(1, sizeof(struct chunk) + CHUNK_SIZE);
+
+    psChunk = malloc(sizeof(struct chunk) + CHUNK_SIZE);
+    if(psChunk == NULL)
+        return NULL;
+    memcpy(psChunk + 1, pcBytes, CHUNK_SIZE);
+    psChunk->ulRefs = 1;
+    return psChunk;
+}
+
+/* Releases one buffer's hold on psChunk, freeing it if that was the
+   last. */
+static void Content_releaseChunk(struct chunk *psChunk) {
+    assert(psChunk != NULL);
+
+#ifdef FT_THREADSAFE
+    if(__atomic_sub_fetch(&psChunk->ulRefs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(psChunk);
+#else
+    if(--psChunk->ulRefs == 0)
+        free(psChunk);
+#endif
+}
+
+/*
+  Makes chunk ulIndex of writable, chunked oContent one that oContent
+  alone holds, allocating it if it was never written and copying it
+  if it is shared. Returns SUCCESS, or MEMORY_ERROR, in which case the
+  chunk is unchanged.
+*/
+static int Content_ownChunk(Content_T oContent, size_t ulIndex) {
+    struct chunk *psChunk;
+    struct chunk *psCopy;
+
+    assert(oContent != NULL);
+    assert(ulIndex < oContent->ulCapacity);
+
+    psChunk = oContent->ppsChunks[ulIndex];
+    if(psChunk != NULL &&
+#ifdef FT_THREADSAFE
+       __atomic_load_n(&psChunk->ulRefs, __ATOMIC_ACQUIRE) == 1
+#else
+       psChunk->ulRefs == 1
+#endif
+       )
+        return SUCCESS;
+
+    psCopy = Content_newChunk(psChunk == NULL ? NULL
+                                              : (char *) (psChunk + 1));
+    if(psCopy == NULL)
+        return MEMORY_ERROR;
+    psCopy->ulRefs = 1;
+    if(psChunk != NULL)
+        Content_releaseChunk(psChunk);
+    oContent->ppsChunks[ulIndex] = psCopy;
+    return SUCCESS;
+}
+
+/*
+  Makes room in chunked oContent's table for at least ulSlots chunks,
+  at least doubling it if it grows. Returns SUCCESS, or MEMORY_ERROR,
+  in which case oContent is unchanged.
+*/
+static int Content_growChunks(Content_T oContent, size_t ulSlots) {
+    struct chunk **ppsChunks;
+    size_t ulCapacity;
+
+    assert(oContent != NULL);
+
+    if(ulSlots <= oContent->ulCapacity)
+        return SUCCESS;
+
+    ulCapacity = 2 * oContent->ulCapacity;
+    if(ulCapacity < ulSlots)
+        ulCapacity = ulSlots;
+    if(ulCapacity > ((size_t) -1) / sizeof(struct chunk *))
+        return MEMORY_ERROR;
+    ppsChunks = realloc(oContent->ppsChunks,
+                        ulCapacity * sizeof(struct chunk *));
+    if(ppsChunks == NULL)
+        return MEMORY_ERROR;
+
+    memset(ppsChunks + oContent->ulCapacity, 0,
+           (ulCapacity - oContent->ulCapacity) *
+           sizeof(struct chunk *));
+    oContent->ppsChunks = ppsChunks;
+    oContent->ulCapacity = ulCapacity;
+    return SUCCESS;
+}
+
+/*
+  Returns a new, empty, writable chunked buffer with a single
+  reference, or NULL if memory could not be allocated.
+*/
+static Content_T Content_newEmptyChunked(void) {
+    Content_T oContent;
+
+    oContent = malloc(sizeof(struct content));
+    if(oContent == NULL)
+        return NULL;
+
+    oContent->ulRefs = 1;
+    oContent->ulLength = 0;
+    oContent->ulCapacity = 0;
+    oContent->bWritable = TRUE;
+    oContent->bChunked = TRUE;
+    oContent->bCompressed = FALSE;
+    oContent->pvMapping = NULL;
+    oContent->oMappedFrom = NULL;
+    oContent->ppsChunks = NULL;
+    oContent->oStore = NULL;
+    oContent->ulHash = 0;
+    oContent->oNextStored = NULL;
+    return oContent;
+}
+
+/* Acquires oStore's lock. */
+static void ContentStore_lock(ContentStore_T oStore) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_lock(&oStore->sLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oStore;
+#endif
+}
+
+/* Releases oStore's lock. */
+static void ContentStore_unlock(ContentStore_T oStore) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_unlock(&oStore->sLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oStore;
+#endif
+}
+
+/*
+  Counts one reference to a buffer of ulLength bytes in oStore as
+  taken, if bTaken is TRUE, or as released.
+*/
+static void ContentStore_count(ContentStore_T oStore, size_t ulLength,
+                               boolean bTaken) {
+    size_t ulOne = 1;
+
+    assert(oStore != NULL);
+
+    /* subtracting is adding the two's complement */
+    if(!bTaken) {
+        ulOne = (size_t) -1;
+        ulLength = (size_t) 0 - ulLength;
+    }
+#ifdef FT_THREADSAFE
+    (void) __atomic_fetch_add(&oStore->ulReferences, ulOne,
+                              __ATOMIC_RELAXED);
+    (void) __atomic_fetch_add(&oStore->ulReferencedBytes, ulLength,
+                              __ATOMIC_RELAXED);
+#else
+    oStore->ulReferences += ulOne;
+    oStore->ulReferencedBytes += ulLength;
+#endif
+}
+
+/*
+  Unlinks oContent, whose last reference has just been released, from
+  the store it was interned in.
+*/
+static void ContentStore_remove(Content_T oContent) {
+    ContentStore_T oStore;
+    Content_T *poLink;
+
+    assert(oContent != NULL);
+    assert(oContent->oStore != NULL);
+
+    oStore = oContent->oStore;
+    ContentStore_lock(oStore);
+    poLink = &oStore->poBuckets[oContent->ulHash &
+                                (oStore->ulBuckets - 1)];
+    while(*poLink != oContent)
+        poLink = &(*poLink)->oNextStored;
+    *poLink = oContent->oNextStored;
+    oStore->ulContents--;
+    oStore->ulStoredBytes -= oContent->ulLength;
+    ContentStore_unlock(oStore);
+}
+
+/* Returns the bytes of flat or compressed oContent. */
+static char *Content_bytes(Content_T oContent) {
+    assert(oContent != NULL);
+    assert(!oContent->bChunked);
+
+    if(oContent->pvMapping != NULL)
+        return (char *) oContent->pvMapping + oContent->ulMappingOffset;
+    return (char *) (oContent + 1);
+}
+
+/*
+  Decompresses the bytes of compressed oContent into flat, writable
+  oDest, which has room for them.
+*/
+static void Content_inflate(Content_T oContent, Content_T oDest) {
+    size_t ulLength;
+
+    assert(oContent != NULL);
+    assert(oContent->bCompressed);
+    assert(oDest != NULL);
+    assert(oDest->ulCapacity >= oContent->ulLength);
+
+    ulLength = LZ_decompress(Content_bytes(oContent),
+                             oContent->ulCapacity,
+                             oDest + 1, oContent->ulLength);
+    assert(ulLength == oContent->ulLength);
+    oDest->ulLength = ulLength;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_new(const void *pvData, size_t ulLength) {
+    Content_T oContent;
+
+    assert(pvData != NULL || ulLength == 0);
+
+    oContent = Content_newWritable(pvData, ulLength, ulLength);
+    if(oContent != NULL)
+        oContent->bWritable = FALSE;
+    return oContent;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_retain(Content_T oContent) {
+    assert(oContent != NULL);
+
+#ifdef FT_THREADSAFE
+    (void) __atomic_fetch_add(&oContent->ulRefs, 1, __ATOMIC_RELAXED);
+#else
+    oContent->ulRefs++;
+#endif
+    if(oContent->oStore != NULL)
+        ContentStore_count(oContent->oStore, oContent->ulLength, TRUE);
+    return oContent;
+}
+
+/* ------------------------------------------------------------------ */
+
+void Content_release(Content_T oContent) {
+    ContentStore_T oStore;
+    size_t i;
+
+    assert(oContent != NULL);
+
+    oStore = oContent->oStore;
+    if(oStore != NULL)
+        ContentStore_count(oStore, oContent->ulLength, FALSE);
+
+#ifdef FT_THREADSAFE
+    /* the last release must see every other holder's reads finished */
+    if(__atomic_sub_fetch(&oContent->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+#else
+    if(--oContent->ulRefs != 0)
+        return;
+#endif
+
+    if(oContent->bChunked) {
+        for(i = 0; i < oContent->ulCapacity; i++)
+            if(oContent->ppsChunks[i] != NULL)
+                Content_releaseChunk(oContent->ppsChunks[i]);
+        free(oContent->ppsChunks);
+    }
+    if(oStore != NULL)
+        ContentStore_remove(oContent);
+    if(oContent->oMappedFrom != NULL)
+        Content_release(oContent->oMappedFrom);
+    else if(oContent->pvMapping != NULL)
+        (void) munmap(oContent->pvMapping, oContent->ulMappingLength);
+    free(oContent);
+    if(oStore != NULL)
+        ContentStore_release(oStore);
+}
+
+/* ------------------------------------------------------------------ */
+
+const void *Content_getData(Content_T oContent) {
+    assert(oContent != NULL);
+
+    if(oContent->bChunked || oContent->bCompressed)
+        return NULL;
+    return Content_bytes(oContent);
+}
+
+/* ------------------------------------------------------------------ */
+
+size_t Content_getLength(Content_T oContent) {
+    assert(oContent != NULL);
+
+    return oContent->ulLength;
+}
+
+/* ------------------------------------------------------------------ */
+
+size_t Content_read(Content_T oContent, size_t ulOffset, size_t ulLength,
+                    void *pvDest) {
+    char *pcDest = pvDest;
+    size_t ulRead;
+
+    assert(oContent != NULL);
+    assert(!oContent->bCompressed);
+    assert(pvDest != NULL || ulLength == 0);
+
+    if(ulOffset >= oContent->ulLength)
+        return 0;
+    if(ulLength > oContent->ulLength - ulOffset)
+        ulLength = oContent->ulLength - ulOffset;
+    ulRead = ulLength;
+
+    if(!Content_isChunked(oContent)) {
+        memcpy(pcDest, Content_bytes(oContent) + ulOffset, ulLength);
+        return ulRead;
+    }
+
+    while(ulLength > 0) {
+        struct chunk *psChunk = oContent->ppsChunks[ulOffset / CHUNK_SIZE];
+        size_t ulStart = ulOffset % CHUNK_SIZE;
+        size_t ulPart = CHUNK_SIZE - ulStart;
+
+        if(ulPart > ulLength)
+            ulPart = ulLength;
+        if(psChunk == NULL)
+            memset(pcDest, 0, ulPart);
+        else
+            memcpy(pcDest, (char *) (psChunk + 1) + ulStart, ulPart);
+        pcDest += ulPart;
+        ulOffset += ulPart;
+        ulLength -= ulPart;
+    }
+    return ulRead;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_newWritable(const void *pvData, size_t ulLength,
+                              size_t ulCapacity) {
+    Content_T oContent;
+
+    assert(pvData != NULL || ulLength == 0);
+    assert(ulLength <= ulCapacity);
+
+    if(ulCapacity > (size_t) -1 - sizeof(struct content))
+        return NULL;
+    oContent = malloc(sizeof(struct content) + ulCapacity);
+    if(oContent == NULL)
+        return NULL;
+
+    oContent->ulRefs = 1;
+    oContent->ulLength = ulLength;
+    oContent->ulCapacity = ulCapacity;
+    oContent->bWritable = TRUE;
+    oContent->bChunked = FALSE;
+    oContent->bCompressed = FALSE;
+    oContent->pvMapping = NULL;
+    oContent->oMappedFrom = NULL;
+    oContent->ppsChunks = NULL;
+    oContent->oStore = NULL;
+    oContent->ulHash = 0;
+    oContent->oNextStored = NULL;
+    if(ulLength != 0)
+        memcpy(oContent + 1, pvData, ulLength);
+    return oContent;
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  Maps the ulLength (> 0) bytes at offset ulOffset of the file open as
+  iFd into a new buffer of that length with a single reference: read
+  only and private to the process if bShared is FALSE, or else
+  writable and shared with the file. Stores the buffer in *poContent
+  and returns SUCCESS, or else sets *poContent to NULL and returns
+  MEMORY_ERROR, or IO_ERROR if the bytes could not be mapped.
+*/
+static int Content_map(int iFd, size_t ulOffset, size_t ulLength,
+                       boolean bShared, Content_T *poContent) {
+    Content_T oContent;
+    long lPageSize;
+    size_t ulStart;
+    void *pvMapping;
+
+    assert(ulLength > 0);
+    assert(poContent != NULL);
+
+    *poContent = NULL;
+    lPageSize = sysconf(_SC_PAGESIZE);
+    if(lPageSize <= 0)
+        return IO_ERROR;
+    /* mappings start on a page boundary */
+    ulStart = ulOffset - ulOffset % (size_t) lPageSize;
+    if(ulLength > (size_t) -1 - (ulOffset - ulStart) ||
+       (off_t) ulStart < 0 || (size_t) (off_t) ulStart != ulStart)
+        return IO_ERROR;
+
+    oContent = Content_newWritable(NULL, 0, 0);
+    if(oContent == NULL)
+        return MEMORY_ERROR;
+
+    pvMapping = mmap(NULL, ulLength + (ulOffset - ulStart),
+                     bShared ? PROT_READ | PROT_WRITE : PROT_READ,
+                     bShared ? MAP_SHARED : MAP_PRIVATE, iFd,
+                     (off_t) ulStart);
+    if(pvMapping == MAP_FAILED) {
+        int iError = errno;
+
+        Content_release(oContent);
+        return iError == ENOMEM ? MEMORY_ERROR : IO_ERROR;
+    }
+
+    oContent->ulLength = ulLength;
+    oContent->ulCapacity = ulLength;
+    oContent->bWritable = FALSE;
+    oContent->pvMapping = pvMapping;
+    oContent->ulMappingLength = ulLength + (ulOffset - ulStart);
+    oContent->ulMappingOffset = ulOffset - ulStart;
+    *poContent = oContent;
+    return SUCCESS;
+}
+
+int Content_newMapped(int iFd, size_t ulOffset, size_t ulLength,
+                      Content_T *poContent) {
+    struct stat sStat;
+    int iStatus;
+
+    assert(poContent != NULL);
+
+    *poContent = NULL;
+    /* an empty mapping is not allowed, nor needed */
+    if(ulLength == 0) {
+        *poContent = Content_new(NULL, 0);
+        return *poContent == NULL ? MEMORY_ERROR : SUCCESS;
+    }
+
+    /* mapped pages past the end of the file fault when touched */
+    if(fstat(iFd, &sStat) != 0 || sStat.st_size < 0 ||
+       ulOffset > (size_t) sStat.st_size ||
+       ulLength > (size_t) sStat.st_size - ulOffset)
+        return IO_ERROR;
+
+    iStatus = Content_map(iFd, ulOffset, ulLength, FALSE, poContent);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    /* file contents are mostly read front to back; the hint only
+       tunes read-ahead, so failing to give it is harmless */
+    (void) posix_madvise((*poContent)->pvMapping,
+                         (*poContent)->ulMappingLength,
+                         POSIX_MADV_SEQUENTIAL);
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+int Content_newScratch(int iFd, size_t ulOffset, size_t ulCapacity,
+                       Content_T *poContent) {
+    int iStatus;
+
+    assert(ulCapacity > 0);
+    assert(poContent != NULL);
+
+    *poContent = NULL;
+    if(ulCapacity > (size_t) -1 - ulOffset ||
+       (off_t) (ulOffset + ulCapacity) < 0 ||
+       (size_t) (off_t) (ulOffset + ulCapacity) != ulOffset + ulCapacity)
+        return IO_ERROR;
+    /* give the bytes disk space now, so that running out of it fails
+       here rather than raising SIGBUS when they are written */
+    if(posix_fallocate(iFd, (off_t) ulOffset, (off_t) ulCapacity) != 0)
+        return IO_ERROR;
+
+    iStatus = Content_map(iFd, ulOffset, ulCapacity, TRUE, poContent);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    (*poContent)->ulLength = 0;
+    (*poContent)->bWritable = TRUE;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_newSlice(Content_T oContent, size_t ulOffset,
+                           size_t ulLength) {
+    Content_T oSlice;
+
+    assert(oContent != NULL);
+    assert(oContent->pvMapping != NULL);
+    assert(ulOffset <= oContent->ulLength);
+    assert(ulLength <= oContent->ulLength - ulOffset);
+
+    oSlice = Content_newWritable(NULL, 0, 0);
+    if(oSlice == NULL)
+        return NULL;
+
+    oSlice->ulLength = ulLength;
+    oSlice->bWritable = FALSE;
+    oSlice->pvMapping = oContent->pvMapping;
+    oSlice->ulMappingLength = 0;
+    oSlice->ulMappingOffset = oContent->ulMappingOffset + ulOffset;
+    /* hold the owner of the mapping, so that slices never chain */
+    oSlice->oMappedFrom = Content_retain(oContent->oMappedFrom != NULL
+                                         ? oContent->oMappedFrom
+                                         : oContent);
+    return oSlice;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_newChunked(const void *pvData, size_t ulLength) {
+    Content_T oContent;
+
+    assert(pvData != NULL || ulLength == 0);
+
+    oContent = Content_newEmptyChunked();
+    if(oContent == NULL)
+        return NULL;
+    if(Content_write(oContent, 0, pvData, ulLength) != SUCCESS) {
+        Content_release(oContent);
+        return NULL;
+    }
+    return oContent;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_newWritableCopy(Content_T oContent,
+                                  size_t ulCapacity) {
+    Content_T oCopy;
+    size_t i;
+
+    assert(oContent != NULL);
+
+    if(!Content_isChunked(oContent)) {
+        if(ulCapacity < oContent->ulLength)
+            ulCapacity = oContent->ulLength;
+        if(!oContent->bCompressed)
+            return Content_newWritable(Content_bytes(oContent),
+                                       oContent->ulLength,
+                                       ulCapacity);
+        oCopy = Content_newWritable(NULL, 0, ulCapacity);
+        if(oCopy != NULL)
+            Content_inflate(oContent, oCopy);
+        return oCopy;
+    }
+
+    oCopy = Content_newEmptyChunked();
+    if(oCopy == NULL)
+        return NULL;
+    if(Content_growChunks(oCopy, oContent->ulCapacity) != SUCCESS) {
+        Content_release(oCopy);
+        return NULL;
+    }
+    for(i = 0; i < oContent->ulCapacity; i++) {
+        struct chunk *psChunk = oContent->ppsChunks[i];
+
+        if(psChunk != NULL)
+#ifdef FT_THREADSAFE
+            (void) __atomic_fetch_add(&psChunk->ulRefs, 1,
+                                      __ATOMIC_RELAXED);
+#else
+            psChunk->ulRefs++;
+#endif
+        oCopy->ppsChunks[i] = psChunk;
+    }
+    oCopy->ulLength = oContent->ulLength;
+    return oCopy;
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Content_isWritable(Content_T oContent) {
+    assert(oContent != NULL);
+
+#ifdef FT_THREADSAFE
+    return __atomic_load_n(&oContent->bWritable, __ATOMIC_ACQUIRE);
+#else
+    return oContent->bWritable;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Content_isChunked(Content_T oContent) {
+    assert(oContent != NULL);
+
+    return oContent->bChunked;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_compress(Content_T oContent) {
+    Content_T oCompressed;
+    Content_T oShrunk;
+    size_t ulCompressed;
+
+    assert(oContent != NULL);
+    assert(!oContent->bChunked && !oContent->bCompressed);
+
+    if(oContent->ulLength < 2)
+        return NULL;
+    oCompressed = Content_newWritable(NULL, 0, oContent->ulLength - 1);
+    if(oCompressed == NULL)
+        return NULL;
+    ulCompressed = LZ_compress(Content_bytes(oContent), oContent->ulLength,
+                               oCompressed + 1, oContent->ulLength - 1);
+    if(ulCompressed == 0) {
+        Content_release(oCompressed);
+        return NULL;
+    }
+
+    /* no one else has seen the buffer yet, so it may move */
+    oShrunk = realloc(oCompressed,
+                      sizeof(struct content) + ulCompressed);
+    if(oShrunk != NULL)
+        oCompressed = oShrunk;
+    oCompressed->ulLength = oContent->ulLength;
+    oCompressed->ulCapacity = ulCompressed;
+    oCompressed->bWritable = FALSE;
+    oCompressed->bCompressed = TRUE;
+    return oCompressed;
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T Content_decompress(Content_T oContent) {
+    Content_T oFlat;
+
+    assert(oContent != NULL);
+    assert(oContent->bCompressed);
+
+    oFlat = Content_newWritable(NULL, 0, oContent->ulLength);
+    if(oFlat == NULL)
+        return NULL;
+    Content_inflate(oContent, oFlat);
+    oFlat->bWritable = FALSE;
+    return oFlat;
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Content_isCompressed(Content_T oContent) {
+    assert(oContent != NULL);
+
+    return oContent->bCompressed;
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Content_isMapped(Content_T oContent) {
+    assert(oContent != NULL);
+
+    return (boolean) (oContent->pvMapping != NULL);
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Content_isShared(Content_T oContent) {
+    assert(oContent != NULL);
+
+#ifdef FT_THREADSAFE
+    return (boolean)
+        (__atomic_load_n(&oContent->ulRefs, __ATOMIC_RELAXED) > 1);
+#else
+    return (boolean) (oContent->ulRefs > 1);
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+size_t Content_getFootprint(Content_T oContent) {
+    size_t ulFootprint = sizeof(struct content);
+    size_t i;
+
+    assert(oContent != NULL);
+
+    /* a mapping takes only page cache, which the kernel reclaims */
+    if(oContent->pvMapping != NULL)
+        return ulFootprint;
+    if(!oContent->bChunked)
+        return ulFootprint + oContent->ulCapacity;
+
+    ulFootprint += oContent->ulCapacity * sizeof(struct chunk *);
+    for(i = 0; i < oContent->ulCapacity; i++)
+        if(oContent->ppsChunks[i] != NULL)
+            ulFootprint += sizeof(struct chunk) + CHUNK_SIZE;
+    return ulFootprint;
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Content_hasRoom(Content_T oContent, size_t ulEnd) {
+    assert(oContent != NULL);
+
+    return (boolean) (Content_isChunked(oContent) ||
+                      ulEnd <= oContent->ulCapacity);
+}
+
+/* ------------------------------------------------------------------ */
+
+int Content_write(Content_T oContent, size_t ulOffset,
+                  const void *pvData, size_t ulLength) {
+    const char *pcData = pvData;
+    size_t ulFirst, ulEnd, i;
+    int iStatus;
+
+    assert(oContent != NULL);
+    assert(oContent->bWritable);
+    assert(pvData != NULL || ulLength == 0);
+    assert(ulLength <= (size_t) -1 - ulOffset);
+    assert(Content_hasRoom(oContent, ulOffset + ulLength));
+
+    if(!Content_isChunked(oContent)) {
+        char *pcBytes = Content_bytes(oContent);
+
+        if(ulOffset > oContent->ulLength)
+            memset(pcBytes + oContent->ulLength, 0,
+                   ulOffset - oContent->ulLength);
+        if(ulLength != 0)
+            memcpy(pcBytes + ulOffset, pvData, ulLength);
+        if(ulOffset + ulLength > oContent->ulLength)
+            oContent->ulLength = ulOffset + ulLength;
+        return SUCCESS;
+    }
+
+    if(ulLength == 0)
+        return SUCCESS;
+
+    /* make every chunk written to the buffer's own before changing any
+       byte, so that a failure leaves the bytes as they were */
+    ulFirst = ulOffset / CHUNK_SIZE;
+    ulEnd = (ulOffset + ulLength - 1) / CHUNK_SIZE + 1;
+    iStatus = Content_growChunks(oContent, ulEnd);
+    for(i = ulFirst; i < ulEnd && iStatus == SUCCESS; i++)
+        iStatus = Content_ownChunk(oContent, i);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    for(i = ulFirst; i < ulEnd; i++) {
+        size_t ulStart = (i == ulFirst) ? ulOffset % CHUNK_SIZE : 0;
+        size_t ulPart = CHUNK_SIZE - ulStart;
+
+        if(ulPart > ulLength)
+            ulPart = ulLength;
+        memcpy((char *) (oContent->ppsChunks[i] + 1) + ulStart, pcData,
+               ulPart);
+        pcData += ulPart;
+        ulLength -= ulPart;
+    }
+    if(ulOffset + (size_t) (pcData - (const char *) pvData) >
+       oContent->ulLength)
+        oContent->ulLength = ulOffset +
+                             (size_t) (pcData - (const char *) pvData);
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+void Content_freeze(Content_T oContent) {
+    assert(oContent != NULL);
+
+#ifdef FT_THREADSAFE
+    __atomic_store_n(&oContent->bWritable, FALSE, __ATOMIC_RELEASE);
+#else
+    oContent->bWritable = FALSE;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+/* Returns the FNV-1a hash of the ulLength bytes at pcData. */
+static size_t ContentStore_hash(const char *pcData, size_t ulLength) {
+    size_t ulHash = 2166136261UL;
+    size_t i;
+
+    assert(pcData != NULL || ulLength == 0);
+
+    for(i = 0; i < ulLength; i++) {
+        ulHash ^= (unsigned char) pcData[i];
+        ulHash *= 16777619UL;
+    }
+    return ulHash;
+}
+
+/*
+  Takes another reference to oContent, found in its store by a caller
+  holding the store's lock, unless its last reference has already
+  been released and it is about to leave the store. Returns TRUE if a
+  reference was taken.
+*/
+static boolean ContentStore_tryRetain(Content_T oContent) {
+#ifdef FT_THREADSAFE
+    size_t ulRefs;
+
+    assert(oContent != NULL);
+
+    ulRefs = __atomic_load_n(&oContent->ulRefs, __ATOMIC_RELAXED);
+    while(ulRefs != 0)
+        if(__atomic_compare_exchange_n(&oContent->ulRefs, &ulRefs,
+                                       ulRefs + 1, FALSE,
+                                       __ATOMIC_RELAXED,
+                                       __ATOMIC_RELAXED))
+            return TRUE;
+    return FALSE;
+#else
+    assert(oContent != NULL);
+
+    /* a buffer leaves its store as soon as it is released */
+    oContent->ulRefs++;
+    return TRUE;
+#endif
+}
+
+/*
+  Doubles the number of oStore's buckets, whose lock the caller holds.
+  If memory cannot be allocated, the table just stays as it is.
+*/
+static void ContentStore_grow(ContentStore_T oStore) {
+    Content_T *poBuckets;
+    size_t ulBuckets;
+    size_t i;
+
+    assert(oStore != NULL);
+
+    if(oStore->ulBuckets > ((size_t) -1) / (2 * sizeof(Content_T)))
+        return;
+    ulBuckets = 2 * oStore->ulBuckets;
+    poBuckets = calloc(ulBuckets, sizeof(Content_T));
+    if(poBuckets == NULL)
+        return;
+
+    for(i = 0; i < oStore->ulBuckets; i++) {
+        Content_T oContent = oStore->poBuckets[i];
+
+        while(oContent != NULL) {
+            Content_T oNext = oContent->oNextStored;
+            size_t ulBucket = oContent->ulHash & (ulBuckets - 1);
+
+            oContent->oNextStored = poBuckets[ulBucket];
+            poBuckets[ulBucket] = oContent;
+            oContent = oNext;
+        }
+    }
+    free(oStore->poBuckets);
+    oStore->poBuckets = poBuckets;
+    oStore->ulBuckets = ulBuckets;
+}
+
+/* ------------------------------------------------------------------ */
+
+ContentStore_T ContentStore_new(void) {
+    ContentStore_T oStore;
+
+    oStore = calloc(1, sizeof(struct contentStore));
+    if(oStore == NULL)
+        return NULL;
+    oStore->poBuckets = calloc(INITIAL_BUCKETS, sizeof(Content_T));
+    if(oStore->poBuckets == NULL) {
+        free(oStore);
+        return NULL;
+    }
+#ifdef FT_THREADSAFE
+    if(pthread_mutex_init(&oStore->sLock, NULL) != 0) {
+        free(oStore->poBuckets);
+        free(oStore);
+        return NULL;
+    }
+#endif
+    oStore->ulRefs = 1;
+    oStore->ulBuckets = INITIAL_BUCKETS;
+    return oStore;
+}
+
+/* ------------------------------------------------------------------ */
+
+void ContentStore_release(ContentStore_T oStore) {
+    assert(oStore != NULL);
+
+#ifdef FT_THREADSAFE
+    if(__atomic_sub_fetch(&oStore->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    (void) pthread_mutex_destroy(&oStore->sLock);
+#else
+    if(--oStore->ulRefs != 0)
+        return;
+#endif
+
+    /* every buffer has left, so the table is empty */
+    assert(oStore->ulContents == 0);
+    free(oStore->poBuckets);
+    free(oStore);
+}
+
+/* ------------------------------------------------------------------ */
+
+Content_T ContentStore_intern(ContentStore_T oStore, const void *pvData,
+                              size_t ulLength) {
+    Content_T oContent;
+    size_t ulHash;
+    size_t ulBucket;
+
+    assert(oStore != NULL);
+    assert(pvData != NULL || ulLength == 0);
+
+    ulHash = ContentStore_hash(pvData, ulLength);
+
+    ContentStore_lock(oStore);
+    ulBucket = ulHash & (oStore->ulBuckets - 1);
+    for(oContent = oStore->poBuckets[ulBucket]; oContent != NULL;
+        oContent = oContent->oNextStored)
+        if(oContent->ulHash == ulHash && oContent->ulLength == ulLength &&
+           (ulLength == 0 ||
+            memcmp(oContent + 1, pvData, ulLength) == 0) &&
+           ContentStore_tryRetain(oContent))
+            break;
+
+    if(oContent == NULL) {
+        oContent = Content_new(pvData, ulLength);
+        if(oContent == NULL) {
+            ContentStore_unlock(oStore);
+            return NULL;
+        }
+        oContent->oStore = oStore;
+        oContent->ulHash = ulHash;
+        oContent->oNextStored = oStore->poBuckets[ulBucket];
+        oStore->poBuckets[ulBucket] = oContent;
+        oStore->ulContents++;
+        oStore->ulStoredBytes += ulLength;
+#ifdef FT_THREADSAFE
+        (void) __atomic_fetch_add(&oStore->ulRefs, 1, __ATOMIC_RELAXED);
+#else
+        oStore->ulRefs++;
+#endif
+        if(oStore->ulContents > oStore->ulBuckets)
+            ContentStore_grow(oStore);
+    }
+    ContentStore_count(oStore, ulLength, TRUE);
+    ContentStore_unlock(oStore);
+
+    return oContent;
+}
+
+/* ------------------------------------------------------------------ */
+
+void ContentStore_getStats(ContentStore_T oStore,
+                           struct contentStoreStats *psStats) {
+    assert(oStore != NULL);
+    assert(psStats != NULL);
+
+    ContentStore_lock(oStore);
+    psStats->ulContents = oStore->ulContents;
+    psStats->ulStoredBytes = oStore->ulStoredBytes;
+    ContentStore_unlock(oStore);
+#ifdef FT_THREADSAFE
+    psStats->ulReferences =
+        __atomic_load_n(&oStore->ulReferences, __ATOMIC_RELAXED);
+    psStats->ulReferencedBytes =
+        __atomic_load_n(&oStore->ulReferencedBytes, __ATOMIC_RELAXED);
+#else
+    psStats->ulReferences = oStore->ulReferences;
+    psStats->ulReferencedBytes = oStore->ulReferencedBytes;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+ContentStore_T Content_getStore(Content_T oContent) {
+    assert(oContent != NULL);
+
+    return oContent->oStore;
+}
@@ -0,0 +1,265 @@
+/*--------------------------------------------------------------------*/
+/* content.h                                                          */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+#ifndef CONTENT_INCLUDED
+#define CONTENT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Content_T is an immutable, reference-counted buffer of file
+  contents. Whoever holds a reference may read the bytes until it
+  releases that reference; the buffer is freed when the last one is
+  released. Since the bytes never change (but see Content_newWritable),
+  one buffer may be shared by any number of files and readers without
+  copying it. In thread-safe
+  builds references may be taken and released from any thread.
+*/
+typedef struct content *Content_T;
+
+/*
+  Returns a new buffer holding a copy of the ulLength bytes at pvData
+  (which may be NULL if ulLength is 0), with a single reference owned
+  by the caller, or NULL if memory could not be allocated.
+*/
+Content_T Content_new(const void *pvData, size_t ulLength);
+
+/*
+  Sets *poContent to a new immutable buffer holding the ulLength bytes
+  at offset ulOffset of the host file open for reading as iFd, with a
+  single reference owned by the caller, and returns SUCCESS. The bytes
+  are mapped into memory rather than copied, so they are read from
+  disk only as they are used, take only page cache memory, and stay
+  mapped until the buffer is freed; iFd may be closed at once. The
+  host file must not be truncated meanwhile: reading bytes past its
+  new end raises SIGBUS. Whether later writes to it show through is
+  unspecified. Otherwise sets *poContent to NULL and returns
+  MEMORY_ERROR, or IO_ERROR if the file could not be mapped or does
+  not extend to ulOffset + ulLength.
+*/
+int Content_newMapped(int iFd, size_t ulOffset, size_t ulLength,
+                      Content_T *poContent);
+
+/*
+  Sets *poContent to a new, empty, writable buffer with room for
+  ulCapacity (> 0) bytes, with a single reference owned by the caller,
+  and returns SUCCESS. The bytes are kept at offset ulOffset of the
+  scratch file open for reading and writing as iFd, which is given
+  disk space for them at once, and mapped shared with it, so that the
+  system may write them out and drop them from memory. Writes may
+  only append to the buffer, and the bytes written may be handed out
+  meanwhile with Content_newSlice. Otherwise sets *poContent to NULL
+  and returns MEMORY_ERROR, or IO_ERROR if the file could not be
+  given the space or mapped.
+*/
+int Content_newScratch(int iFd, size_t ulOffset, size_t ulCapacity,
+                       Content_T *poContent);
+
+/*
+  Returns a new immutable buffer holding the ulLength bytes at offset
+  ulOffset of mapped buffer oContent, sharing its mapping rather than
+  copying them, with a single reference owned by the caller; or NULL
+  if memory could not be allocated. The mapping stays until the last
+  slice of it and oContent are all freed. The bytes must not change
+  while the slice is in use.
+*/
+Content_T Content_newSlice(Content_T oContent, size_t ulOffset,
+                           size_t ulLength);
+
+/* Takes another reference to oContent, and returns oContent. */
+Content_T Content_retain(Content_T oContent);
+
+/*
+  Releases a reference to oContent, freeing it if that was the last.
+  The caller must not use oContent afterwards.
+*/
+void Content_release(Content_T oContent);
+
+/*
+  Returns the bytes held in oContent, or NULL if it is chunked (see
+  Content_newChunked), in which case they must be read with
+  Content_read, or compressed (see Content_compress).
+*/
+const void *Content_getData(Content_T oContent);
+
+/* Returns the number of bytes held in oContent. */
+size_t Content_getLength(Content_T oContent);
+
+/*
+  Copies into pvDest up to ulLength of the bytes held in oContent,
+  which must not be compressed, starting ulOffset bytes in, and
+  returns how many were copied (fewer than ulLength only at the end of
+  oContent).
+*/
+size_t Content_read(Content_T oContent, size_t ulOffset, size_t ulLength,
+                    void *pvDest);
+
+/*
+  A writable buffer is the exception to immutability: its single
+  owner may change its bytes in place until it is frozen. Its owner
+  must make sure no one else reads it meanwhile, and freeze it before
+  handing out another reference.
+
+  A writable buffer is either flat, one block with room for a fixed
+  number of bytes, or chunked: a table of fixed-size chunks, allocated
+  only where bytes have been written (so a sparse file takes memory
+  only for the regions written), and shared between copies until a
+  write changes them. A write to a chunked buffer therefore touches
+  only the chunks it covers, and a chunked buffer never runs out of
+  room.
+*/
+
+/*
+  Returns a new writable buffer holding a copy of the ulLength bytes
+  at pvData (which may be NULL if ulLength is 0), with room for
+  ulCapacity bytes in all, and a single reference owned by the caller;
+  or NULL if memory could not be allocated. ulCapacity must be at
+  least ulLength.
+*/
+Content_T Content_newWritable(const void *pvData, size_t ulLength,
+                              size_t ulCapacity);
+
+/*
+  Returns a new chunked, writable buffer holding a copy of the
+  ulLength bytes at pvData (which may be NULL if ulLength is 0), with
+  a single reference owned by the caller, or NULL if memory could not
+  be allocated.
+*/
+Content_T Content_newChunked(const void *pvData, size_t ulLength);
+
+/*
+  Returns a new writable buffer holding the same bytes as oContent,
+  with a single reference owned by the caller, or NULL if memory could
+  not be allocated. If oContent is chunked, so is the copy, which
+  shares its chunks; otherwise the copy is flat (and decompressed),
+  with room for ulCapacity bytes or oContent's length, whichever is
+  more.
+*/
+Content_T Content_newWritableCopy(Content_T oContent,
+                                  size_t ulCapacity);
+
+/* Returns TRUE if oContent is writable, i.e., not yet frozen. */
+boolean Content_isWritable(Content_T oContent);
+
+/* Returns TRUE if oContent is chunked. */
+boolean Content_isChunked(Content_T oContent);
+
+/*
+  Returns TRUE if writable oContent has room for bytes up to offset
+  ulEnd, as a chunked buffer always does.
+*/
+boolean Content_hasRoom(Content_T oContent, size_t ulEnd);
+
+/*
+  Copies the ulLength bytes at pvData into writable oContent at
+  ulOffset, which must have room for them, extending its length if
+  they end beyond it. Any gap between the old length and ulOffset
+  reads as zero bytes. Returns SUCCESS, or MEMORY_ERROR if a chunk
+  could not be allocated, in which case oContent's bytes are
+  unchanged.
+*/
+int Content_write(Content_T oContent, size_t ulOffset,
+                  const void *pvData, size_t ulLength);
+
+/*
+  Makes oContent immutable for good. In thread-safe builds, whoever
+  sees it frozen also sees every write made to it before.
+*/
+void Content_freeze(Content_T oContent);
+
+/*
+  A compressed buffer is an immutable buffer whose bytes are kept in
+  the form LZ_compress (see lz.h) writes; its length is still that of
+  the bytes themselves. It must be decompressed to be read.
+*/
+
+/*
+  Returns a new compressed buffer holding the same bytes as oContent,
+  which must be flat and not compressed, with a single reference owned
+  by the caller; or NULL if compressing them would not save space or
+  memory could not be allocated.
+*/
+Content_T Content_compress(Content_T oContent);
+
+/*
+  Returns a new flat, immutable buffer holding the bytes of compressed
+  oContent, with a single reference owned by the caller, or NULL if
+  memory could not be allocated.
+*/
+Content_T Content_decompress(Content_T oContent);
+
+/* Returns TRUE if oContent is compressed. */
+boolean Content_isCompressed(Content_T oContent);
+
+/* Returns TRUE if oContent is mapped from a host or scratch file. */
+boolean Content_isMapped(Content_T oContent);
+
+/*
+  Returns TRUE if more than one reference to oContent is held. In
+  thread-safe builds the answer may be out of date by the time it is
+  returned, unless the caller knows no other reference can be taken.
+*/
+boolean Content_isShared(Content_T oContent);
+
+/* Returns the number of bytes of memory oContent takes. */
+size_t Content_getFootprint(Content_T oContent);
+
+/*
+  A ContentStore_T keeps one immutable, flat buffer for each distinct
+  run of bytes interned in it, so that any number of files with the
+  same contents share a single copy. A stored buffer leaves the store
+  when its last reference is released, and the store itself lives
+  until both its creator and every buffer in it have released it. In
+  thread-safe builds a store may be used from any thread.
+*/
+typedef struct contentStore *ContentStore_T;
+
+/* How much a store saves */
+struct contentStoreStats {
+    /* the number of distinct buffers in the store, and their bytes */
+    size_t ulContents;
+    size_t ulStoredBytes;
+    /* the number of references held to those buffers, and the bytes
+       they would take if each had its own copy */
+    size_t ulReferences;
+    size_t ulReferencedBytes;
+};
+
+/*
+  Returns a new, empty store, with a single reference owned by the
+  caller, or NULL if memory could not be allocated.
+*/
+ContentStore_T ContentStore_new(void);
+
+/*
+  Releases the caller's reference to oStore. Buffers already interned
+  keep it, and stay shared, until they are released themselves.
+*/
+void ContentStore_release(ContentStore_T oStore);
+
+/*
+  Returns a new reference, owned by the caller, to the buffer in
+  oStore holding the ulLength bytes at pvData (which may be NULL if
+  ulLength is 0), adding a frozen copy of them if there is none; or
+  NULL if memory could not be allocated. Buffers are found by a hash
+  of their bytes, confirmed by comparing them, so interning takes time
+  proportional to ulLength.
+*/
+Content_T ContentStore_intern(ContentStore_T oStore, const void *pvData,
+                              size_t ulLength);
+
+/*
+  Stores in *psStats what oStore holds now. In thread-safe builds the
+  counts may be slightly out of step with each other while buffers
+  are being interned or released.
+*/
+void ContentStore_getStats(ContentStore_T oStore,
+                           struct contentStoreStats *psStats);
+
+/* Returns the store oContent was interned in, or NULL if none. */
+ContentStore_T Content_getStore(Content_T oContent);
+
+#endif
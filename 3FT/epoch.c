@@ -0,0 +1,364 @@
+/*--------------------------------------------------------------------*/
+/* epoch.c                                                            */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+#ifdef FT_THREADSAFE
+/* for pthreads under a strict ISO C compilation */
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "a4def.h"
+#include "epoch.h"
+
+#ifdef FT_THREADSAFE
+
+/*
+  The global epoch advances only when every thread inside a critical
+  section has observed its current value. An object retired during
+  epoch e is kept on limbo list e % 3 and freed when the global epoch
+  next reaches a value congruent to e (three advances later), by which
+  time every reader that could have seen it has left.
+
+  Each thread first collects what it retires in a batch of its own,
+  and hands the batch to the limbo lists only once it is full, so that
+  most retires neither take sLimboLock nor scan the records. A batch
+  is listed under the epoch current when it is handed over, which is
+  never earlier than the one its objects were retired in.
+*/
+enum { NUM_LIMBO_LISTS = 3, BATCH_SIZE = 64 };
+
+/* An object awaiting reclamation */
+struct retired {
+    /* the object itself */
+    void *pvObject;
+    /* the function that frees it */
+    void (*pfFree)(void *pvObject);
+};
+
+/* Objects retired by one thread, reclaimed together */
+struct batch {
+    /* the number of entries of asRetired in use */
+    size_t ulCount;
+    /* the objects themselves, in the order they were retired */
+    struct retired asRetired[BATCH_SIZE];
+    /* the next batch on the same limbo list */
+    struct batch *psNext;
+};
+
+/* The per-thread state of a reader, written only by its owner */
+struct record {
+    /* the global epoch observed when the critical section began */
+    unsigned long ulEpoch;
+    /* TRUE while the owner is inside a critical section */
+    int iActive;
+    /* critical section nesting depth; private to the owner */
+    size_t ulNesting;
+    /* TRUE while some thread owns this record */
+    int iInUse;
+    /* the batch the owner is filling, or NULL; private to the owner */
+    struct batch *psBatch;
+    /* the next record ever registered */
+    struct record *psNext;
+    /* keeps records of different threads on different cache lines */
+    char acPad[64];
+};
+
+/* 1. the global epoch */
+static unsigned long ulGlobalEpoch;
+/* 2. every record ever registered, linked through psNext */
+static struct record *psRecords;
+/* 3. the batches waiting to be freed, one list per epoch mod 3 */
+static struct batch *apsLimbo[NUM_LIMBO_LISTS];
+/* 4. serializes retiring and advancing (writers only) */
+static pthread_mutex_t sLimboLock = PTHREAD_MUTEX_INITIALIZER;
+/* 5. finds the calling thread's record */
+static pthread_key_t sRecordKey;
+static pthread_once_t sRecordKeyOnce = PTHREAD_ONCE_INIT;
+
+/* ------------------------------------------------------------------ */
+
+static void Epoch_handOver(struct batch *psBatch);
+
+/*
+  Releases the record pvRecord of an exiting thread so that a later
+  thread may claim it, first handing over the batch it was filling.
+*/
+static void Epoch_releaseRecord(void *pvRecord) {
+    struct record *psRecord = pvRecord;
+
+    assert(psRecord != NULL);
+
+    if(psRecord->psBatch != NULL) {
+        Epoch_handOver(psRecord->psBatch);
+        psRecord->psBatch = NULL;
+    }
+    __atomic_store_n(&psRecord->iActive, FALSE, __ATOMIC_RELEASE);
+    __atomic_store_n(&psRecord->iInUse, FALSE, __ATOMIC_RELEASE);
+}
+
+/* Creates the key under which each thread's record is stored. */
+static void Epoch_createKey(void) {
+    (void) pthread_key_create(&sRecordKey, Epoch_releaseRecord);
+}
+
+/*
+  Returns the calling thread's record, claiming a released one or
+  registering a new one on first use. Returns NULL if a new record
+  could not be allocated.
+*/
+static struct record *Epoch_getRecord(void) {
+    struct record *psRecord;
+
+    (void) pthread_once(&sRecordKeyOnce, Epoch_createKey);
+
+    psRecord = pthread_getspecific(sRecordKey);
+    if(psRecord != NULL)
+        return psRecord;
+
+    /* try to reuse the record of a thread that has exited */
+    for(psRecord = __atomic_load_n(&psRecords, __ATOMIC_ACQUIRE);
+        psRecord != NULL; psRecord = psRecord->psNext) {
+        int iFree = FALSE;
+        if(__atomic_compare_exchange_n(&psRecord->iInUse, &iFree,
+                                       TRUE, FALSE, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_RELAXED))
+            break;
+    }
+
+    if(psRecord == NULL) {
+        psRecord = calloc(1, sizeof(struct record));
+        if(psRecord == NULL)
+            return NULL;
+        psRecord->iInUse = TRUE;
+        psRecord->psNext = __atomic_load_n(&psRecords,
+                                           __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&psRecords,
+                                           &psRecord->psNext, psRecord,
+                                           TRUE, __ATOMIC_RELEASE,
+                                           __ATOMIC_RELAXED))
+            ;
+    }
+
+    psRecord->ulNesting = 0;
+    if(pthread_setspecific(sRecordKey, psRecord) != 0) {
+        Epoch_releaseRecord(psRecord);
+        return NULL;
+    }
+    return psRecord;
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  Advances the global epoch if every active reader has observed it,
+  and if so detaches the limbo list that has become safe to free.
+  Returns that list (or NULL). sLimboLock must be held.
+*/
+static struct batch *Epoch_tryAdvance(void) {
+    struct record *psRecord;
+    struct batch *psFreeable;
+    unsigned long ulEpoch;
+
+    /* pairs with the fence in Epoch_enter */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    ulEpoch = __atomic_load_n(&ulGlobalEpoch, __ATOMIC_RELAXED);
+
+    for(psRecord = __atomic_load_n(&psRecords, __ATOMIC_ACQUIRE);
+        psRecord != NULL; psRecord = psRecord->psNext) {
+        if(__atomic_load_n(&psRecord->iActive, __ATOMIC_ACQUIRE) &&
+           __atomic_load_n(&psRecord->ulEpoch, __ATOMIC_RELAXED)
+           != ulEpoch)
+            return NULL;
+    }
+
+    ulEpoch++;
+    __atomic_store_n(&ulGlobalEpoch, ulEpoch, __ATOMIC_RELEASE);
+
+    psFreeable = apsLimbo[ulEpoch % NUM_LIMBO_LISTS];
+    apsLimbo[ulEpoch % NUM_LIMBO_LISTS] = NULL;
+    return psFreeable;
+}
+
+/* Frees every object in the limbo list psList, and the list itself. */
+static void Epoch_freeList(struct batch *psList) {
+    while(psList != NULL) {
+        struct batch *psNext = psList->psNext;
+        size_t i;
+
+        for(i = 0; i < psList->ulCount; i++)
+            (*psList->asRetired[i].pfFree)(psList->asRetired[i].pvObject);
+        free(psList);
+        psList = psNext;
+    }
+}
+
+/*
+  Adds psBatch, which its owner has finished filling, to the limbo
+  list of the current epoch, and frees whatever that makes safe.
+*/
+static void Epoch_handOver(struct batch *psBatch) {
+    struct batch *psFreeable;
+
+    assert(psBatch != NULL);
+
+    (void) pthread_mutex_lock(&sLimboLock);
+    psBatch->psNext = apsLimbo[ulGlobalEpoch % NUM_LIMBO_LISTS];
+    apsLimbo[ulGlobalEpoch % NUM_LIMBO_LISTS] = psBatch;
+    psFreeable = Epoch_tryAdvance();
+    (void) pthread_mutex_unlock(&sLimboLock);
+
+    Epoch_freeList(psFreeable);
+}
+
+/* Hands over the batch the calling thread is filling, if any. */
+static void Epoch_handOverOwn(void) {
+    struct record *psSelf;
+
+    (void) pthread_once(&sRecordKeyOnce, Epoch_createKey);
+    psSelf = pthread_getspecific(sRecordKey);
+    if(psSelf != NULL && psSelf->psBatch != NULL) {
+        Epoch_handOver(psSelf->psBatch);
+        psSelf->psBatch = NULL;
+    }
+}
+
+/*
+  Advances the global epoch if every active reader allows it, freeing
+  whatever that makes safe. Returns TRUE if it advanced.
+*/
+static boolean Epoch_advance(void) {
+    struct batch *psFreeable;
+    unsigned long ulBefore;
+    boolean bAdvanced;
+
+    (void) pthread_mutex_lock(&sLimboLock);
+    ulBefore = ulGlobalEpoch;
+    psFreeable = Epoch_tryAdvance();
+    bAdvanced = (boolean) (ulGlobalEpoch != ulBefore);
+    (void) pthread_mutex_unlock(&sLimboLock);
+
+    Epoch_freeList(psFreeable);
+    return bAdvanced;
+}
+
+/* ------------------------------------------------------------------ */
+
+int Epoch_enter(void) {
+    struct record *psRecord = Epoch_getRecord();
+
+    if(psRecord == NULL)
+        return MEMORY_ERROR;
+
+    if(psRecord->ulNesting++ == 0) {
+        __atomic_store_n(&psRecord->ulEpoch,
+                         __atomic_load_n(&ulGlobalEpoch,
+                                         __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
+        __atomic_store_n(&psRecord->iActive, TRUE, __ATOMIC_RELAXED);
+        /* publish activity before reading any shared object */
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+void Epoch_exit(void) {
+    struct record *psRecord = pthread_getspecific(sRecordKey);
+
+    assert(psRecord != NULL);
+    assert(psRecord->ulNesting > 0);
+
+    if(--psRecord->ulNesting == 0)
+        __atomic_store_n(&psRecord->iActive, FALSE, __ATOMIC_RELEASE);
+}
+
+/* ------------------------------------------------------------------ */
+
+void Epoch_retire(void *pvObject, void (*pfFree)(void *pvObject)) {
+    struct record *psSelf;
+    struct batch *psBatch;
+
+    assert(pfFree != NULL);
+
+    psSelf = Epoch_getRecord();
+    if(psSelf != NULL && psSelf->psBatch == NULL)
+        psSelf->psBatch = calloc(1, sizeof(struct batch));
+    if(psSelf == NULL || psSelf->psBatch == NULL) {
+        /* no room to defer: wait out every current reader instead,
+           unless that includes the caller, when it must leak */
+        if(psSelf == NULL || psSelf->ulNesting == 0) {
+            Epoch_drain();
+            (*pfFree)(pvObject);
+        }
+        return;
+    }
+
+    psBatch = psSelf->psBatch;
+    psBatch->asRetired[psBatch->ulCount].pvObject = pvObject;
+    psBatch->asRetired[psBatch->ulCount].pfFree = pfFree;
+    if(++psBatch->ulCount == BATCH_SIZE) {
+        psSelf->psBatch = NULL;
+        Epoch_handOver(psBatch);
+    }
+}
+
+/* ------------------------------------------------------------------ */
+
+void Epoch_drain(void) {
+    size_t ulAdvances = 0;
+
+    Epoch_handOverOwn();
+
+    /* every list is freed after NUM_LIMBO_LISTS advances */
+    while(ulAdvances < NUM_LIMBO_LISTS) {
+        if(Epoch_advance())
+            ulAdvances++;
+        else
+            (void) sched_yield();
+    }
+}
+
+/* ------------------------------------------------------------------ */
+
+void Epoch_collect(void) {
+    size_t ulAdvances;
+
+    Epoch_handOverOwn();
+
+    for(ulAdvances = 0; ulAdvances < NUM_LIMBO_LISTS; ulAdvances++)
+        if(!Epoch_advance())
+            break;
+}
+
+#else
+
+/* ------------------------------------------------------------------ */
+
+int Epoch_enter(void) {
+    return SUCCESS;
+}
+
+void Epoch_exit(void) {
+}
+
+void Epoch_retire(void *pvObject, void (*pfFree)(void *pvObject)) {
+    assert(pfFree != NULL);
+
+    (*pfFree)(pvObject);
+}
+
+void Epoch_drain(void) {
+}
+
+void Epoch_collect(void) {
+}
+
+#endif
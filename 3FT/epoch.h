@@ -0,0 +1,75 @@
+/*--------------------------------------------------------------------*/
+/* epoch.h                                                            */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+#ifndef EPOCH_INCLUDED
+#define EPOCH_INCLUDED
+
+#include "a4def.h"
+
+/*
+  Epoch-based reclamation for data read without locks. A reader
+  brackets its accesses with Epoch_enter and Epoch_exit; a writer
+  that unlinks an object passes it to Epoch_retire, which frees it
+  only once every reader that might still hold a reference has left.
+
+  Unless built with FT_THREADSAFE, entering and leaving do nothing
+  and retired objects are freed immediately.
+*/
+
+/*
+  Epoch_load(pField) and Epoch_store(pField, value) read and publish
+  a word-sized field that readers access without locks. A store
+  makes everything the writer did beforehand visible to any reader
+  whose load observes the new value.
+*/
+#ifdef FT_THREADSAFE
+#define Epoch_load(pField) __atomic_load_n((pField), __ATOMIC_ACQUIRE)
+#define Epoch_store(pField, value) \
+    __atomic_store_n((pField), (value), __ATOMIC_RELEASE)
+#else
+#define Epoch_load(pField) (*(pField))
+#define Epoch_store(pField, value) ((void) (*(pField) = (value)))
+#endif
+
+/*
+  Begins a read-side critical section for the calling thread: objects
+  reachable now stay allocated until the matching Epoch_exit.
+  Critical sections may nest. Never blocks, and writes only to the
+  calling thread's own record. Returns SUCCESS, or MEMORY_ERROR if
+  this is the thread's first call and its record could not be
+  allocated (in which case Epoch_exit must not be called).
+*/
+int Epoch_enter(void);
+
+/* Ends the calling thread's innermost read-side critical section. */
+void Epoch_exit(void);
+
+/*
+  Arranges for (*pfFree)(pvObject) to be called once no thread can
+  still be inside a critical section that began before pvObject was
+  unlinked. The caller must already have unlinked pvObject. (If even
+  the bookkeeping for the deferral cannot be allocated, pvObject is
+  freed after Epoch_drain, or leaked if the caller is itself inside a
+  critical section.)
+*/
+void Epoch_retire(void *pvObject, void (*pfFree)(void *pvObject));
+
+/*
+  Waits until every object the calling thread has retired so far has
+  been freed. (Other threads hand over what they retire in batches,
+  so their latest retirees may outlast the call.) Must not be called
+  from inside a critical section.
+*/
+void Epoch_drain(void);
+
+/*
+  Frees, without waiting, whatever the calling thread has retired
+  that no current reader can still reach, advancing the epoch as far
+  as the readers allow. May be called from inside a critical section,
+  which only holds back what it might still reach.
+*/
+void Epoch_collect(void);
+
+#endif
@@ -3,122 +3,323 @@
 /* Author: Mirabelle Weinbach and John Wallace                        */
 /*--------------------------------------------------------------------*/
 
+/* for write and pthread_mutex_t under a strict ISO C
+   compilation */
+#define _POSIX_C_SOURCE 200809L
+
+#ifdef FT_THREADSAFE
+#include <pthread.h>
+#endif
 
 #include <stddef.h>
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "a4def.h"
 #include "dynarray.h"
+#include "epoch.h"
 #include "path.h"
+#include "content.h"
 #include "nodeFT.h"
+#include "nameindex.h"
 #include "ft.h"
 
+#ifdef FT_THREADSAFE
+/*
+  In thread-safe builds a FT's node count is split into stripes, each
+  on its own cache line. A thread adds to and subtracts from the stripe
+  FT_countStripe picks for it, so writers busy in different directories
+  do not all contend for one shared counter.
+*/
+enum { NUM_COUNT_STRIPES = 16, CACHE_LINE_SIZE = 64 };
+
+/* One stripe of a FT's node count */
+struct countStripe {
+    /* this stripe's share of the count, modulo SIZE_MAX + 1 */
+    size_t ulCount;
+    /* keeps the stripes on different cache lines */
+    char acPad[CACHE_LINE_SIZE - sizeof(size_t)];
+};
+#endif
+
 /*
   A File Tree is a representation of a hierarchy of directories,
-  represented as an AO with 3 state variables:
+  represented as an object with 4 state variables:
+*/
+struct ft {
+    /* 1. a flag for being in an initialized state (TRUE) or not
+       (FALSE) */
+    boolean bIsInitialized;
+    /* 2. a pointer to the root node in the hierarchy, which must be a
+       directory or NULL */
+    Node_T oNRoot;
+    /* 3. a counter of the number of nodes in the hierarchy */
+#ifdef FT_THREADSAFE
+    struct countStripe asCount[NUM_COUNT_STRIPES];
+    /* serializes writers that set the root or the initialized flag;
+       readers never take it */
+    pthread_mutex_t sRootLock;
+    /* serializes readers that use the nodes' cached listings;
+       writers never take it */
+    pthread_mutex_t sListingLock;
+    /* serializes changes to and searches of the name index, and the
+       nodes' index slots */
+    pthread_mutex_t sIndexLock;
+#else
+    size_t ulCount;
+#endif
+    /* 4. the index of the nodes' names and extensions, or NULL if
+       there is none */
+    NameIndex_T oIndex;
+    /* 5. whether writes copy files into chunked buffers (TRUE) or
+       flat ones (FALSE) */
+    boolean bChunked;
+    /* 6. the store new contents are interned in, or NULL if there is
+       none */
+    ContentStore_T oStore;
+    /* 7. the largest borrowed contents new files copy into their own
+       nodes, or 0 if they copy none */
+    size_t ulInlineLimit;
+    /* 8. the bytes the contents files own may take before cold ones
+       are spilled, or 0 if there is no budget, and the scratch file
+       they are spilled to, or NULL if there is none */
+    size_t ulBudget;
+    struct spill *psSpill;
+    /* 9. the bytes the contents files own took as of the last budget
+       sweep, the bytes they grew by since, and whether a budget sweep
+       is running */
+    size_t ulSwept;
+    size_t ulCharged;
+    boolean bSweeping;
+};
+
+/* The default FT operated on by the handle-less functions in ft.h. */
+#ifdef FT_THREADSAFE
+static struct ft sDefaultFT = { FALSE, NULL, { { 0 } },
+                                PTHREAD_MUTEX_INITIALIZER,
+                                PTHREAD_MUTEX_INITIALIZER,
+                                PTHREAD_MUTEX_INITIALIZER, NULL,
+                                FALSE, NULL, 0, 0, NULL, 0, 0,
+                                FALSE };
+#else
+static struct ft sDefaultFT;
+#endif
+
+/* ------------------------------------------------------------------ */
+
+/*
+  In thread-safe builds, readers take no lock at all: they run inside
+  an Epoch_enter/Epoch_exit critical section, read the fields writers
+  change (the root, the initialized flag, child arrays, and file
+  contents) with Epoch_load, and rely on Epoch_retire to keep anything
+  a writer unlinks allocated until they leave.
+
+  Writers also run inside a critical section and find their way with
+  the same lock-free lookups, then lock only what they change: the
+  directory whose children or file contents change (see Node_lock), or
+  oFT's root lock to set the root or the initialized flag. Writers in
+  different directories therefore never wait for each other.
+
+  Unless built with FT_THREADSAFE, the lock functions do nothing.
+*/
+
+/* Acquires oFT's root lock. */
+static void FT_lockRoot(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_lock(&oFT->sRootLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oFT;
+#endif
+}
+
+/* Releases oFT's root lock. */
+static void FT_unlockRoot(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_unlock(&oFT->sRootLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oFT;
+#endif
+}
+
+/*
+  Acquires oFT's listing lock, which FT_toString holds while it
+  refreshes and copies the listings the nodes cache (see
+  Node_refreshListing). Writers never take it.
+*/
+static void FT_lockListing(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_lock(&oFT->sListingLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oFT;
+#endif
+}
+
+/* Releases oFT's listing lock. */
+static void FT_unlockListing(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_unlock(&oFT->sListingLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oFT;
+#endif
+}
+
+/*
+  Acquires oFT's index lock, which guards its name index. Writers take
+  it after their directory's lock, never before.
+*/
+static void FT_lockIndex(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_lock(&oFT->sIndexLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oFT;
+#endif
+}
+
+/* Releases oFT's index lock. */
+static void FT_unlockIndex(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    int iRet = pthread_mutex_unlock(&oFT->sIndexLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    (void) oFT;
+#endif
+}
+
+#ifdef FT_THREADSAFE
+/*
+  Returns the index of the count stripe the calling thread updates: a
+  hash of an address on its stack, since each thread has its own.
+*/
+static size_t FT_countStripe(void) {
+    char cOnStack;
+    size_t ulHash = (size_t) &cOnStack >> 12;
+
+    ulHash *= 2654435761UL;
+    return (ulHash >> 16) % NUM_COUNT_STRIPES;
+}
+#endif
+
+/* Adds ulDelta to oFT's node count. */
+static void FT_addCount(FT_T oFT, size_t ulDelta) {
+#ifdef FT_THREADSAFE
+    (void) __atomic_fetch_add(&oFT->asCount[FT_countStripe()].ulCount,
+                              ulDelta, __ATOMIC_RELAXED);
+#else
+    oFT->ulCount += ulDelta;
+#endif
+}
+
+/* Subtracts ulDelta from oFT's node count. */
+static void FT_subtractCount(FT_T oFT, size_t ulDelta) {
+#ifdef FT_THREADSAFE
+    (void) __atomic_fetch_sub(&oFT->asCount[FT_countStripe()].ulCount,
+                              ulDelta, __ATOMIC_RELAXED);
+#else
+    oFT->ulCount -= ulDelta;
+#endif
+}
+
+#ifndef NDEBUG
+/*
+  Returns oFT's node count. In thread-safe builds concurrent writers
+  may change it as soon as it is read. Only assertions read it.
 */
+static size_t FT_getCount(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    size_t ulCount = 0;
+    size_t i;
 
-/* 1. a flag for being in an initialized state (TRUE) or not (FALSE) */
-static boolean bIsInitialized;
-/* 2. a pointer to the root node in the hierarchy, which must be a 
-directory or NULL*/
-static Node_T oNRoot;
-/* 3. a counter of the number of nodes in the hierarchy */
-static size_t ulCount;
+    for(i = 0; i < NUM_COUNT_STRIPES; i++)
+        ulCount += __atomic_load_n(&oFT->asCount[i].ulCount,
+                                   __ATOMIC_RELAXED);
+    return ulCount;
+#else
+    return oFT->ulCount;
+#endif
+}
+#endif
 
 /* ------------------------------------------------------------------ */
 
 /* The FT_traversePath and FT_findNode functions modularize the common
 functionality of going as far as possible down a FT towards a path
 and returning either the node of however far was reached or the
-node if the full path was reached, respectively.
+node if the full path was reached, respectively. Neither allocates
+memory: children are looked up by name with Node_findChild.
 */
 
 /*
-  Traverses the FT starting at the root as far as possible towards
+  Traverses oFT starting at the root as far as possible towards
   absolute path oPPath. If able to traverse, returns an int SUCCESS
   status and sets *poNFurthest to the furthest node reached (which may
   be only a prefix of oPPath, or even NULL if the root is NULL).
   Otherwise, sets *poNFurthest to NULL and returns with status:
   * CONFLICTING_PATH if the root's path is not a prefix of oPPath
-  * MEMORY_ERROR if memory could not be allocated to complete request
   * BAD_PATH if a oPPath is not a well-formatted path
 */
-static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
-    int iStatus;
-    Path_T oPPrefix = NULL;
+static int FT_traversePath(FT_T oFT, Path_T oPPath,
+                           Node_T *poNFurthest) {
     Node_T oNCurr;
     Node_T oNChild = NULL;
     size_t ulDepth;
     size_t i;
-    size_t ulChildID = 0;
 
+    assert(oFT != NULL);
     assert(oPPath != NULL);
     assert(poNFurthest != NULL);
 
     /* root is NULL -> won't find anything */
-    if(oNRoot == NULL) {
+    oNCurr = Epoch_load(&oFT->oNRoot);
+    if(oNCurr == NULL) {
         *poNFurthest = NULL;
         return SUCCESS;
     }
 
-    /* make sure root of provided path is the same as FT's root*/
-    iStatus = Path_prefix(oPPath, 1, &oPPrefix);
-    if(iStatus != SUCCESS) {
-        *poNFurthest = NULL;
-        return iStatus;
-    }
-
     /* make sure path doesn't conflict with one already in the FT */
-    if(Path_comparePath(Node_getPath(oNRoot), oPPrefix)) {
-        Path_free(oPPrefix);
+    if(strcmp(Path_getComponent(Node_getPath(oNCurr), 0),
+              Path_getComponent(oPPath, 0))) {
         *poNFurthest = NULL;
         return CONFLICTING_PATH;
     }
-    Path_free(oPPrefix);
-    oPPrefix = NULL;
 
-    oNCurr = oNRoot;
     ulDepth = Path_getDepth(oPPath);
 
     /* iterate down the path */
-    for(i = 2; i <= ulDepth; i++) {
-        iStatus = Path_prefix(oPPath, i, &oPPrefix);
-        if(iStatus != SUCCESS) {
-            *poNFurthest = NULL;
-            return iStatus;
-        }
-        if(Node_hasChild(oNCurr, oPPrefix, &ulChildID)) {
-            /* go to that child and continue with next prefix */
-            Path_free(oPPrefix);
-            oPPrefix = NULL;
-            iStatus = Node_getChild(oNCurr, ulChildID, &oNChild);
-            if(iStatus != SUCCESS) {
-                *poNFurthest = NULL;
-                return iStatus;
-            }
+    for(i = 1; i < ulDepth; i++) {
+        const char *pcName = Path_getComponent(oPPath, i);
 
-            oNCurr = oNChild;
-        }
-        else {
-            /* oNCurr doesn't have child with path oPPrefix: this is as
-            far as we can go */
+        if(!Node_findChild(oNCurr, pcName, strlen(pcName), &oNChild)) {
+            /* oNCurr doesn't have this child: this is as far as we
+            can go */
 
             /* check if path argument has a file ancestor */
-            if((i != ulDepth) && (Node_getType(oNCurr) == IS_FILE)) {
-                Path_free(oPPrefix);
+            if((i != ulDepth - 1) && (Node_getType(oNCurr) == IS_FILE)) {
                 *poNFurthest = NULL;
                 return BAD_PATH;
             }
 
             break;
         }
+
+        /* go to that child and continue with next component */
+        oNCurr = oNChild;
     }
 
-    Path_free(oPPrefix);
     *poNFurthest = oNCurr;
     return SUCCESS;
 }
@@ -126,61 +327,88 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
 /* ------------------------------------------------------------------ */
 
 /*
-  Traverses the FT to find a node with absolute path pcPath. Returns a
+  Returns TRUE if pcPath is well-formatted, i.e., is not the empty
+  string and has no leading, trailing, or consecutive '/' delimiters
+  (the same rules Path_new enforces), or FALSE otherwise.
+*/
+static boolean FT_isWellFormatted(const char *pcPath) {
+    const char *pc;
+
+    assert(pcPath != NULL);
+
+    if(*pcPath == '\0' || *pcPath == '/')
+        return FALSE;
+
+    for(pc = pcPath; *pc != '\0'; pc++)
+        if(*pc == '/' && (pc[1] == '/' || pc[1] == '\0'))
+            return FALSE;
+
+    return TRUE;
+}
+
+/*
+  Traverses oFT to find a node with absolute path pcPath. Returns a
   int SUCCESS status and sets *poNResult to be the node, if found.
   Otherwise, sets *poNResult to NULL and returns with status:
   * INITIALIZATION_ERROR if the FT is not in an initialized state
   * BAD_PATH if pcPath does not represent a well-formatted path
   * CONFLICTING_PATH if the root's path is not a prefix of pcPath
   * NO_SUCH_PATH if no node with pcPath exists in the hierarchy
-  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  Walks pcPath in place rather than building a Path_T, so lock-free
+  readers never allocate.
  */
-static int FT_findNode(const char *pcPath, Node_T *poNResult) {
-    Path_T oPPath = NULL;
-    Node_T oNFound = NULL;
-    int iStatus;
+static int FT_findNode(FT_T oFT, const char *pcPath,
+                       Node_T *poNResult) {
+    Node_T oNCurr;
+    Node_T oNChild = NULL;
+    const char *pcRootName;
+    size_t ulLength;
 
+    assert(oFT != NULL);
     assert(pcPath != NULL);
     assert(poNResult != NULL);
 
+    *poNResult = NULL;
+
     /* check if initialized*/
-    if(!bIsInitialized) {
-        *poNResult = NULL;
+    if(!Epoch_load(&oFT->bIsInitialized))
         return INITIALIZATION_ERROR;
-    }
-
-    /* create path */
-    iStatus = Path_new(pcPath, &oPPath);
-    if(iStatus != SUCCESS) {
-        *poNResult = NULL;
-        return iStatus;
-    }
 
-    /*traverse path */
-    iStatus = FT_traversePath(oPPath, &oNFound);
-    if(iStatus != SUCCESS)
-    {
-        Path_free(oPPath);
-        *poNResult = NULL;
-        return iStatus;
-    }
+    if(!FT_isWellFormatted(pcPath))
+        return BAD_PATH;
 
-    /* node not in pcPath */
-    if(oNFound == NULL) {
-        Path_free(oPPath);
-        *poNResult = NULL;
+    /* node not in tree if there is no root */
+    oNCurr = Epoch_load(&oFT->oNRoot);
+    if(oNCurr == NULL)
         return NO_SUCH_PATH;
-    }
 
-    /* node in tree but has diffent path*/ 
-    if(Path_comparePath(Node_getPath(oNFound), oPPath) != 0) {
-        Path_free(oPPath);
-        *poNResult = NULL;
-        return NO_SUCH_PATH;
+    /* the first component must name the root */
+    ulLength = strcspn(pcPath, "/");
+    pcRootName = Path_getComponent(Node_getPath(oNCurr), 0);
+    if(strncmp(pcRootName, pcPath, ulLength) != 0 ||
+       pcRootName[ulLength] != '\0')
+        return CONFLICTING_PATH;
+    pcPath += ulLength;
+
+    /* follow each remaining component */
+    while(*pcPath == '/') {
+        pcPath++;
+        ulLength = strcspn(pcPath, "/");
+
+        if(!Node_findChild(oNCurr, pcPath, ulLength, &oNChild)) {
+            /* check if path argument has a file ancestor */
+            if(pcPath[ulLength] != '\0' &&
+               Node_getType(oNCurr) == IS_FILE)
+                return BAD_PATH;
+            return NO_SUCH_PATH;
+        }
+
+        oNCurr = oNChild;
+        pcPath += ulLength;
     }
 
-    Path_free(oPPath);
-    *poNResult = oNFound;
+    *poNResult = oNCurr;
     return SUCCESS;
 }
 
@@ -190,537 +418,4219 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
   string representation of the FT.
 */
 
+/* A string representation of the FT being assembled */
+struct listing {
+    /* the string, and the number of bytes of it filled so far */
+    char *pcData;
+    size_t ulUsed;
+    /* the number of bytes allocated for pcData */
+    size_t ulCapacity;
+    /* TRUE if pcData is a slot in a larger buffer, which must not
+       grow; running out of room is then an error */
+    boolean bFixed;
+};
+
+/* A number of levels to list that stands for "all of them" */
+#define FT_ALL_LEVELS ((size_t) -1)
+
 /*
-  Performs a pre-order traversal of the tree rooted at oNNode,
-  inserting each payload to DynArray_T oDArray beginning at index
-  ulIndex with files before directories in lexicographic order. Returns 
-  the next unused index in oDArray after the insertion(s). */
-static size_t FT_preOrderTraversal(Node_T oNNode,
-                                   DynArray_T oDArray, size_t ulIndex) {
-    size_t count;
-    DynArray_T oDSorted;
+  Appends the ulLength bytes at pcBytes to psListing, growing it if it
+  runs out of room. Returns SUCCESS, or MEMORY_ERROR if it cannot
+  grow.
+*/
+static int FT_appendListing(struct listing *psListing,
+                            const char *pcBytes, size_t ulLength) {
+    assert(psListing != NULL);
+    assert(pcBytes != NULL);
+
+    if(psListing->ulCapacity - psListing->ulUsed < ulLength) {
+        size_t ulCapacity;
+        char *pcData;
+
+        if(psListing->bFixed)
+            return MEMORY_ERROR;
+        ulCapacity = 2 * psListing->ulCapacity + ulLength;
+        pcData = realloc(psListing->pcData, ulCapacity);
+        if(pcData == NULL)
+            return MEMORY_ERROR;
+        psListing->pcData = pcData;
+        psListing->ulCapacity = ulCapacity;
+    }
+    memcpy(psListing->pcData + psListing->ulUsed, pcBytes, ulLength);
+    psListing->ulUsed += ulLength;
+    return SUCCESS;
+}
 
-    assert(oDArray != NULL);
+/*
+  Stores in *pulLength the length of the listing of the subtree rooted
+  at directory oNDir, down to ulLevels levels below it (or all of them
+  if ulLevels is FT_ALL_LEVELS), refreshing the cached listings it
+  covers: the whole subtree's, or with a depth limit only the own
+  lines of the directories above it, so that the cost stays with the
+  result. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_measureListing(Node_T oNDir, size_t ulLevels,
+                             size_t *pulLength) {
+    DynArray_T oDChildren;
+    size_t ulChildren;
+    size_t i;
 
-    if(oNNode != NULL) {
-        size_t ulChildren = 0;
-        
-        /* set first free index to be given node */
-        (void) DynArray_set(oDArray, ulIndex, oNNode);
-        ulIndex++;
+    assert(oNDir != NULL);
+    assert(pulLength != NULL);
 
-        /* base case - return the index if node is file (leaf node) */
-        if (Node_getNumChildren(oNNode, &ulChildren) == NOT_A_DIRECTORY)
-        {
-            return ulIndex;
-        }
-        
-        oDSorted = DynArray_new(0);
-        
-        /* sort children of node into lexicographic order, files first*/
-        for(count = 0; count < ulChildren; count++) {
-            int iStatus;
+    if(ulLevels == 0) {
+        *pulLength = Path_getStrLength(Node_getPath(oNDir)) + 1;
+        return SUCCESS;
+    }
+    if(ulLevels == FT_ALL_LEVELS)
+        return Node_refreshListing(oNDir, pulLength);
+
+    if(Node_refreshOwnListing(oNDir, pulLength) != SUCCESS)
+        return MEMORY_ERROR;
+    oDChildren = Node_getChildren(oNDir);
+    ulChildren = DynArray_getLength(oDChildren);
+    for(i = 0; i < ulChildren; i++) {
+        Node_T oNChild = DynArray_get(oDChildren, i);
+        size_t ulChildLength;
+
+        if(Node_getType(oNChild) != IS_DIRECTORY)
+            continue;
+        if(FT_measureListing(oNChild, ulLevels - 1, &ulChildLength)
+           != SUCCESS)
+            return MEMORY_ERROR;
+        *pulLength += ulChildLength;
+    }
+    return SUCCESS;
+}
 
-            Node_T oNChild = NULL;
-            iStatus = Node_getChild(oNNode, count, &oNChild);
+/*
+  Appends the cached listing of the subtree rooted at directory oNDir,
+  down to ulLevels levels below it (or all of them if ulLevels is
+  FT_ALL_LEVELS), to psListing, files before directories at each
+  level. Directories are refreshed on the way, which is free unless a
+  concurrent writer changed them after the caller sized psListing.
+  Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_copyListing(Node_T oNDir, size_t ulLevels,
+                          struct listing *psListing) {
+    DynArray_T oDChildren;
+    const char *pcLines;
+    size_t ulLength;
+    size_t ulChildren;
+    size_t i;
 
-            assert(iStatus == SUCCESS);
+    assert(oNDir != NULL);
+    assert(psListing != NULL);
 
-            if(Node_getType(oNChild) == IS_FILE)
-                DynArray_add(oDSorted, oNChild);
-        }
+    /* at the last level, just the directory's own path */
+    if(ulLevels == 0) {
+        Path_T oPPath = Node_getPath(oNDir);
 
-        /* add directories on the same level after the files */
-        for(count = 0; count < ulChildren; count++) {
-            int iStatus;
+        if(FT_appendListing(psListing, Path_getPathname(oPPath),
+                            Path_getStrLength(oPPath)) != SUCCESS)
+            return MEMORY_ERROR;
+        return FT_appendListing(psListing, "\n", 1);
+    }
 
-            Node_T oNChild = NULL;
-            iStatus = Node_getChild(oNNode, count, &oNChild);
+    if((ulLevels == FT_ALL_LEVELS ?
+        Node_refreshListing(oNDir, &ulLength) :
+        Node_refreshOwnListing(oNDir, &ulLength)) != SUCCESS)
+        return MEMORY_ERROR;
+    pcLines = Node_getListing(oNDir, &ulLength);
+    if(FT_appendListing(psListing, pcLines, ulLength) != SUCCESS)
+        return MEMORY_ERROR;
+
+    /* the files are in oNDir's own lines; recur on directories */
+    if(ulLevels != FT_ALL_LEVELS)
+        ulLevels--;
+    oDChildren = Node_getChildren(oNDir);
+    ulChildren = DynArray_getLength(oDChildren);
+    for(i = 0; i < ulChildren; i++) {
+        Node_T oNChild = DynArray_get(oDChildren, i);
+
+        if(Node_getType(oNChild) == IS_DIRECTORY &&
+           FT_copyListing(oNChild, ulLevels, psListing) != SUCCESS)
+            return MEMORY_ERROR;
+    }
+    return SUCCESS;
+}
 
-            assert(iStatus == SUCCESS);
+#ifdef FT_THREADSAFE
+/*
+  In thread-safe builds a large listing is copied by several threads.
+  The cached subtree lengths give every subtree its final offset in
+  the result (a prefix sum in listing order), so the top levels are
+  split into tasks that each fill a fixed slot of the one buffer, and
+  no stitching is needed afterwards. The helper threads are started
+  on first use and kept for later copies.
+*/
+enum { FT_MAX_WORKERS = 8, FT_TASKS_PER_WORKER = 4 };
 
-            if(Node_getType(oNChild) == IS_DIRECTORY)
-                DynArray_add(oDSorted, oNChild);
-        }
+/*
+  Listings shorter than FT_PARALLEL_MIN_LENGTH bytes are copied
+  serially. FT_LISTING_WORKERS, if defined, fixes the number of
+  threads that copy a listing, which is otherwise one per processor.
+  Tests define both to reach the parallel copy with small trees.
+*/
+#ifndef FT_PARALLEL_MIN_LENGTH
+#define FT_PARALLEL_MIN_LENGTH (1 << 18)
+#endif
+
+/* One subtree's share of a parallel copy */
+struct listingTask {
+    /* the subtree's root directory */
+    Node_T oNDir;
+    /* where its listing starts in the result, and its length */
+    size_t ulOffset;
+    size_t ulLength;
+};
+
+/* A parallel copy, shared by the threads working on it */
+struct listingJob {
+    /* the result buffer, and its length */
+    char *pcData;
+    size_t ulLength;
+    /* the tasks, and the number of them */
+    struct listingTask *psTasks;
+    size_t ulTasks;
+    /* the index of the next task to claim (taken atomically) */
+    size_t ulNext;
+    /* TRUE once any task fails (set atomically) */
+    int iFailed;
+    /* the tasks' allocated capacity, used only while planning */
+    size_t ulCapacity;
+};
 
-        /* recur */
-        for(count = 0; count < ulChildren; count++) {
-            Node_T oNChild = NULL;
-            oNChild = DynArray_get(oDSorted, count);
+/*
+  Plans the copy of the subtree rooted at directory oNDir, of length
+  ulLength, to offset ulOffset: copies oNDir's own lines at once and
+  splits it further if it is longer than ulSplit, or else adds it to
+  psJob as one task. Returns the offset just past the subtree, or
+  (size_t) -1 if a task could not be added or the cached lengths
+  disagree because of a concurrent change. Nothing is planned past
+  the end of the result, however the lengths disagree.
+*/
+static size_t FT_planListing(Node_T oNDir, size_t ulOffset,
+                             size_t ulLength, size_t ulSplit,
+                             struct listingJob *psJob) {
+    DynArray_T oDChildren;
+    const char *pcLines;
+    size_t ulLinesLength;
+    size_t ulChildren;
+    size_t i;
 
-            ulIndex = FT_preOrderTraversal(oNChild, oDArray, ulIndex);
+    assert(oNDir != NULL);
+    assert(psJob != NULL);
+
+    assert(ulOffset <= psJob->ulLength);
+
+    /* a concurrent writer may have changed oNDir since it was sized */
+    if(ulLength > psJob->ulLength - ulOffset)
+        return (size_t) -1;
+
+    oDChildren = Node_getChildren(oNDir);
+    if(ulLength <= ulSplit || DynArray_getLength(oDChildren) == 0) {
+        if(psJob->ulTasks == psJob->ulCapacity) {
+            size_t ulCapacity = 2 * psJob->ulCapacity + 4;
+            struct listingTask *psTasks =
+                realloc(psJob->psTasks,
+                        ulCapacity * sizeof(struct listingTask));
+            if(psTasks == NULL)
+                return (size_t) -1;
+            psJob->psTasks = psTasks;
+            psJob->ulCapacity = ulCapacity;
         }
-
-        DynArray_free(oDSorted);
+        psJob->psTasks[psJob->ulTasks].oNDir = oNDir;
+        psJob->psTasks[psJob->ulTasks].ulOffset = ulOffset;
+        psJob->psTasks[psJob->ulTasks].ulLength = ulLength;
+        psJob->ulTasks++;
+        return ulOffset + ulLength;
     }
 
-    return ulIndex;
+    pcLines = Node_getListing(oNDir, &ulLinesLength);
+    if(ulLinesLength > psJob->ulLength - ulOffset)
+        return (size_t) -1;
+    memcpy(psJob->pcData + ulOffset, pcLines, ulLinesLength);
+    ulOffset += ulLinesLength;
+
+    ulChildren = DynArray_getLength(oDChildren);
+    for(i = 0; i < ulChildren; i++) {
+        Node_T oNChild = DynArray_get(oDChildren, i);
+        size_t ulChildLength;
+
+        if(Node_getType(oNChild) != IS_DIRECTORY)
+            continue;
+        /* free for a clean subtree, which is the usual case */
+        if(Node_refreshListing(oNChild, &ulChildLength) != SUCCESS)
+            return (size_t) -1;
+        ulOffset = FT_planListing(oNChild, ulOffset, ulChildLength,
+                                  ulSplit, psJob);
+        if(ulOffset == (size_t) -1)
+            return ulOffset;
+    }
+    return ulOffset;
 }
 
 /*
-  Alternate version of strlen that uses pulAcc as an in-out parameter
-  to accumulate a string length, rather than returning the length of
-  oNNode's path, and also always adds one addition byte to the sum.
+  Claims and copies tasks of the listingJob pvJob until none are
+  left. Used as the body of each worker thread, and run by the caller
+  too. Returns NULL.
 */
-static void FT_strlenAccumulate(Node_T oNNode, size_t *pulAcc) {
-    assert(pulAcc != NULL);
+static void *FT_listingWorker(void *pvJob) {
+    struct listingJob *psJob = pvJob;
+    size_t ulTask;
+
+    assert(psJob != NULL);
 
-    if(oNNode != NULL)
-        *pulAcc += (Path_getStrLength(Node_getPath(oNNode)) + 1);
+    if(Epoch_enter() != SUCCESS) {
+        __atomic_store_n(&psJob->iFailed, TRUE, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    while((ulTask = __atomic_fetch_add(&psJob->ulNext, 1,
+                                       __ATOMIC_RELAXED))
+          < psJob->ulTasks) {
+        struct listingTask *psTask = &psJob->psTasks[ulTask];
+        struct listing sSlot;
+
+        sSlot.pcData = psJob->pcData + psTask->ulOffset;
+        sSlot.ulUsed = 0;
+        sSlot.ulCapacity = psTask->ulLength;
+        sSlot.bFixed = TRUE;
+        if(FT_copyListing(psTask->oNDir, FT_ALL_LEVELS, &sSlot)
+           != SUCCESS ||
+           sSlot.ulUsed != psTask->ulLength)
+            __atomic_store_n(&psJob->iFailed, TRUE, __ATOMIC_RELAXED);
+    }
+    Epoch_exit();
+    return NULL;
 }
 
 /*
-  Alternate version of strcat that inverts the typical argument
-  order, appending oNNode's path onto pcAcc, and also always adds one
-  newline at the end of the concatenated string.
+  The helper threads work on one job at a time. A copy that finds them
+  busy with another is done by its caller alone.
 */
-static void FT_strcatAccumulate(Node_T oNNode, char *pcAcc) {
-    assert(pcAcc != NULL);
 
-    if(oNNode != NULL) {
-        strcat(pcAcc, Path_getPathname(Node_getPath(oNNode)));
-        strcat(pcAcc, "\n");
-    }
-}
+/* 1. protects the rest of the pool */
+static pthread_mutex_t sPoolLock = PTHREAD_MUTEX_INITIALIZER;
+/* 2. signalled when a job is posted, and when the helpers finish it */
+static pthread_cond_t sJobPosted = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t sJobFinished = PTHREAD_COND_INITIALIZER;
+/* 3. the job posted, or NULL, and the number of jobs ever posted */
+static struct listingJob *psPostedJob;
+static unsigned long ulJobsPosted;
+/* 4. the number of helpers started, and of those still on the job */
+static size_t ulPoolHelpers;
+static size_t ulPoolBusy;
+/* 5. starts the helpers on first use */
+static pthread_once_t sPoolOnce = PTHREAD_ONCE_INIT;
 
-/* ------------------------------------------------------------------ */
+/*
+  Works on every job posted to the pool, forever. The body of each
+  helper thread. Returns NULL (never).
+*/
+static void *FT_poolHelper(void *pvUnused) {
+    unsigned long ulSeen = 0;
 
-int FT_insertDir(const char *pcPath){
-    int iStatus;
-    Path_T oPPath = NULL;
-    Node_T oNFirstNew = NULL;
-    Node_T oNCurr = NULL;
-    size_t ulDepth, ulIndex;
-    size_t ulNewNodes = 0;
+    (void) pvUnused;
 
-    assert(pcPath != NULL);
-  
-    /* validate pcPath and generate a Path_T for it */
-    if(!bIsInitialized)
-        return INITIALIZATION_ERROR;
+    for(;;) {
+        struct listingJob *psJob;
 
-    iStatus = Path_new(pcPath, &oPPath);
-    if(iStatus != SUCCESS)
-        return iStatus;
+        (void) pthread_mutex_lock(&sPoolLock);
+        while(ulJobsPosted == ulSeen)
+            (void) pthread_cond_wait(&sJobPosted, &sPoolLock);
+        ulSeen = ulJobsPosted;
+        psJob = psPostedJob;
+        (void) pthread_mutex_unlock(&sPoolLock);
 
-    /* find the closest ancestor of oPPath already in the tree */
-    iStatus = FT_traversePath(oPPath, &oNCurr);
-    if(iStatus != SUCCESS)
-    {
-        Path_free(oPPath);
-        return iStatus;
-    }
+        (void) FT_listingWorker(psJob);
 
-    /* no ancestor node found, so if root is not NULL, pcPath isn't 
-    underneath root. */
-    if(oNCurr == NULL && oNRoot != NULL) {
-        Path_free(oPPath);
-        return CONFLICTING_PATH;
+        (void) pthread_mutex_lock(&sPoolLock);
+        if(--ulPoolBusy == 0)
+            (void) pthread_cond_signal(&sJobFinished);
+        (void) pthread_mutex_unlock(&sPoolLock);
     }
-    
-    ulDepth = Path_getDepth(oPPath);
-    if(oNCurr == NULL) /* new root! */
-        ulIndex = 1;
-    else {
-        ulIndex = Path_getDepth(Node_getPath(oNCurr))+1;
+    return NULL;
+}
 
-        /* oNCurr is the node we're trying to insert */
-        if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                        Node_getPath(oNCurr))) {
-            Path_free(oPPath);
-            return ALREADY_IN_TREE;
-        }
-    }
+/*
+  Starts one helper thread fewer than the threads that copy a listing,
+  leaving room for the caller. Fewer are fine if some cannot start.
+*/
+static void FT_startPool(void) {
+    size_t ulThreads;
+    size_t i;
+#ifdef FT_LISTING_WORKERS
 
-    /* starting at oNCurr, build rest of the path one level at a time */
-    while(ulIndex <= ulDepth) {
-        Path_T oPPrefix = NULL;
-        Node_T oNNewNode = NULL;
+    ulThreads = FT_LISTING_WORKERS;
+#else
+    long lCpus = sysconf(_SC_NPROCESSORS_ONLN);
 
-        /* generate a Path_T for this level */
-        iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-        if(iStatus != SUCCESS) {
-            Path_free(oPPath);
-            if(oNFirstNew != NULL)
-                (void) Node_free(oNFirstNew);
-            return iStatus;
-        }
+    ulThreads = lCpus > 0 ? (size_t) lCpus : 1;
+#endif
+    if(ulThreads > FT_MAX_WORKERS)
+        ulThreads = FT_MAX_WORKERS;
 
-        /* insert the new directory type node for this level */
-        iStatus = Node_new(oPPrefix, IS_DIRECTORY, oNCurr, &oNNewNode);
-        if(iStatus != SUCCESS) {
-            Path_free(oPPath);
-            Path_free(oPPrefix);
-            if(oNFirstNew != NULL)
-                (void) Node_free(oNFirstNew);
-            return iStatus;
-        }
+    for(i = 1; i < ulThreads; i++) {
+        pthread_t sHelper;
 
-        /* set up for next level */
-        Path_free(oPPrefix);
-        oNCurr = oNNewNode;
-        ulNewNodes++;
-        if(oNFirstNew == NULL)
-            oNFirstNew = oNCurr;
-        ulIndex++;
+        if(pthread_create(&sHelper, NULL, FT_poolHelper, NULL) != 0)
+            break;
+        (void) pthread_detach(sHelper);
+        ulPoolHelpers++;
+    }
+}
 
+/*
+  Copies the listing of the subtree rooted at oNRoot, of length
+  ulLength, to the start of psListing with the caller and the pool's
+  helpers, and sets psListing->ulUsed. Returns SUCCESS, or MEMORY_ERROR
+  if there is too little to split, the copy could not be planned, or a
+  concurrent change made a task overflow its slot, in which case the
+  caller copies serially instead.
+*/
+static int FT_copyListingParallel(Node_T oNRoot, size_t ulLength,
+                                  struct listing *psListing) {
+    struct listingJob sJob;
+    boolean bPosted = FALSE;
+
+    assert(oNRoot != NULL);
+    assert(psListing != NULL);
+    assert(psListing->ulCapacity >= ulLength);
+
+    if(ulLength < FT_PARALLEL_MIN_LENGTH)
+        return MEMORY_ERROR;
+    (void) pthread_once(&sPoolOnce, FT_startPool);
+    if(ulPoolHelpers == 0)
+        return MEMORY_ERROR;
+
+    sJob.pcData = psListing->pcData;
+    sJob.ulLength = ulLength;
+    sJob.psTasks = NULL;
+    sJob.ulTasks = 0;
+    sJob.ulCapacity = 0;
+    sJob.ulNext = 0;
+    sJob.iFailed = FALSE;
+    if(FT_planListing(oNRoot, 0, ulLength,
+                      ulLength / ((ulPoolHelpers + 1) *
+                                  FT_TASKS_PER_WORKER),
+                      &sJob) != ulLength) {
+        free(sJob.psTasks);
+        return MEMORY_ERROR;
     }
 
-    Path_free(oPPath);
-    /* update FT state variables to reflect insertion */
-    if(oNRoot == NULL)
-        oNRoot = oNFirstNew;
-    ulCount += ulNewNodes;
+    (void) pthread_mutex_lock(&sPoolLock);
+    if(psPostedJob == NULL && sJob.ulTasks > 1) {
+        psPostedJob = &sJob;
+        ulJobsPosted++;
+        ulPoolBusy = ulPoolHelpers;
+        (void) pthread_cond_broadcast(&sJobPosted);
+        bPosted = TRUE;
+    }
+    (void) pthread_mutex_unlock(&sPoolLock);
+
+    (void) FT_listingWorker(&sJob);
+
+    if(bPosted) {
+        (void) pthread_mutex_lock(&sPoolLock);
+        while(ulPoolBusy > 0)
+            (void) pthread_cond_wait(&sJobFinished, &sPoolLock);
+        psPostedJob = NULL;
+        (void) pthread_mutex_unlock(&sPoolLock);
+    }
 
+    free(sJob.psTasks);
+    if(sJob.iFailed)
+        return MEMORY_ERROR;
+    psListing->ulUsed = ulLength;
     return SUCCESS;
 }
+#endif
 
-/* ------------------------------------------------------------------ */
+/* --------------------------------------------------------------------
 
-boolean FT_containsDir(const char *pcPath){
+  The following auxiliary functions are used for streaming the string
+  representation of the FT to a sink.
+*/
 
+/* A listing on its way to a sink */
+struct writer {
+    /* the sink, and the extra argument to pass it */
+    FT_Sink pfSink;
+    void *pvExtra;
+    /* the first status other than SUCCESS the sink returned, if any */
     int iStatus;
-    Node_T oNFound = NULL;
+    /* the number of bytes waiting in acChunk */
+    size_t ulUsed;
+    /* output not yet passed to the sink */
+    char acChunk[FT_CHUNK_SIZE];
+};
+
+/* Passes whatever psWriter has buffered to its sink. */
+static void FT_flushWriter(struct writer *psWriter) {
+    assert(psWriter != NULL);
+
+    if(psWriter->ulUsed > 0 && psWriter->iStatus == SUCCESS)
+        psWriter->iStatus = (*psWriter->pfSink)(psWriter->acChunk,
+                                                psWriter->ulUsed,
+                                                psWriter->pvExtra);
+    psWriter->ulUsed = 0;
+}
 
-    assert(pcPath != NULL);
+/*
+  Appends the ulLength bytes at pcBytes to psWriter's output, passing
+  each full chunk to the sink.
+*/
+static void FT_writeBytes(struct writer *psWriter, const char *pcBytes,
+                          size_t ulLength) {
+    assert(psWriter != NULL);
+    assert(pcBytes != NULL);
+
+    while(ulLength > 0 && psWriter->iStatus == SUCCESS) {
+        size_t ulRoom = FT_CHUNK_SIZE - psWriter->ulUsed;
+        if(ulRoom > ulLength)
+            ulRoom = ulLength;
+
+        memcpy(psWriter->acChunk + psWriter->ulUsed, pcBytes, ulRoom);
+        psWriter->ulUsed += ulRoom;
+        pcBytes += ulRoom;
+        ulLength -= ulRoom;
+
+        if(psWriter->ulUsed == FT_CHUNK_SIZE)
+            FT_flushWriter(psWriter);
+    }
+}
 
-    /* no possible path if no root */
-    if (oNRoot == NULL)
-        return FALSE;
+/* Appends oNNode's path and a newline to psWriter's output. */
+static void FT_writeNode(struct writer *psWriter, Node_T oNNode) {
+    Path_T oPPath;
 
-    iStatus = FT_findNode(pcPath, &oNFound);
-    if (iStatus != SUCCESS)
-        return FALSE;
+    assert(psWriter != NULL);
+    assert(oNNode != NULL);
 
-    /* file, not directory */
-    if (Node_getType(oNFound) != IS_DIRECTORY) {
-        return FALSE;
-    }
-    return (boolean) (iStatus == SUCCESS);
+    oPPath = Node_getPath(oNNode);
+    FT_writeBytes(psWriter, Path_getPathname(oPPath),
+                  Path_getStrLength(oPPath));
+    FT_writeBytes(psWriter, "\n", 1);
 }
 
-/* ------------------------------------------------------------------ */
+/*
+  Appends the subtree rooted at oNNode to psWriter's output, in the
+  order FT_toString lists it: files are written by a first
+  pass over each snapshot of the children and directories recurse in
+  a second, so only one frame per level is ever live.
+*/
+static void FT_writeSubtree(struct writer *psWriter, Node_T oNNode) {
+    DynArray_T oDChildren;
+    size_t ulChildren;
+    size_t i;
 
-int FT_rmDir(const char *pcPath){
-    int iStatus;
-    Node_T oNFound = NULL;
+    assert(psWriter != NULL);
+    assert(oNNode != NULL);
 
-    assert(pcPath != NULL);
-   
-    iStatus = FT_findNode(pcPath, &oNFound);
+    FT_writeNode(psWriter, oNNode);
 
-    
-    if (iStatus != SUCCESS)
-        return iStatus;
-    
-    /* file, not directory */
-    if (Node_getType(oNFound) == IS_FILE)
-        return NOT_A_DIRECTORY;
+    oDChildren = Node_getChildren(oNNode);
+    if(oDChildren == NULL)
+        return;
+    ulChildren = DynArray_getLength(oDChildren);
 
-    /* free subtree from the directory */
-    ulCount -= Node_free(oNFound);
-    if(ulCount == 0)
-        oNRoot = NULL;
+    for(i = 0; i < ulChildren && psWriter->iStatus == SUCCESS; i++) {
+        Node_T oNChild = DynArray_get(oDChildren, i);
+        if(Node_getType(oNChild) == IS_FILE)
+            FT_writeNode(psWriter, oNChild);
+    }
+    for(i = 0; i < ulChildren && psWriter->iStatus == SUCCESS; i++) {
+        Node_T oNChild = DynArray_get(oDChildren, i);
+        if(Node_getType(oNChild) == IS_DIRECTORY)
+            FT_writeSubtree(psWriter, oNChild);
+    }
+}
+
+/* An FT_Sink that writes to the FILE * pvFile. */
+static int FT_fileSink(const char *pcChunk, size_t ulLength,
+                       void *pvFile) {
+    assert(pcChunk != NULL);
+    assert(pvFile != NULL);
 
+    if(fwrite(pcChunk, 1, ulLength, (FILE *) pvFile) != ulLength)
+        return IO_ERROR;
     return SUCCESS;
 }
 
-/* ------------------------------------------------------------------ */
+/* An FT_Sink that writes to the file descriptor pointed to by pvFd. */
+static int FT_fdSink(const char *pcChunk, size_t ulLength, void *pvFd) {
+    int iFd;
 
-int FT_insertFile(const char *pcPath, void *pvContents,
-    size_t ulLength){
-    int iStatus;
-    Path_T oPPath = NULL;
-    Node_T oNFirstNew = NULL;
-    Node_T oNCurr = NULL;
-    size_t ulDepth, ulIndex;
-    size_t ulNewNodes = 0;
+    assert(pcChunk != NULL);
+    assert(pvFd != NULL);
 
-    assert(pcPath != NULL);
-    assert (pvContents != NULL);
-  
-    /* validate pcPath and generate a Path_T for it */
-    if(!bIsInitialized)
-        return INITIALIZATION_ERROR;
+    iFd = *(int *) pvFd;
+    while(ulLength > 0) {
+        ssize_t lWritten = write(iFd, pcChunk, ulLength);
+        if(lWritten < 0) {
+            if(errno == EINTR)
+                continue;
+            return IO_ERROR;
+        }
+        pcChunk += lWritten;
+        ulLength -= (size_t) lWritten;
+    }
+    return SUCCESS;
+}
 
-    iStatus = Path_new(pcPath, &oPPath);
-    if(iStatus != SUCCESS)
-        return iStatus;
+/* --------------------------------------------------------------------
 
-    /* find the closest ancestor of oPPath already in the tree */
-    iStatus = FT_traversePath(oPPath, &oNCurr);
-    if(iStatus != SUCCESS)
-    {
-        Path_free(oPPath);
-        return iStatus;
-    }
+  The following auxiliary functions are used for building the FT in
+  bulk from a sorted manifest.
+*/
 
-    /* no ancestor node found, so if root is not NULL, pcPath isn't 
-    underneath root. */
-    if(oNCurr == NULL && oNRoot != NULL) {
-        Path_free(oPPath);
-        return CONFLICTING_PATH;
-    }
-    
-    ulDepth = Path_getDepth(oPPath);
-    if(oNCurr == NULL) { /* attempts to insert file as root */
-        ulIndex = 1;
-        Path_free(oPPath);
+/*
+  Validates that oPPath may directly follow oPPrev, which was of type
+  prevType, in a FT_buildFromSorted manifest, given that the two paths
+  share their first ulShared components. Returns SUCCESS or:
+  * CONFLICTING_PATH if the two paths do not share a root
+  * ALREADY_IN_TREE if oPPath is oPPrev or one of its ancestors
+  * NOT_A_DIRECTORY if oPPrev is a file and a proper prefix of oPPath
+  * BAD_PATH if oPPath sorts before oPPrev
+*/
+static int FT_checkBuildOrder(Path_T oPPrev, nodeType prevType,
+                              Path_T oPPath, size_t ulShared) {
+    assert(oPPrev != NULL);
+    assert(oPPath != NULL);
+
+    if(ulShared == 0)
         return CONFLICTING_PATH;
-    }
-    else { /* insert file as non-root */
-        ulIndex = Path_getDepth(Node_getPath(oNCurr))+1;
 
-        /* oNCurr is the node we're trying to insert */
-        if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                        Node_getPath(oNCurr))) {
-            Path_free(oPPath);
-            return ALREADY_IN_TREE;
-        }
+    if(ulShared == Path_getDepth(oPPath))
+        return ALREADY_IN_TREE;
+
+    /* oPPath is underneath oPPrev */
+    if(ulShared == Path_getDepth(oPPrev)) {
+        if(prevType == IS_FILE)
+            return NOT_A_DIRECTORY;
+        return SUCCESS;
+    }
+
+    /* siblings at the first differing level must be increasing */
+    if(strcmp(Path_getComponent(oPPath, ulShared),
+              Path_getComponent(oPPrev, ulShared)) < 0)
+        return BAD_PATH;
+
+    return SUCCESS;
+}
+
+/*
+  Closes the open directory oNDir: every node after oNDir at the end
+  of oDPending is one of its direct children, in sorted order, and is
+  adopted into oNDir's child array. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_closeBuildDir(Node_T oNDir, DynArray_T oDPending) {
+    size_t ulFirst;
+
+    assert(oNDir != NULL);
+    assert(oDPending != NULL);
+
+    /* walk back to oNDir itself; children are linear in total */
+    ulFirst = DynArray_getLength(oDPending);
+    assert(ulFirst > 0);
+    while(DynArray_get(oDPending, ulFirst - 1) != oNDir) {
+        ulFirst--;
+        assert(ulFirst > 0);
+    }
+
+    return Node_adoptChildren(oNDir, oDPending, ulFirst);
+}
+
+/*
+  Creates the nodes for levels ulFrom through the depth of oPPath,
+  the last of type type (with contents pvContents of ulLength bytes if
+  it is a file) and the rest directories. Each new node is appended to
+  oDPending, and each new directory is pushed onto oDOpen.
+  Increments *pulNewNodes for every node created. Returns SUCCESS or:
+  * CONFLICTING_PATH if a file would become the root
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_buildLevels(Path_T oPPath, size_t ulFrom, nodeType type,
+                          void *pvContents, size_t ulLength,
+                          DynArray_T oDPending, DynArray_T oDOpen,
+                          size_t *pulNewNodes) {
+    int iStatus;
+    size_t ulDepth = Path_getDepth(oPPath);
+    size_t ulLevel;
+
+    assert(oDPending != NULL);
+    assert(oDOpen != NULL);
+    assert(pulNewNodes != NULL);
+
+    if(ulDepth == 1 && type == IS_FILE)
+        return CONFLICTING_PATH;
+
+    for(ulLevel = ulFrom; ulLevel <= ulDepth; ulLevel++) {
+        Path_T oPPrefix = NULL;
+        Node_T oNNew = NULL;
+        nodeType levelType = IS_DIRECTORY;
+
+        if(ulLevel == ulDepth)
+            levelType = type;
+
+        iStatus = Path_prefix(oPPath, ulLevel, &oPPrefix);
+        if(iStatus != SUCCESS)
+            return iStatus;
+        iStatus = Node_newUnlinked(oPPrefix, levelType, &oNNew);
+        Path_free(oPPrefix);
+        if(iStatus != SUCCESS)
+            return iStatus;
+
+        if(!DynArray_add(oDPending, oNNew)) {
+            (void) Node_free(oNNew);
+            return MEMORY_ERROR;
+        }
+        (*pulNewNodes)++;
+
+        if(levelType == IS_FILE)
+            (void) Node_insertFileContents(oNNew, pvContents, ulLength);
+        else if(!DynArray_add(oDOpen, oNNew))
+            return MEMORY_ERROR;
+    }
+
+    return SUCCESS;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions keep oFT's name index, if it has one, in
+  step with the hierarchy. A writer adds the nodes it linked while it
+  still holds the lock of the directory they went into, so a removal
+  of that directory, which must take the same lock, cannot unindex
+  them first. The index is dropped, and searches fall back to walking
+  the hierarchy, if it cannot be kept up to date for lack of memory.
+*/
+
+/*
+  Returns TRUE if oFT might have a name index. In thread-safe builds
+  the fence pairs with the one in FT_setNameIndexIn: either a writer
+  sees the new index here, or the walk building it sees the nodes the
+  writer linked or unlinked just before.
+*/
+static boolean FT_mayHaveIndex(FT_T oFT) {
+    assert(oFT != NULL);
+
+#ifdef FT_THREADSAFE
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+    return (boolean) (Epoch_load(&oFT->oIndex) != NULL);
+}
+
+/*
+  Frees oFT's name index, resetting the index slots of the nodes in
+  it. The caller holds oFT's index lock.
+*/
+static void FT_dropIndex(FT_T oFT) {
+    NameIndex_T oIndex;
+
+    assert(oFT != NULL);
+
+    oIndex = oFT->oIndex;
+    if(oIndex != NULL) {
+        Epoch_store(&oFT->oIndex, NULL);
+        NameIndex_free(oIndex, TRUE);
+    }
+}
+
+/* Adds the subtree rooted at oNNode, just linked, to oFT's index. */
+static void FT_indexSubtree(FT_T oFT, Node_T oNNode) {
+    assert(oFT != NULL);
+    assert(oNNode != NULL);
+
+    if(!FT_mayHaveIndex(oFT))
+        return;
+
+    FT_lockIndex(oFT);
+    if(oFT->oIndex != NULL &&
+       NameIndex_addSubtree(oFT->oIndex, oNNode) != SUCCESS)
+        FT_dropIndex(oFT);
+    FT_unlockIndex(oFT);
+}
+
+/*
+  Frees the subtree rooted at oNNode as Node_free does, and removes
+  it from oFT's index. Returns the number of nodes freed, or 0 if
+  Node_free could not unlink it, in which case it is left in place.
+
+  In thread-safe builds the subtree is unindexed after Node_free has
+  turned writers away from it, so that none can add to it afterwards;
+  its nodes stay allocated until the caller's critical section ends.
+  Otherwise Node_free frees them at once, so they are unindexed first.
+*/
+static size_t FT_freeSubtree(FT_T oFT, Node_T oNNode) {
+    size_t ulCount;
+
+    assert(oFT != NULL);
+    assert(oNNode != NULL);
+
+#ifdef FT_THREADSAFE
+    ulCount = Node_free(oNNode);
+    if(ulCount == 0)
+        return 0;
+#endif
+    if(FT_mayHaveIndex(oFT)) {
+        FT_lockIndex(oFT);
+        if(oFT->oIndex != NULL)
+            NameIndex_removeSubtree(oFT->oIndex, oNNode);
+        FT_unlockIndex(oFT);
+    }
+#ifndef FT_THREADSAFE
+    ulCount = Node_free(oNNode);
+#endif
+    return ulCount;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions make one attempt each at changing
+  the FT, from inside an epoch critical section. Each finds its way
+  with lock-free lookups, then locks the directory it must change and
+  makes sure that directory has not been removed in the meantime; if
+  it has, the attempt returns FALSE and is retried from the root.
+  Locks are only ever taken parent before child.
+*/
+
+/*
+  The contents to give a file: either ulLength bytes at pvContents,
+  borrowed from the caller (or copied into a new file's node if
+  bInline is TRUE), or, if oContent is not NULL, a buffer the file
+  takes a reference to.
+*/
+struct fileContents {
+    void *pvContents;
+    size_t ulLength;
+    Content_T oContent;
+    boolean bInline;
+};
+
+/* Releases the reference to a store that Epoch_retire was given. */
+static void FT_releaseStore(void *pvStore) {
+    ContentStore_release(pvStore);
+}
+
+/*
+  Gives up oFT's content store, if it has one, whose field the caller
+  holds the root lock to change. Writers that loaded it already may
+  still intern contents in it until they leave their critical
+  sections.
+*/
+static void FT_dropStore(FT_T oFT) {
+    ContentStore_T oStore;
+
+    assert(oFT != NULL);
+
+    oStore = oFT->oStore;
+    if(oStore != NULL) {
+        Epoch_store(&oFT->oStore, NULL);
+        Epoch_retire(oStore, FT_releaseStore);
+    }
+}
+
+/*
+  If oFT has a content store, and psContents describes bytes that are
+  borrowed, or owned in a flat buffer neither interned yet nor mapped
+  (whose bytes take only page cache), makes it
+  describe the buffer holding those bytes in the store instead, and
+  stores in *poStored the reference the caller then holds to it, to
+  release once the file has taken its own; otherwise sets *poStored
+  to NULL. Must be called from an epoch critical section. Returns
+  SUCCESS, or MEMORY_ERROR.
+*/
+static int FT_storeContents(FT_T oFT, struct fileContents *psContents,
+                            Content_T *poStored) {
+    ContentStore_T oStore;
+    Content_T oContent;
+
+    assert(oFT != NULL);
+    assert(psContents != NULL);
+    assert(poStored != NULL);
+
+    *poStored = NULL;
+    oStore = Epoch_load(&oFT->oStore);
+    if(oStore == NULL)
+        return SUCCESS;
+
+    oContent = psContents->oContent;
+    if(oContent == NULL) {
+        /* NULL contents stay borrowed; there is nothing to share */
+        if(psContents->pvContents == NULL)
+            return SUCCESS;
+        *poStored = ContentStore_intern(oStore, psContents->pvContents,
+                                        psContents->ulLength);
+    }
+    else if(Content_getStore(oContent) == NULL &&
+            Content_getData(oContent) != NULL &&
+            !Content_isMapped(oContent))
+        *poStored = ContentStore_intern(oStore, Content_getData(oContent),
+                                        Content_getLength(oContent));
+    else
+        return SUCCESS;
+
+    if(*poStored == NULL)
+        return MEMORY_ERROR;
+    psContents->oContent = *poStored;
+    return SUCCESS;
+}
+
+/* Gives file oNNode the contents psContents describes. */
+static void FT_setContents(Node_T oNNode,
+                           const struct fileContents *psContents) {
+    assert(oNNode != NULL);
+    assert(psContents != NULL);
+
+    Node_markUsed(oNNode);
+    if(psContents->oContent != NULL)
+        (void) Node_setContent(oNNode, psContents->oContent);
+    else
+        (void) Node_insertFileContents(oNNode, psContents->pvContents,
+                                       psContents->ulLength);
+}
+
+/*
+  Returns TRUE if oNNode is still a child of oNParent, whose lock the
+  caller holds, and neither has been removed; FALSE otherwise.
+*/
+static boolean FT_isLinked(Node_T oNParent, Node_T oNNode) {
+    Path_T oPPath;
+    const char *pcName;
+    Node_T oNChild = NULL;
+
+    assert(oNParent != NULL);
+    assert(oNNode != NULL);
+
+    if(Node_isRemoved(oNParent))
+        return FALSE;
+
+    oPPath = Node_getPath(oNNode);
+    pcName = Path_getComponent(oPPath, Path_getDepth(oPPath) - 1);
+    return (boolean) (Node_findChild(oNParent, pcName, strlen(pcName),
+                                     &oNChild) && oNChild == oNNode);
+}
+
+/*
+  Creates the nodes for levels ulFrom through the depth of oPPath
+  under oNParent (or as a new root, if oNParent is NULL), the last of
+  type type (with contents psContents if it is a file) and the rest
+  directories. The new nodes are linked to each
+  other first and to oNParent last, whose lock the caller holds, so
+  that no other writer can reach them before they are all in place.
+  Sets *poNFirstNew to the first new node and adds the number created
+  to *pulNewNodes. Returns SUCCESS, or the status of the failing Node
+  or Path function, in which case no new node remains.
+*/
+static int FT_buildChain(Path_T oPPath, size_t ulFrom, nodeType type,
+                         const struct fileContents *psContents,
+                         Node_T oNParent, Node_T *poNFirstNew,
+                         size_t *pulNewNodes) {
+    int iStatus = SUCCESS;
+    Node_T oNPrev = NULL;
+    size_t ulDepth = Path_getDepth(oPPath);
+    size_t ulIndex;
+
+    assert(oPPath != NULL);
+    assert(ulFrom <= ulDepth);
+    assert(poNFirstNew != NULL);
+    assert(pulNewNodes != NULL);
+
+    *poNFirstNew = NULL;
+
+    /* build rest of the path one level at a time */
+    for(ulIndex = ulFrom; ulIndex <= ulDepth && iStatus == SUCCESS;
+        ulIndex++) {
+        Path_T oPPrefix = NULL;
+        Node_T oNNewNode = NULL;
+        nodeType levelType = IS_DIRECTORY;
+
+        if(ulIndex == ulDepth)
+            levelType = type;
+
+        /* generate a Path_T for this level */
+        iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
+        if(iStatus != SUCCESS)
+            break;
+        if(levelType == IS_FILE && psContents->bInline)
+            iStatus = Node_newInline(oPPrefix, psContents->pvContents,
+                                     psContents->ulLength, &oNNewNode);
+        else
+            iStatus = Node_newUnlinked(oPPrefix, levelType, &oNNewNode);
+        Path_free(oPPrefix);
+        if(iStatus != SUCCESS)
+            break;
+
+        /* check if file, insert contents if yes */
+        if(levelType == IS_FILE) {
+            if(psContents->bInline)
+                Node_markUsed(oNNewNode);
+            else
+                FT_setContents(oNNewNode, psContents);
+        }
+
+        if(oNPrev == NULL)
+            *poNFirstNew = oNNewNode;
+        else {
+            iStatus = Node_link(oNPrev, oNNewNode);
+            if(iStatus != SUCCESS)
+                (void) Node_free(oNNewNode);
+        }
+        oNPrev = oNNewNode;
+    }
+
+    /* publish the whole chain at once */
+    if(iStatus == SUCCESS && oNParent != NULL)
+        iStatus = Node_link(oNParent, *poNFirstNew);
+
+    if(iStatus != SUCCESS) {
+        if(*poNFirstNew != NULL)
+            (void) Node_free(*poNFirstNew);
+        *poNFirstNew = NULL;
+        return iStatus;
+    }
+
+    *pulNewNodes += ulDepth - ulFrom + 1;
+    return SUCCESS;
+}
+
+/*
+  Makes one attempt to insert oPPath, and any missing ancestors, as
+  the root of oFT, which a lookup found to have none. The new node is
+  of type type, with contents psContents if it is a file. Returns
+  FALSE if another writer set a root first; otherwise returns TRUE and
+  sets *piStatus as for FT_tryInsert.
+*/
+static boolean FT_tryInsertRoot(FT_T oFT, Path_T oPPath, nodeType type,
+                                const struct fileContents *psContents,
+                                int *piStatus) {
+    Node_T oNNewRoot = NULL;
+    size_t ulNewNodes = 0;
+    boolean bSettled = TRUE;
+
+    assert(oFT != NULL);
+    assert(oPPath != NULL);
+    assert(piStatus != NULL);
+
+    FT_lockRoot(oFT);
+    if(!oFT->bIsInitialized)
+        *piStatus = INITIALIZATION_ERROR;
+    else if(oFT->oNRoot != NULL)
+        bSettled = FALSE;
+    else if(type == IS_FILE) /* attempts to insert file as root */
+        *piStatus = CONFLICTING_PATH;
+    else {
+        *piStatus = FT_buildChain(oPPath, 1, type, psContents, NULL,
+                                  &oNNewRoot, &ulNewNodes);
+        if(*piStatus == SUCCESS) {
+            FT_addCount(oFT, ulNewNodes);
+            Epoch_store(&oFT->oNRoot, oNNewRoot);
+            FT_indexSubtree(oFT, oNNewRoot);
+        }
+    }
+    FT_unlockRoot(oFT);
+
+    return bSettled;
+}
+
+/*
+  Makes one attempt to insert oPPath, and any missing ancestors, into
+  oFT. The new node is of type type, with contents psContents if it
+  is a file. Returns FALSE if the attempt must be retried; otherwise
+  returns TRUE and sets *piStatus to the result documented for
+  FT_insertDir or FT_insertFile.
+
+  The closest existing ancestor is found without locks and then
+  locked. Any levels another writer added below it meanwhile are
+  followed hand over hand, locking each child before releasing its
+  parent, and the rest of the path is built under the last one.
+*/
+static boolean FT_tryInsert(FT_T oFT, Path_T oPPath, nodeType type,
+                            const struct fileContents *psContents,
+                            int *piStatus) {
+    Node_T oNCurr = NULL;
+    Node_T oNFirstNew = NULL;
+    size_t ulDepth, ulIndex;
+    size_t ulNewNodes = 0;
+
+    assert(oFT != NULL);
+    assert(oPPath != NULL);
+    assert(piStatus != NULL);
+
+    if(!Epoch_load(&oFT->bIsInitialized)) {
+        *piStatus = INITIALIZATION_ERROR;
+        return TRUE;
+    }
+
+    /* find the closest ancestor of oPPath already in the tree */
+    *piStatus = FT_traversePath(oFT, oPPath, &oNCurr);
+    if(*piStatus != SUCCESS)
+        return TRUE;
+
+    if(oNCurr == NULL) /* new root! */
+        return FT_tryInsertRoot(oFT, oPPath, type, psContents,
+                                piStatus);
+
+    ulDepth = Path_getDepth(oPPath);
+    ulIndex = Path_getDepth(Node_getPath(oNCurr)) + 1;
+
+    /* oNCurr is the node we're trying to insert */
+    if(ulIndex == ulDepth + 1) {
+        *piStatus = ALREADY_IN_TREE;
+        return TRUE;
+    }
+
+    /* a file never gains children, so refusing needs no lock */
+    if(Node_getType(oNCurr) == IS_FILE) {
+        *piStatus = NOT_A_DIRECTORY;
+        return TRUE;
+    }
+
+    Node_lock(oNCurr);
+    if(Node_isRemoved(oNCurr)) {
+        Node_unlock(oNCurr);
+        return FALSE;
+    }
+
+    /* follow any levels added since the lookup, hand over hand */
+    while(ulIndex <= ulDepth) {
+        const char *pcName = Path_getComponent(oPPath, ulIndex - 1);
+        Node_T oNChild = NULL;
+
+        if(!Node_findChild(oNCurr, pcName, strlen(pcName), &oNChild))
+            break;
+
+        if(ulIndex == ulDepth)
+            *piStatus = ALREADY_IN_TREE;
+        else if(Node_getType(oNChild) == IS_FILE)
+            *piStatus = (ulIndex + 1 == ulDepth) ? NOT_A_DIRECTORY
+                                                 : BAD_PATH;
+        if(*piStatus != SUCCESS) {
+            Node_unlock(oNCurr);
+            return TRUE;
+        }
+
+        /* oNChild cannot be removed while its parent is locked */
+        Node_lock(oNChild);
+        Node_unlock(oNCurr);
+        oNCurr = oNChild;
+        ulIndex++;
+    }
+
+    *piStatus = FT_buildChain(oPPath, ulIndex, type, psContents,
+                              oNCurr, &oNFirstNew, &ulNewNodes);
+    if(*piStatus == SUCCESS) {
+        FT_addCount(oFT, ulNewNodes);
+        FT_indexSubtree(oFT, oNFirstNew);
+    }
+    Node_unlock(oNCurr);
+
+    return TRUE;
+}
+
+/*
+  Makes one attempt to remove the node with absolute path pcPath from
+  oFT, which must be of type type, along with everything under it.
+  Returns FALSE if the node or its parent changed after the lookup and
+  the attempt must be retried; otherwise returns TRUE and sets
+  *piStatus to the result documented for FT_rmDir or FT_rmFile.
+*/
+static boolean FT_tryRemove(FT_T oFT, const char *pcPath, nodeType type,
+                            int *piStatus) {
+    Node_T oNFound = NULL;
+    Node_T oNParent;
+    boolean bSettled = TRUE;
+    size_t ulCount;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(piStatus != NULL);
+
+    *piStatus = FT_findNode(oFT, pcPath, &oNFound);
+    if(*piStatus != SUCCESS)
+        return TRUE;
+
+    /* file, not directory, or directory, not file */
+    if(Node_getType(oNFound) != type) {
+        *piStatus = (type == IS_DIRECTORY) ? NOT_A_DIRECTORY
+                                           : NOT_A_FILE;
+        return TRUE;
+    }
+
+    oNParent = Node_getParent(oNFound);
+    if(oNParent == NULL) {
+        /* removing the whole hierarchy */
+        FT_lockRoot(oFT);
+        if(oFT->oNRoot != oNFound)
+            bSettled = FALSE;
+        else {
+            Epoch_store(&oFT->oNRoot, NULL);
+            FT_subtractCount(oFT, FT_freeSubtree(oFT, oNFound));
+        }
+        FT_unlockRoot(oFT);
+        return bSettled;
+    }
+
+    /* free subtree from its parent */
+    Node_lock(oNParent);
+    if(FT_isLinked(oNParent, oNFound)) {
+        ulCount = FT_freeSubtree(oFT, oNFound);
+        if(ulCount == 0)
+            *piStatus = MEMORY_ERROR;
+        FT_subtractCount(oFT, ulCount);
+    }
+    else
+        bSettled = FALSE;
+    Node_unlock(oNParent);
+
+    return bSettled;
+}
+
+/*
+  Makes one attempt to replace the contents of the file with absolute
+  path pcPath in oFT with psNewContents. Returns FALSE if the file
+  changed after the lookup and the attempt must be retried; otherwise
+  returns TRUE and sets *piStatus to SUCCESS, or to NOT_A_FILE or the
+  status of FT_findNode if there is no such file. On success, sets
+  *ppvOldContents to the old contents if they were borrowed from the
+  caller, or to NULL if the file owned them or held them inline;
+  otherwise to NULL.
+*/
+static boolean FT_tryReplace(FT_T oFT, const char *pcPath,
+                             const struct fileContents *psNewContents,
+                             void **ppvOldContents, int *piStatus) {
+    Node_T oNFound = NULL;
+    Node_T oNParent;
+    boolean bSettled = TRUE;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(psNewContents != NULL);
+    assert(ppvOldContents != NULL);
+    assert(piStatus != NULL);
+
+    *ppvOldContents = NULL;
+
+    /* search for the node in the FT */
+    *piStatus = FT_findNode(oFT, pcPath, &oNFound);
+    if(*piStatus != SUCCESS)
+        return TRUE;
+    if(Node_getType(oNFound) != IS_FILE) {
+        *piStatus = NOT_A_FILE;
+        return TRUE;
+    }
+
+    /* a file is never the root */
+    oNParent = Node_getParent(oNFound);
+    assert(oNParent != NULL);
+
+    Node_lock(oNParent);
+    if(FT_isLinked(oNParent, oNFound)) {
+        /* store old contents to return, unless the file owned them
+           or held its own copy */
+        if(Node_getContent(oNFound) == NULL &&
+           !Node_hasInlineContents(oNFound))
+            *ppvOldContents = Node_getContents(oNFound);
+        FT_setContents(oNFound, psNewContents);
+    }
+    else
+        bSettled = FALSE;
+    Node_unlock(oNParent);
+
+    return bSettled;
+}
+
+/* The contents of a file, as a reader loaded them */
+struct loadedContents {
+    /* the file, and the buffer it owns, or NULL if they are borrowed */
+    Node_T oNFile;
+    Content_T oContent;
+    /* the bytes, and how many there are */
+    const char *pcData;
+    size_t ulSize;
+};
+
+/*
+  Loads the contents of file oNNode into *psLoaded. Returns TRUE, or
+  FALSE if bLocked is FALSE and they are in a writable buffer, which
+  may be changing unless the caller holds the lock of oNNode's parent,
+  as bLocked says it does, or in a compressed one, which must be
+  decompressed under that lock first (see FT_thawContents).
+*/
+static boolean FT_loadContents(Node_T oNNode, boolean bLocked,
+                               struct loadedContents *psLoaded) {
+    Content_T oContent;
+
+    assert(oNNode != NULL);
+    assert(psLoaded != NULL);
+
+    psLoaded->oNFile = oNNode;
+    oContent = Node_getContent(oNNode);
+    if(oContent == NULL) {
+        /* the address and size of borrowed contents, from one writer */
+        psLoaded->pcData = Node_getContentsAndSize(oNNode,
+                                                   &psLoaded->ulSize);
+        if(psLoaded->pcData == NULL)
+            psLoaded->ulSize = 0;
+        /* a buffer is published before its bytes' address and size,
+           so loading those from one means seeing it here */
+        oContent = Node_getContent(oNNode);
+    }
+    psLoaded->oContent = oContent;
+    if(oContent == NULL)
+        return TRUE;
+
+    if(!bLocked && (Content_isWritable(oContent) ||
+                    Content_isCompressed(oContent)))
+        return FALSE;
+    assert(!Content_isCompressed(oContent));
+    psLoaded->pcData = Content_getData(oContent);
+    psLoaded->ulSize = Content_getLength(oContent);
+    return TRUE;
+}
+
+/*
+  Replaces the compressed contents of file oNNode, whose parent's lock
+  the caller holds, if they are compressed, with a decompressed copy.
+  Returns SUCCESS, or MEMORY_ERROR if the copy could not be allocated.
+*/
+static int FT_thawContents(Node_T oNNode) {
+    Content_T oContent;
+    Content_T oThawed;
+
+    assert(oNNode != NULL);
+
+    oContent = Node_getContent(oNNode);
+    if(oContent == NULL || !Content_isCompressed(oContent))
+        return SUCCESS;
+
+    oThawed = Content_decompress(oContent);
+    if(oThawed == NULL)
+        return MEMORY_ERROR;
+    (void) Node_setContent(oNNode, oThawed);
+    Content_release(oThawed);
+    return SUCCESS;
+}
+
+/*
+  Makes one attempt to load the contents of the file with absolute
+  path pcPath in oFT into *psLoaded, marking them used: without locks
+  if possible, or else holding the lock of the file's parent, which is
+  then left held for the caller to release and stored in *poNLocked
+  (or NULL if none is held). Returns FALSE if the file changed after
+  the lookup and the attempt must be retried; otherwise returns TRUE
+  and sets *piStatus to SUCCESS, to MEMORY_ERROR if compressed
+  contents could not be decompressed, or to NOT_A_FILE or the status
+  of FT_findNode if there is no such file.
+*/
+static boolean FT_tryLoadFile(FT_T oFT, const char *pcPath,
+                              struct loadedContents *psLoaded,
+                              Node_T *poNLocked, int *piStatus) {
+    Node_T oNFound = NULL;
+    Node_T oNParent;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(psLoaded != NULL);
+    assert(poNLocked != NULL);
+    assert(piStatus != NULL);
+
+    *poNLocked = NULL;
+
+    *piStatus = FT_findNode(oFT, pcPath, &oNFound);
+    if(*piStatus != SUCCESS)
+        return TRUE;
+    if(Node_getType(oNFound) != IS_FILE) {
+        *piStatus = NOT_A_FILE;
+        return TRUE;
+    }
+
+    Node_markUsed(oNFound);
+    if(FT_loadContents(oNFound, FALSE, psLoaded))
+        return TRUE;
+
+    /* a writable buffer is read under the lock its writers hold, and a
+       compressed one decompressed under it */
+    oNParent = Node_getParent(oNFound);
+    assert(oNParent != NULL);
+    Node_lock(oNParent);
+    if(!FT_isLinked(oNParent, oNFound)) {
+        Node_unlock(oNParent);
+        return FALSE;
+    }
+    *piStatus = FT_thawContents(oNFound);
+    if(*piStatus != SUCCESS) {
+        Node_unlock(oNParent);
+        return TRUE;
+    }
+    (void) FT_loadContents(oNFound, TRUE, psLoaded);
+    *poNLocked = oNParent;
+    return TRUE;
+}
+
+/*
+  Writes the ulLength bytes at pvData into file oNNode at ulOffset, or
+  at its end if bAppend is TRUE, while the caller holds the lock of
+  oNNode's parent. Bytes are written in place if
+  oNNode owns a writable buffer with room for them; otherwise they go
+  into a new writable copy of its contents. A flat copy has room to
+  double in size if it grows, so that a run of writes extending the
+  file copies it only O(log n) times; a chunked copy, made if the
+  contents are chunked already or bChunked is TRUE, shares its chunks
+  with the original, and copies only those it writes to. Returns
+  SUCCESS, or MEMORY_ERROR if the file would not fit in memory, in
+  which case it is unchanged.
+*/
+static int FT_writeContents(Node_T oNNode, size_t ulOffset,
+                            boolean bAppend, const void *pvData,
+                            size_t ulLength, boolean bChunked) {
+    struct loadedContents sLoaded;
+    Content_T oNewContent;
+    size_t ulEnd, ulCapacity;
+
+    assert(oNNode != NULL);
+    assert(pvData != NULL || ulLength == 0);
+
+    if(ulLength == 0)
+        return SUCCESS;
+
+    Node_markUsed(oNNode);
+    if(FT_thawContents(oNNode) != SUCCESS)
+        return MEMORY_ERROR;
+    (void) FT_loadContents(oNNode, TRUE, &sLoaded);
+    if(bAppend)
+        ulOffset = sLoaded.ulSize;
+    if(ulOffset > (size_t) -1 - ulLength)
+        return MEMORY_ERROR;
+    ulEnd = ulOffset + ulLength;
+    if(sLoaded.oContent != NULL && Content_isWritable(sLoaded.oContent)
+       && Content_hasRoom(sLoaded.oContent, ulEnd)) {
+        if(Content_write(sLoaded.oContent, ulOffset, pvData, ulLength)
+           != SUCCESS)
+            return MEMORY_ERROR;
+        Node_updateSize(oNNode);
+        return SUCCESS;
+    }
+
+    /* copy on write, leaving room to grow */
+    ulCapacity = sLoaded.ulSize;
+    if(ulEnd > ulCapacity) {
+        ulCapacity = ulEnd;
+        if(sLoaded.ulSize <= ((size_t) -1) / 2 &&
+           ulCapacity < 2 * sLoaded.ulSize)
+            ulCapacity = 2 * sLoaded.ulSize;
+    }
+    if(sLoaded.oContent != NULL &&
+       (Content_isChunked(sLoaded.oContent) || !bChunked))
+        oNewContent = Content_newWritableCopy(sLoaded.oContent,
+                                              ulCapacity);
+    else if(bChunked)
+        oNewContent = Content_newChunked(sLoaded.pcData, sLoaded.ulSize);
+    else
+        oNewContent = Content_newWritable(sLoaded.pcData, sLoaded.ulSize,
+                                          ulCapacity);
+    if(oNewContent == NULL)
+        return MEMORY_ERROR;
+    if(Content_write(oNewContent, ulOffset, pvData, ulLength)
+       != SUCCESS) {
+        Content_release(oNewContent);
+        return MEMORY_ERROR;
+    }
+    (void) Node_setContent(oNNode, oNewContent);
+    Content_release(oNewContent);
+    return SUCCESS;
+}
+
+/*
+  Returns the bytes of memory the buffer file oNNode owns takes, or 0
+  if it owns none. The caller holds the lock of oNNode's parent.
+*/
+static size_t FT_getFootprint(Node_T oNNode) {
+    Content_T oContent;
+
+    assert(oNNode != NULL);
+
+    oContent = Node_getContent(oNNode);
+    if(oContent == NULL)
+        return 0;
+    return Content_getFootprint(oContent);
+}
+
+/*
+  Makes one attempt to write the ulLength bytes at pvData into the
+  file with absolute path pcPath in oFT at ulOffset, or at its end if
+  bAppend is TRUE. Returns FALSE if the file changed after the lookup
+  and the attempt must be retried; otherwise returns TRUE and sets
+  *piStatus to the result documented for FT_writeAt, and *pulGrowth to
+  the bytes of memory the file's contents grew by, if any.
+*/
+static boolean FT_tryWriteAt(FT_T oFT, const char *pcPath,
+                             size_t ulOffset, boolean bAppend,
+                             const void *pvData, size_t ulLength,
+                             int *piStatus, size_t *pulGrowth) {
+    Node_T oNFound = NULL;
+    Node_T oNParent;
+    boolean bSettled = TRUE;
+    size_t ulBefore, ulAfter;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(piStatus != NULL);
+    assert(pulGrowth != NULL);
+
+    *pulGrowth = 0;
+
+    *piStatus = FT_findNode(oFT, pcPath, &oNFound);
+    if(*piStatus != SUCCESS)
+        return TRUE;
+    if(Node_getType(oNFound) != IS_FILE) {
+        *piStatus = NOT_A_FILE;
+        return TRUE;
+    }
+
+    /* a file is never the root */
+    oNParent = Node_getParent(oNFound);
+    assert(oNParent != NULL);
+
+    Node_lock(oNParent);
+    if(FT_isLinked(oNParent, oNFound)) {
+        ulBefore = FT_getFootprint(oNFound);
+        *piStatus = FT_writeContents(oNFound, ulOffset, bAppend, pvData,
+                                     ulLength,
+                                     Epoch_load(&oFT->bChunked));
+        ulAfter = FT_getFootprint(oNFound);
+        if(ulAfter > ulBefore)
+            *pulGrowth = ulAfter - ulBefore;
+    }
+    else
+        bSettled = FALSE;
+    Node_unlock(oNParent);
+
+    return bSettled;
+}
+
+/*
+  Makes one attempt to describe in *psContents the contents of the
+  file with absolute path pcPath in oFT, for a clone of it to take:
+  the buffer the file owns, frozen so that the next write through
+  either file copies it, with a reference the caller must release;
+  the file's inline bytes, which stay allocated until the caller
+  leaves its epoch critical section; or the bytes it borrows. Returns
+  FALSE if the file changed after the lookup and the attempt must be
+  retried; otherwise returns TRUE and sets *piStatus to SUCCESS, or to
+  NOT_A_FILE or the status of FT_findNode if there is no such file.
+*/
+static boolean FT_tryShareFile(FT_T oFT, const char *pcPath,
+                               struct fileContents *psContents,
+                               int *piStatus) {
+    Node_T oNFound = NULL;
+    Node_T oNParent;
+    Content_T oContent;
+    boolean bSettled = TRUE;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(psContents != NULL);
+    assert(piStatus != NULL);
+
+    *piStatus = FT_findNode(oFT, pcPath, &oNFound);
+    if(*piStatus != SUCCESS)
+        return TRUE;
+    if(Node_getType(oNFound) != IS_FILE) {
+        *piStatus = NOT_A_FILE;
+        return TRUE;
+    }
+
+    /* a file is never the root */
+    oNParent = Node_getParent(oNFound);
+    assert(oNParent != NULL);
+
+    Node_lock(oNParent);
+    if(FT_isLinked(oNParent, oNFound)) {
+        oContent = Node_getContent(oNFound);
+        psContents->oContent = NULL;
+        psContents->bInline = FALSE;
+        if(oContent != NULL) {
+            /* compressed contents are shared as they are */
+            Content_freeze(oContent);
+            psContents->oContent = Content_retain(oContent);
+        }
+        else {
+            psContents->pvContents = Node_getContents(oNFound);
+            psContents->ulLength = Node_getSize(oNFound);
+            psContents->bInline = Node_hasInlineContents(oNFound);
+        }
+    }
+    else
+        bSettled = FALSE;
+    Node_unlock(oNParent);
+
+    return bSettled;
+}
+
+/*
+  Inserts a node of type type with absolute path pcPath into oFT, with
+  contents psContents if it is a file, retrying until an attempt
+  settles. Returns the status documented for FT_insertDir or
+  FT_insertFile.
+*/
+static int FT_insert(FT_T oFT, const char *pcPath, nodeType type,
+                     const struct fileContents *psContents) {
+    int iStatus;
+    Path_T oPPath = NULL;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+
+    /* validate pcPath and generate a Path_T for it */
+    if(!Epoch_load(&oFT->bIsInitialized))
+        return INITIALIZATION_ERROR;
+
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    iStatus = Epoch_enter();
+    if(iStatus == SUCCESS) {
+        while(!FT_tryInsert(oFT, oPPath, type, psContents, &iStatus))
+            ;
+        Epoch_exit();
+    }
+
+    Path_free(oPPath);
+    return iStatus;
+}
+
+/*
+  Removes the node of type type with absolute path pcPath from oFT,
+  retrying until an attempt settles. Returns the status documented for
+  FT_rmDir or FT_rmFile.
+*/
+static int FT_remove(FT_T oFT, const char *pcPath, nodeType type) {
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    while(!FT_tryRemove(oFT, pcPath, type, &iStatus))
+        ;
+    Epoch_exit();
+
+    return iStatus;
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_containsDirIn, called from an epoch critical section. */
+static boolean FT_containsDirUnlocked(FT_T oFT, const char *pcPath) {
+
+    int iStatus;
+    Node_T oNFound = NULL;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+
+    /* no possible path if no root */
+    if (Epoch_load(&oFT->oNRoot) == NULL)
+        return FALSE;
+
+    iStatus = FT_findNode(oFT, pcPath, &oNFound);
+    if (iStatus != SUCCESS)
+        return FALSE;
+
+    /* file, not directory */
+    if (Node_getType(oNFound) != IS_DIRECTORY) {
+        return FALSE;
+    }
+    return (boolean) (iStatus == SUCCESS);
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_containsFileIn, called from an epoch critical section. */
+static boolean FT_containsFileUnlocked(FT_T oFT, const char *pcPath) {
+    int iStatus;
+    Node_T oNFound = NULL;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+
+    if (Epoch_load(&oFT->oNRoot) == NULL)
+        return FALSE;
+
+    /* search for file node in the FT */
+    iStatus = FT_findNode(oFT, pcPath, &oNFound);
+
+    if (iStatus != SUCCESS)
+        return FALSE;
+    /* directory, not file */ 
+    if (Node_getType(oNFound) != IS_FILE) {
+        return FALSE;
+    }
+    return (boolean) (iStatus == SUCCESS);
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  FT_getFileContentsIn, called from an epoch critical section. The
+  buffer the bytes returned are in is pinned, so that budget sweeps
+  leave it to the file until its contents are replaced.
+*/
+static void *FT_getFileContentsUnlocked(FT_T oFT, const char *pcPath) {
+    struct loadedContents sLoaded;
+    Node_T oNLocked = NULL;
+    Node_T oNParent;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+
+    for(;;) {
+        /* compressed contents are decompressed, and stay so until a
+           sweep finds them cold again */
+        while(!FT_tryLoadFile(oFT, pcPath, &sLoaded, &oNLocked,
+                              &iStatus))
+            ;
+        if(iStatus != SUCCESS || sLoaded.oContent == NULL ||
+           Node_isPinned(sLoaded.oNFile))
+            break;
+        if(oNLocked != NULL) {
+            Node_pin(sLoaded.oNFile);
+            break;
+        }
+        /* pin under the lock sweeps hold, then load again, since a
+           sweep may have replaced the buffer loaded before */
+        oNParent = Node_getParent(sLoaded.oNFile);
+        Node_lock(oNParent);
+        if(FT_isLinked(oNParent, sLoaded.oNFile))
+            Node_pin(sLoaded.oNFile);
+        Node_unlock(oNParent);
+    }
+    if(oNLocked != NULL)
+        Node_unlock(oNLocked);
+    if(iStatus != SUCCESS)
+        return NULL;
+    return (void *) sLoaded.pcData;
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  FT_getFileContentIn, called from an epoch critical section, which
+  keeps the buffer a file owns allocated long enough to take a new
+  reference to it. A writable buffer is frozen first, so that writes
+  after the lease copy it instead.
+*/
+static int FT_getFileContentUnlocked(FT_T oFT, const char *pcPath,
+                                     Content_T *poContent) {
+    struct loadedContents sLoaded;
+    Node_T oNLocked = NULL;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(poContent != NULL);
+
+    while(!FT_tryLoadFile(oFT, pcPath, &sLoaded, &oNLocked, &iStatus))
+        ;
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(sLoaded.oContent != NULL) {
+        if(oNLocked != NULL)
+            Content_freeze(sLoaded.oContent);
+        *poContent = Content_retain(sLoaded.oContent);
+    }
+    else {
+        /* contents borrowed from the caller must be copied, using
+           the address and size FT_loadContents loaded together */
+        *poContent = Content_new(sLoaded.pcData, sLoaded.ulSize);
+        if(*poContent == NULL)
+            iStatus = MEMORY_ERROR;
+    }
+
+    if(oNLocked != NULL)
+        Node_unlock(oNLocked);
+    return iStatus;
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_readAtIn, called from an epoch critical section. */
+static int FT_readAtUnlocked(FT_T oFT, const char *pcPath,
+                             size_t ulOffset, size_t ulLength,
+                             void *pvDest, size_t *pulRead) {
+    struct loadedContents sLoaded;
+    Node_T oNLocked = NULL;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(pvDest != NULL || ulLength == 0);
+    assert(pulRead != NULL);
+
+    while(!FT_tryLoadFile(oFT, pcPath, &sLoaded, &oNLocked, &iStatus))
+        ;
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(sLoaded.oContent != NULL)
+        *pulRead = Content_read(sLoaded.oContent, ulOffset, ulLength,
+                                pvDest);
+    else if(ulOffset < sLoaded.ulSize) {
+        if(ulLength > sLoaded.ulSize - ulOffset)
+            ulLength = sLoaded.ulSize - ulOffset;
+        memcpy(pvDest, sLoaded.pcData + ulOffset, ulLength);
+        *pulRead = ulLength;
+    }
+
+    if(oNLocked != NULL)
+        Node_unlock(oNLocked);
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+/* A scratch file cold contents are spilled to */
+struct spill {
+    /* the file, which has no name, so that its space is freed once it
+       is closed and no spilled contents are mapped from it */
+    FILE *psFile;
+    /* the segment of the file contents are being appended to, or NULL
+       before the first; and the offset the next segment starts at.
+       Only the thread sweeping the FT spills, so neither is shared */
+    Content_T oSegment;
+    size_t ulEnd;
+};
+
+/* The bytes spilled from a chunked buffer at a time, and the bytes a
+   segment of the spill file holds, unless it is made for longer
+   contents. Each segment is mapped once however many contents it
+   holds, which keeps the number of mappings low */
+enum { SPILL_BLOCK_SIZE = 65536, SPILL_SEGMENT_SIZE = 1 << 24 };
+
+/*
+  Creates an empty spill file and stores it in *ppsSpill. Returns
+  SUCCESS, MEMORY_ERROR, or IO_ERROR if the scratch file could not be
+  created.
+*/
+static int FT_newSpill(struct spill **ppsSpill) {
+    struct spill *psSpill;
+
+    assert(ppsSpill != NULL);
+
+    *ppsSpill = NULL;
+    psSpill = malloc(sizeof(struct spill));
+    if(psSpill == NULL)
+        return MEMORY_ERROR;
+    psSpill->psFile = tmpfile();
+    if(psSpill->psFile == NULL) {
+        free(psSpill);
+        return IO_ERROR;
+    }
+    psSpill->oSegment = NULL;
+    psSpill->ulEnd = 0;
+    *ppsSpill = psSpill;
+    return SUCCESS;
+}
+
+/* Closes the spill file that Epoch_retire was given. */
+static void FT_closeSpill(void *pvSpill) {
+    struct spill *psSpill = pvSpill;
+
+    if(psSpill->oSegment != NULL)
+        Content_release(psSpill->oSegment);
+    (void) fclose(psSpill->psFile);
+    free(psSpill);
+}
+
+/*
+  Gives up oFT's spill file, if it has one, whose field the caller
+  holds the root lock to change. Contents spilled to it stay mapped
+  until their files let them go.
+*/
+static void FT_dropSpill(FT_T oFT) {
+    struct spill *psSpill;
+
+    assert(oFT != NULL);
+
+    psSpill = oFT->psSpill;
+    if(psSpill != NULL) {
+        Epoch_store(&oFT->psSpill, NULL);
+        Epoch_retire(psSpill, FT_closeSpill);
+    }
+}
+
+/*
+  Appends the bytes of oContent, which must not be compressed or
+  change meanwhile, to spill file psSpill, starting a new segment of
+  it if the current one lacks room. Returns a buffer mapping them from
+  there, or NULL if they could not be written or mapped.
+*/
+static Content_T FT_spillContents(struct spill *psSpill,
+                                  Content_T oContent) {
+    const char *pcData;
+    char *pcBlock;
+    Content_T oSegment;
+    size_t ulLength, ulSize, ulOffset, ulDone, ulRead;
+
+    assert(psSpill != NULL);
+    assert(oContent != NULL);
+    assert(!Content_isCompressed(oContent));
+
+    ulLength = Content_getLength(oContent);
+    oSegment = psSpill->oSegment;
+    if(oSegment == NULL || ulLength > (size_t) -1 -
+       Content_getLength(oSegment) || !Content_hasRoom(oSegment,
+                          Content_getLength(oSegment) + ulLength)) {
+        ulSize = ulLength > SPILL_SEGMENT_SIZE ? ulLength
+                                               : SPILL_SEGMENT_SIZE;
+        if(psSpill->ulEnd > (size_t) -1 - ulSize ||
+           Content_newScratch(fileno(psSpill->psFile), psSpill->ulEnd,
+                              ulSize, &oSegment) != SUCCESS)
+            return NULL;
+        psSpill->ulEnd += ulSize;
+        /* slices of the old segment keep it mapped while in use */
+        if(psSpill->oSegment != NULL)
+            Content_release(psSpill->oSegment);
+        psSpill->oSegment = oSegment;
+    }
+    ulOffset = Content_getLength(oSegment);
+
+    /* writing to a segment with room cannot fail */
+    pcData = Content_getData(oContent);
+    if(pcData != NULL)
+        (void) Content_write(oSegment, ulOffset, pcData, ulLength);
+    else {
+        /* chunked bytes are not contiguous, so go through a block */
+        pcBlock = malloc(SPILL_BLOCK_SIZE);
+        if(pcBlock == NULL)
+            return NULL;
+        for(ulDone = 0; ulDone < ulLength; ulDone += ulRead) {
+            ulRead = Content_read(oContent, ulDone, SPILL_BLOCK_SIZE,
+                                  pcBlock);
+            (void) Content_write(oSegment, ulOffset + ulDone, pcBlock,
+                                 ulRead);
+        }
+        free(pcBlock);
+    }
+
+    return Content_newSlice(oSegment, ulOffset, ulLength);
+}
+
+/* The passes a sweep for cold contents makes over the files */
+enum sweepPass {
+    /* counts the bytes every file's contents take, evicting those not
+       used since the last sweep while bytes remain to be evicted */
+    PASS_COLD,
+    /* evicts contents, used or not, while bytes remain to be evicted */
+    PASS_FORCE
+};
+
+/* The state of a sweep for cold contents */
+struct sweep {
+    /* the bytes the contents files own should take at most, and the
+       bytes they take as far as the sweep has counted */
+    size_t ulTarget;
+    size_t ulResident;
+    /* the bytes the pass is still to evict, or (size_t) -1 for as
+       many as it may */
+    size_t ulExcess;
+    /* the pass the sweep is making */
+    enum sweepPass ePass;
+    /* the file contents are evicted to, or NULL if they are evicted
+       by compressing them */
+    struct spill *psSpill;
+};
+
+/*
+  Sweeps file oNNode on pass psSweep->ePass, counting the bytes its
+  own contents take and evicting them as the pass says. Only contents
+  the file alone owns, not mapped from a host file or the spill file,
+  are evicted: compressed if they are in a flat, immutable buffer and
+  that saves space, or spilled if they are not compressed and not
+  pinned, a writable buffer being frozen first so that writers copy it
+  instead. Eviction
+  happens outside the lock of oNNode's parent so that writers are not
+  held up.
+*/
+static void FT_sweepFile(Node_T oNNode, struct sweep *psSweep) {
+    Node_T oNParent;
+    Content_T oContent = NULL;
+    Content_T oEvicted;
+    boolean bCount, bEvict, bEvictable;
+    size_t ulFootprint = 0;
+    size_t ulSaved;
+
+    assert(oNNode != NULL);
+    assert(psSweep != NULL);
+
+    bCount = (boolean) (psSweep->ePass == PASS_COLD);
+    if(!bCount && psSweep->ulExcess == 0)
+        return;
+    if(psSweep->ePass == PASS_FORCE)
+        bEvict = TRUE;
+    else
+        bEvict = (boolean) (psSweep->ulExcess > 0 &&
+                            !Node_clearUsed(oNNode));
+
+    /* a writable buffer may only be looked at under the lock */
+    oNParent = Node_getParent(oNNode);
+    Node_lock(oNParent);
+    if(FT_isLinked(oNParent, oNNode))
+        oContent = Node_getContent(oNNode);
+    if(oContent != NULL) {
+        ulFootprint = Content_getFootprint(oContent);
+        bEvictable = (boolean) (!Content_isMapped(oContent) &&
+                                !Content_isShared(oContent));
+        if(psSweep->psSpill == NULL)
+            bEvictable = (boolean) (bEvictable &&
+                                    !Content_isWritable(oContent) &&
+                                    Content_getData(oContent) != NULL);
+        else
+            bEvictable = (boolean) (bEvictable &&
+                                    !Node_isPinned(oNNode) &&
+                                    !Content_isCompressed(oContent) &&
+                                    Content_getLength(oContent) > 0);
+        if(bEvict && bEvictable) {
+            Content_freeze(oContent);
+            (void) Content_retain(oContent);
+        }
+        else
+            oContent = NULL;
+    }
+    Node_unlock(oNParent);
+
+    if(bCount)
+        psSweep->ulResident += ulFootprint;
+    if(oContent == NULL)
+        return;
+
+    if(psSweep->psSpill != NULL)
+        oEvicted = FT_spillContents(psSweep->psSpill, oContent);
+    else
+        oEvicted = Content_compress(oContent);
+    if(oEvicted != NULL) {
+        Node_lock(oNParent);
+        /* the reference held rules out a new buffer at the same
+           address; the bytes may have been handed out meanwhile */
+        if(FT_isLinked(oNParent, oNNode) &&
+           Node_getContent(oNNode) == oContent &&
+           (psSweep->psSpill == NULL || !Node_isPinned(oNNode))) {
+            (void) Node_setContent(oNNode, oEvicted);
+            ulSaved = ulFootprint - Content_getFootprint(oEvicted);
+            psSweep->ulResident -= ulSaved;
+            if(psSweep->ulExcess != (size_t) -1)
+                psSweep->ulExcess -= ulSaved < psSweep->ulExcess ?
+                                     ulSaved : psSweep->ulExcess;
+        }
+        Node_unlock(oNParent);
+        Content_release(oEvicted);
+    }
+    Content_release(oContent);
+}
+
+/* Sweeps every file in the subtree rooted at oNNode. */
+static void FT_sweepWalk(Node_T oNNode, struct sweep *psSweep) {
+    DynArray_T oDChildren;
+    size_t i;
+
+    assert(oNNode != NULL);
+    assert(psSweep != NULL);
+
+    /* a forced pass counts nothing, so it stops once done */
+    if(psSweep->ePass == PASS_FORCE && psSweep->ulExcess == 0)
+        return;
+    if(Node_getType(oNNode) == IS_FILE) {
+        FT_sweepFile(oNNode, psSweep);
+        return;
+    }
+
+    oDChildren = Node_getChildren(oNNode);
+    if(oDChildren == NULL)
+        return;
+    for(i = 0; i < DynArray_getLength(oDChildren); i++)
+        FT_sweepWalk(DynArray_get(oDChildren, i), psSweep);
+}
+
+/*
+  A budget sweep brings the contents down to a low-water mark an
+  eighth below the budget (the budget less its own right shift by
+  FT_LOW_WATER_SHIFT), so that the next one is not needed until they
+  have grown by that much again.
+*/
+enum { FT_LOW_WATER_SHIFT = 3 };
+
+/*
+  Adds ulBytes to the bytes oFT's files' contents grew by since its
+  last budget sweep, and returns the new total.
+*/
+static size_t FT_addCharge(FT_T oFT, size_t ulBytes) {
+#ifdef FT_THREADSAFE
+    return __atomic_add_fetch(&oFT->ulCharged, ulBytes,
+                              __ATOMIC_RELAXED);
+#else
+    oFT->ulCharged += ulBytes;
+    return oFT->ulCharged;
+#endif
+}
+
+/*
+  Returns the bytes oFT's files' contents grew by since its last
+  budget sweep, and starts counting from 0 again.
+*/
+static size_t FT_takeCharge(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    return __atomic_exchange_n(&oFT->ulCharged, 0, __ATOMIC_RELAXED);
+#else
+    size_t ulCharged = oFT->ulCharged;
+
+    oFT->ulCharged = 0;
+    return ulCharged;
+#endif
+}
+
+/*
+  Marks a budget sweep of oFT as running. Returns TRUE, or FALSE if
+  one was running already.
+*/
+static boolean FT_claimSweep(FT_T oFT) {
+#ifdef FT_THREADSAFE
+    return (boolean) !__atomic_exchange_n(&oFT->bSweeping, TRUE,
+                                          __ATOMIC_ACQUIRE);
+#else
+    if(oFT->bSweeping)
+        return FALSE;
+    oFT->bSweeping = TRUE;
+    return TRUE;
+#endif
+}
+
+/*
+  Brings the bytes the contents oFT's files own take down to the
+  low-water mark of its budget, unless another thread is already
+  doing so, by spilling contents to its spill file: first those not
+  used since the last sweep, then any, until they fit. The bytes are
+  estimated from the last sweep's count and the growth charged since,
+  or counted first if bRecount is TRUE. Removed and replaced contents
+  are not subtracted, so the estimate may run high; the pass over
+  cold contents counts the bytes exactly, and only that count decides
+  whether contents still in use are spilled. Must be called from an
+  epoch critical section.
+*/
+static void FT_enforceBudget(FT_T oFT, boolean bRecount) {
+    struct sweep sSweep;
+    Node_T oNRoot;
+    size_t ulBudget;
+    size_t ulEstimate;
+
+    assert(oFT != NULL);
+
+    if(!FT_claimSweep(oFT))
+        return;
+
+    ulBudget = Epoch_load(&oFT->ulBudget);
+    sSweep.ulTarget = ulBudget - (ulBudget >> FT_LOW_WATER_SHIFT);
+    sSweep.psSpill = Epoch_load(&oFT->psSpill);
+    oNRoot = Epoch_load(&oFT->oNRoot);
+    /* growth from here on is counted by the next sweep */
+    ulEstimate = Epoch_load(&oFT->ulSwept) + FT_takeCharge(oFT);
+    if(ulBudget != 0 && sSweep.psSpill != NULL && oNRoot != NULL) {
+        sSweep.ePass = PASS_COLD;
+        if(bRecount) {
+            /* a cold pass with nothing to evict only counts */
+            sSweep.ulResident = 0;
+            sSweep.ulExcess = 0;
+            FT_sweepWalk(oNRoot, &sSweep);
+            ulEstimate = sSweep.ulResident;
+        }
+        if(ulEstimate > sSweep.ulTarget) {
+            sSweep.ulResident = 0;
+            sSweep.ulExcess = ulEstimate - sSweep.ulTarget;
+            FT_sweepWalk(oNRoot, &sSweep);
+            if(sSweep.ulResident > sSweep.ulTarget) {
+                sSweep.ePass = PASS_FORCE;
+                sSweep.ulExcess = sSweep.ulResident - sSweep.ulTarget;
+                FT_sweepWalk(oNRoot, &sSweep);
+            }
+            ulEstimate = sSweep.ulResident;
+        }
+        Epoch_store(&oFT->ulSwept, ulEstimate);
+    }
+
+    Epoch_store(&oFT->bSweeping, FALSE);
+}
+
+/*
+  Counts ulBytes of memory that oFT's files' contents just grew by
+  against its budget, if it has one, and enforces the budget if they
+  may have taken the files over it. Must be called from an epoch critical section.
+*/
+static void FT_chargeBytes(FT_T oFT, size_t ulBytes) {
+    size_t ulBudget, ulCharged;
+
+    assert(oFT != NULL);
+
+    ulBudget = Epoch_load(&oFT->ulBudget);
+    if(ulBudget == 0 || ulBytes == 0)
+        return;
+
+    ulCharged = FT_addCharge(oFT, ulBytes);
+    /* wait for at least the room a sweep leaves, even if the last one
+       could not make it, since contents that cannot be spilled (such
+       as the buffers of those that were) then left the files over
+       budget, and each write would sweep them all again */
+    if(ulCharged <= ulBudget >> FT_LOW_WATER_SHIFT)
+        return;
+    if(ulCharged > ulBudget ||
+       Epoch_load(&oFT->ulSwept) > ulBudget - ulCharged)
+        FT_enforceBudget(oFT, FALSE);
+}
+
+/*
+  Counts the buffer psContents describes, if any, against oFT's
+  budget, as FT_chargeBytes does. Mapped buffers take no memory of
+  their own, so are not counted.
+*/
+static void FT_chargeContents(FT_T oFT,
+                              const struct fileContents *psContents) {
+    assert(psContents != NULL);
+
+    if(psContents->oContent != NULL &&
+       !Content_isMapped(psContents->oContent))
+        FT_chargeBytes(oFT, Content_getLength(psContents->oContent));
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_statIn, called from an epoch critical section. */
+static int FT_statUnlocked(FT_T oFT, const char *pcPath,
+                           boolean *pbIsFile, size_t *pulSize) {
+    Node_T oNFound = NULL;
+    int iStatus;
+    nodeType type;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(pbIsFile != NULL);
+    assert (pulSize != NULL);
+    
+    /* search for node */
+    iStatus = FT_findNode(oFT, pcPath, &oNFound);
+    if (iStatus != SUCCESS) {
+        return iStatus;
+    }
+
+    /* store node type, set type flags */ 
+    type = Node_getType(oNFound);
+    if (type == IS_DIRECTORY){
+        *pbIsFile = FALSE;
+    }
+    else{
+        *pbIsFile = TRUE;
+        *pulSize = Node_getSize(oNFound);
+    }
+
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_initIn, called with oFT's root lock held. */
+static int FT_initUnlocked(FT_T oFT) {
+    assert(oFT != NULL);
+
+    if(oFT->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    /* the last FT_destroy, if any, left the count at 0 */
+    assert(FT_getCount(oFT) == 0);
+    Epoch_store(&oFT->oNRoot, NULL);
+    Epoch_store(&oFT->bIsInitialized, TRUE);
+
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_buildFromSortedIn, called with oFT's root lock held. */
+static int FT_buildFromSortedUnlocked(FT_T oFT, const char **ppcPaths,
+                                      const nodeType *peTypes,
+                                      void **ppvContents,
+                                      const size_t *pulLengths,
+                                      size_t ulNum) {
+    int iStatus = SUCCESS;
+    DynArray_T oDPending;
+    DynArray_T oDOpen;
+    Path_T oPPrev = NULL;
+    nodeType prevType = IS_DIRECTORY;
+    size_t ulNewNodes = 0;
+    size_t i;
+
+    assert(oFT != NULL);
+    assert(ppcPaths != NULL);
+    assert(peTypes != NULL);
+    assert(ppvContents != NULL);
+    assert(pulLengths != NULL);
+
+    if(!oFT->bIsInitialized)
+        return INITIALIZATION_ERROR;
+    if(oFT->oNRoot != NULL)
+        return ALREADY_IN_TREE;
+
+    /* nodes built but not yet linked to their parent, in order */
+    oDPending = DynArray_new(0);
+    if(oDPending == NULL)
+        return MEMORY_ERROR;
+    /* stack of directories whose children may still follow */
+    oDOpen = DynArray_new(0);
+    if(oDOpen == NULL) {
+        DynArray_free(oDPending);
+        return MEMORY_ERROR;
+    }
+
+    for(i = 0; i < ulNum && iStatus == SUCCESS; i++) {
+        Path_T oPPath = NULL;
+        size_t ulShared = 0;
+
+        assert(ppcPaths[i] != NULL);
+
+        iStatus = Path_new(ppcPaths[i], &oPPath);
+        if(iStatus != SUCCESS)
+            break;
+
+        if(oPPrev != NULL) {
+            ulShared = Path_getSharedPrefixDepth(oPPath, oPPrev);
+            iStatus = FT_checkBuildOrder(oPPrev, prevType, oPPath,
+                                         ulShared);
+            Path_free(oPPrev);
+        }
+        oPPrev = oPPath;
+        prevType = peTypes[i];
+        if(iStatus != SUCCESS)
+            break;
+
+        /* every directory deeper than the shared prefix is complete */
+        while(iStatus == SUCCESS &&
+              DynArray_getLength(oDOpen) > ulShared) {
+            Node_T oNDir = DynArray_removeAt(oDOpen,
+                                         DynArray_getLength(oDOpen) - 1);
+            iStatus = FT_closeBuildDir(oNDir, oDPending);
+        }
+
+        if(iStatus == SUCCESS)
+            iStatus = FT_buildLevels(oPPath, ulShared + 1, peTypes[i],
+                                     ppvContents[i], pulLengths[i],
+                                     oDPending, oDOpen, &ulNewNodes);
+    }
+
+    /* close whatever is still open, deepest first */
+    while(iStatus == SUCCESS && DynArray_getLength(oDOpen) > 0) {
+        Node_T oNDir = DynArray_removeAt(oDOpen,
+                                         DynArray_getLength(oDOpen) - 1);
+        iStatus = FT_closeBuildDir(oNDir, oDPending);
+    }
+
+    if(oPPrev != NULL)
+        Path_free(oPPrev);
+    DynArray_free(oDOpen);
+
+    if(iStatus != SUCCESS) {
+        /* each pending node heads its own unlinked subtree */
+        while(DynArray_getLength(oDPending) > 0)
+            (void) Node_free(DynArray_removeAt(oDPending,
+                                    DynArray_getLength(oDPending) - 1));
+        DynArray_free(oDPending);
+        return iStatus;
+    }
+
+    /* only the root remains pending (or nothing, if ulNum is 0) */
+    assert(DynArray_getLength(oDPending) <= 1);
+    if(DynArray_getLength(oDPending) == 1) {
+        Epoch_store(&oFT->oNRoot, (Node_T) DynArray_get(oDPending, 0));
+        FT_indexSubtree(oFT, oFT->oNRoot);
+    }
+    FT_addCount(oFT, ulNewNodes);
+    DynArray_free(oDPending);
+
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  FT_destroyIn, called with oFT's root lock held. Freeing the root
+  waits for writers still working inside the hierarchy to finish.
+  The name index, if any, is discarded along with the nodes.
+*/
+static int FT_destroyUnlocked(FT_T oFT) {
+    assert(oFT != NULL);
+
+    if(!oFT->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    /* if FT has components, free them */
+    if(oFT->oNRoot) {
+        Node_T oNOldRoot = oFT->oNRoot;
+        Epoch_store(&oFT->oNRoot, NULL);
+        FT_subtractCount(oFT, Node_free(oNOldRoot));
+    }
+
+    /* no writer can reach a node any more, so none needs unlinking */
+    FT_lockIndex(oFT);
+    Epoch_store(&oFT->bChunked, FALSE);
+    Epoch_store(&oFT->ulInlineLimit, 0);
+    Epoch_store(&oFT->ulBudget, 0);
+    Epoch_store(&oFT->ulSwept, 0);
+    Epoch_store(&oFT->ulCharged, 0);
+    FT_dropStore(oFT);
+    FT_dropSpill(oFT);
+    if(oFT->oIndex != NULL) {
+        NameIndex_free(oFT->oIndex, FALSE);
+        Epoch_store(&oFT->oIndex, NULL);
+    }
+    FT_unlockIndex(oFT);
+
+    Epoch_store(&oFT->bIsInitialized, FALSE);
+
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+/*
+  FT_toStringAtIn, or FT_toStringIn if pcPath is NULL, called from an
+  epoch critical section. In thread-safe builds concurrent writers may
+  change the FT meanwhile; each directory is listed as it was at some
+  moment during the call.
+*/
+static char *FT_toStringAtUnlocked(FT_T oFT, const char *pcPath,
+                                   size_t ulMaxDepth) {
+    struct listing sListing;
+    Node_T oNStart;
+    size_t ulLevels = FT_ALL_LEVELS;
+    size_t ulLength = 0;
+    int iStatus = SUCCESS;
+
+    assert(oFT != NULL);
+
+    if(!Epoch_load(&oFT->bIsInitialized))
+      return NULL;
+
+    /* resolve the start once; the whole FT starts at the root */
+    if(pcPath == NULL)
+        oNStart = Epoch_load(&oFT->oNRoot);
+    else if(FT_findNode(oFT, pcPath, &oNStart) != SUCCESS)
+        return NULL;
+    if(ulMaxDepth != 0)
+        ulLevels = ulMaxDepth;
+
+    FT_lockListing(oFT);
+
+    /* rebuild what changed since the last call, and size the result
+       from the cached lengths */
+    if(oNStart == NULL)
+        ulLength = 0;
+    else if(Node_getType(oNStart) == IS_FILE)
+        ulLength = Path_getStrLength(Node_getPath(oNStart)) + 1;
+    else
+        iStatus = FT_measureListing(oNStart, ulLevels, &ulLength);
+
+    sListing.ulUsed = 0;
+    sListing.ulCapacity = ulLength + 1;
+    sListing.bFixed = FALSE;
+    sListing.pcData = NULL;
+    if(iStatus == SUCCESS)
+        sListing.pcData = malloc(sListing.ulCapacity);
+    if(sListing.pcData == NULL)
+        iStatus = MEMORY_ERROR;
+
+    if(iStatus == SUCCESS && oNStart != NULL &&
+       Node_getType(oNStart) == IS_FILE) {
+        /* a file is listed as its own path */
+        memcpy(sListing.pcData, Path_getPathname(Node_getPath(oNStart)),
+               ulLength - 1);
+        sListing.pcData[ulLength - 1] = '\n';
+        sListing.ulUsed = ulLength;
+    }
+    else if(iStatus == SUCCESS && oNStart != NULL) {
+#ifdef FT_THREADSAFE
+        /* large listings are split among threads, falling back to a
+           serial copy if they are racing a writer */
+        if(ulLevels != FT_ALL_LEVELS ||
+           FT_copyListingParallel(oNStart, ulLength, &sListing)
+           != SUCCESS) {
+            sListing.ulUsed = 0;
+            iStatus = FT_copyListing(oNStart, ulLevels, &sListing);
+        }
+#else
+        iStatus = FT_copyListing(oNStart, ulLevels, &sListing);
+#endif
+    }
+
+    FT_unlockListing(oFT);
+
+    if(iStatus != SUCCESS) {
+        free(sListing.pcData);
+        return NULL;
+    }
+
+    /* there is room for the '\0' unless the listing had to grow */
+    if(sListing.ulUsed == sListing.ulCapacity) {
+        char *pcData = realloc(sListing.pcData, sListing.ulUsed + 1);
+        if(pcData == NULL) {
+            free(sListing.pcData);
+            return NULL;
+        }
+        sListing.pcData = pcData;
+    }
+    sListing.pcData[sListing.ulUsed] = '\0';
+
+    return sListing.pcData;
+}
+
+
+/*
+  FT_entryAtIn, called from an epoch critical section: descends from
+  the root, at each level picking by binary search the child whose
+  part of the listing holds the entry.
+*/
+static int FT_entryAtUnlocked(FT_T oFT, size_t ulRank,
+                              struct ftEntry **ppsEntry) {
+    Node_T oNCurr;
+    size_t ulLength;
+    Path_T oPPath;
+    struct ftEntry *psEntry;
+    int iStatus = SUCCESS;
+
+    assert(oFT != NULL);
+    assert(ppsEntry != NULL);
+
+    *ppsEntry = NULL;
+    if(!Epoch_load(&oFT->bIsInitialized))
+        return INITIALIZATION_ERROR;
+
+    FT_lockListing(oFT);
+
+    oNCurr = Epoch_load(&oFT->oNRoot);
+    if(oNCurr == NULL)
+        iStatus = NO_SUCH_PATH;
+    else if(Node_refreshListing(oNCurr, &ulLength) != SUCCESS)
+        iStatus = MEMORY_ERROR;
+    else if(ulRank >= Node_getListingCount(oNCurr))
+        iStatus = NO_SUCH_PATH;
+
+    /* entry 0 of each subtree is its root */
+    while(iStatus == SUCCESS && ulRank > 0) {
+        size_t ulBefore;
+
+        oNCurr = Node_getListingChild(oNCurr, ulRank - 1, &ulBefore);
+        if(oNCurr == NULL)
+            iStatus = NO_SUCH_PATH;
+        else
+            ulRank -= ulBefore + 1;
+    }
+
+    FT_unlockListing(oFT);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    /* one block: the entry, then the path it points to */
+    oPPath = Node_getPath(oNCurr);
+    ulLength = Path_getStrLength(oPPath);
+    psEntry = malloc(sizeof(struct ftEntry) + ulLength + 1);
+    if(psEntry == NULL)
+        return MEMORY_ERROR;
+    psEntry->pcPath = memcpy(psEntry + 1, Path_getPathname(oPPath),
+                             ulLength + 1);
+    psEntry->type = Node_getType(oNCurr);
+    psEntry->ulSize = 0;
+    if(psEntry->type == IS_FILE)
+        psEntry->ulSize = Node_getSize(oNCurr);
+
+    *ppsEntry = psEntry;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  FT_rankOfIn, called from an epoch critical section: climbs from the
+  node to the root, adding up the entries before it at each level.
+*/
+static int FT_rankOfUnlocked(FT_T oFT, const char *pcPath,
+                             size_t *pulRank) {
+    Node_T oNNode = NULL;
+    Node_T oNRoot;
+    Node_T oNParent;
+    size_t ulLength;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(pulRank != NULL);
+
+    iStatus = FT_findNode(oFT, pcPath, &oNNode);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    FT_lockListing(oFT);
+
+    /* the root may have been removed since the node was found */
+    *pulRank = 0;
+    oNRoot = Epoch_load(&oFT->oNRoot);
+    if(oNRoot == NULL)
+        iStatus = NO_SUCH_PATH;
+    else if(Node_refreshListing(oNRoot, &ulLength) != SUCCESS)
+        iStatus = MEMORY_ERROR;
+
+    for(oNParent = Node_getParent(oNNode);
+        iStatus == SUCCESS && oNParent != NULL;
+        oNNode = oNParent, oNParent = Node_getParent(oNNode)) {
+        size_t ulBefore;
+
+        /* the node may have been removed since it was found */
+        if(!Node_getListingRank(oNParent, oNNode, &ulBefore))
+            iStatus = NO_SUCH_PATH;
+        else
+            *pulRank += ulBefore + 1;
+    }
+
+    FT_unlockListing(oFT);
+    return iStatus;
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_readdirIn, called from an epoch critical section. */
+static int FT_readdirUnlocked(FT_T oFT, const char *pcPath,
+                              const char *pcStartAfter, size_t ulLimit,
+                              struct ftEntry **ppsEntries,
+                              size_t *pulCount) {
+    int iStatus;
+    Node_T oNDir = NULL;
+    DynArray_T oDChildren;
+    size_t ulFirst = 0;
+    size_t ulCount;
+    size_t ulBytes;
+    struct ftEntry *psEntries;
+    char *pcNames;
+    size_t i;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(ppsEntries != NULL);
+    assert(pulCount != NULL);
+
+    *ppsEntries = NULL;
+    *pulCount = 0;
+
+    iStatus = FT_findNode(oFT, pcPath, &oNDir);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    /* file, not directory */
+    oDChildren = Node_getChildren(oNDir);
+    if(oDChildren == NULL)
+        return NOT_A_DIRECTORY;
+
+    /* seek past pcStartAfter, whether or not it is still there */
+    if(pcStartAfter != NULL &&
+       Node_findChildIndex(oDChildren, pcStartAfter,
+                           strlen(pcStartAfter), &ulFirst))
+        ulFirst++;
+
+    ulCount = DynArray_getLength(oDChildren) - ulFirst;
+    if(ulCount > ulLimit)
+        ulCount = ulLimit;
+    if(ulCount == 0)
+        return SUCCESS;
+
+    /* one block: the entries, then the paths they point to */
+    ulBytes = ulCount * sizeof(struct ftEntry);
+    for(i = 0; i < ulCount; i++)
+        ulBytes += Path_getStrLength(Node_getPath(
+                       DynArray_get(oDChildren, ulFirst + i))) + 1;
+    psEntries = malloc(ulBytes);
+    if(psEntries == NULL)
+        return MEMORY_ERROR;
+
+    pcNames = (char *) (psEntries + ulCount);
+    for(i = 0; i < ulCount; i++) {
+        Node_T oNChild = DynArray_get(oDChildren, ulFirst + i);
+        Path_T oPPath = Node_getPath(oNChild);
+        size_t ulLength = Path_getStrLength(oPPath);
+
+        memcpy(pcNames, Path_getPathname(oPPath), ulLength + 1);
+        psEntries[i].pcPath = pcNames;
+        psEntries[i].type = Node_getType(oNChild);
+        psEntries[i].ulSize = 0;
+        if(psEntries[i].type == IS_FILE)
+            psEntries[i].ulSize = Node_getSize(oNChild);
+        pcNames += ulLength + 1;
+    }
+
+    *ppsEntries = psEntries;
+    *pulCount = ulCount;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+/* FT_writeToIn, called from an epoch critical section. */
+static int FT_writeToUnlocked(FT_T oFT, FT_Sink pfSink, void *pvExtra) {
+    struct writer sWriter;
+    Node_T oNRoot;
+
+    assert(oFT != NULL);
+    assert(pfSink != NULL);
+
+    if(!Epoch_load(&oFT->bIsInitialized))
+        return INITIALIZATION_ERROR;
+
+    sWriter.pfSink = pfSink;
+    sWriter.pvExtra = pvExtra;
+    sWriter.iStatus = SUCCESS;
+    sWriter.ulUsed = 0;
+
+    oNRoot = Epoch_load(&oFT->oNRoot);
+    if(oNRoot != NULL)
+        FT_writeSubtree(&sWriter, oNRoot);
+    FT_flushWriter(&sWriter);
+
+    return sWriter.iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The handle-taking functions below synchronize access to oFT (a no-op
+  unless built with FT_THREADSAFE): lookups and FT_writeTo run as
+  lock-free readers, FT_toString takes only oFT's listing lock to
+  share the cached listings with other calls to it, functions that
+  modify the hierarchy lock only the directories they change, and
+  those that set the root or the initialized flag hold oFT's root
+  lock.
+*/
+
+int FT_insertDirIn(FT_T oFT, const char *pcPath) {
+    assert(oFT != NULL);
+
+    return FT_insert(oFT, pcPath, IS_DIRECTORY, NULL);
+}
+
+boolean FT_containsDirIn(FT_T oFT, const char *pcPath) {
+    boolean bResult;
+
+    assert(oFT != NULL);
+
+    if(Epoch_enter() != SUCCESS)
+        return FALSE;
+    bResult = FT_containsDirUnlocked(oFT, pcPath);
+    Epoch_exit();
+    return bResult;
+}
+
+int FT_rmDirIn(FT_T oFT, const char *pcPath) {
+    assert(oFT != NULL);
+
+    return FT_remove(oFT, pcPath, IS_DIRECTORY);
+}
+
+/*
+  Inserts a file with absolute path pcPath and contents psContents
+  into oFT, copying them into the file's node if they are borrowed
+  and within oFT's inline limit, or else sharing them through oFT's
+  content store if it has one. Returns the status documented for
+  FT_insertFile.
+*/
+static int FT_insertStored(FT_T oFT, const char *pcPath,
+                           struct fileContents *psContents) {
+    Content_T oStored;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(psContents != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    oStored = NULL;
+    if(psContents->oContent == NULL && psContents->ulLength > 0 &&
+       psContents->pvContents != NULL &&
+       psContents->ulLength <= Epoch_load(&oFT->ulInlineLimit))
+        psContents->bInline = TRUE;
+    else
+        iStatus = FT_storeContents(oFT, psContents, &oStored);
+    if(iStatus == SUCCESS)
+        iStatus = FT_insert(oFT, pcPath, IS_FILE, psContents);
+    if(iStatus == SUCCESS)
+        FT_chargeContents(oFT, psContents);
+    if(oStored != NULL)
+        Content_release(oStored);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_insertFileIn(FT_T oFT, const char *pcPath, void *pvContents,
+                    size_t ulLength) {
+    struct fileContents sContents;
+
+    assert(oFT != NULL);
+
+    sContents.pvContents = pvContents;
+    sContents.ulLength = ulLength;
+    sContents.oContent = NULL;
+    sContents.bInline = FALSE;
+    return FT_insertStored(oFT, pcPath, &sContents);
+}
+
+int FT_insertFileContentIn(FT_T oFT, const char *pcPath,
+                           Content_T oContent) {
+    struct fileContents sContents;
+
+    assert(oFT != NULL);
+    assert(oContent != NULL);
+
+    sContents.pvContents = NULL;
+    sContents.ulLength = 0;
+    sContents.oContent = oContent;
+    sContents.bInline = FALSE;
+    return FT_insertStored(oFT, pcPath, &sContents);
+}
+
+int FT_insertFileMappedIn(FT_T oFT, const char *pcPath, int iFd,
+                          size_t ulOffset, size_t ulLength) {
+    struct fileContents sContents;
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    iStatus = Content_newMapped(iFd, ulOffset, ulLength,
+                                &sContents.oContent);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    sContents.pvContents = NULL;
+    sContents.ulLength = 0;
+    sContents.bInline = FALSE;
+    /* mapped bytes are not copied into the content store */
+    iStatus = FT_insert(oFT, pcPath, IS_FILE, &sContents);
+    Content_release(sContents.oContent);
+    return iStatus;
+}
+
+boolean FT_containsFileIn(FT_T oFT, const char *pcPath) {
+    boolean bResult;
+
+    assert(oFT != NULL);
+
+    if(Epoch_enter() != SUCCESS)
+        return FALSE;
+    bResult = FT_containsFileUnlocked(oFT, pcPath);
+    Epoch_exit();
+    return bResult;
+}
+
+int FT_rmFileIn(FT_T oFT, const char *pcPath) {
+    assert(oFT != NULL);
+
+    return FT_remove(oFT, pcPath, IS_FILE);
+}
+
+void *FT_getFileContentsIn(FT_T oFT, const char *pcPath) {
+    void *pvResult;
+
+    assert(oFT != NULL);
+
+    if(Epoch_enter() != SUCCESS)
+        return NULL;
+    pvResult = FT_getFileContentsUnlocked(oFT, pcPath);
+    Epoch_exit();
+    return pvResult;
+}
+
+int FT_getFileContentIn(FT_T oFT, const char *pcPath,
+                        Content_T *poContent) {
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(poContent != NULL);
+
+    *poContent = NULL;
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_getFileContentUnlocked(oFT, pcPath, poContent);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_readAtIn(FT_T oFT, const char *pcPath, size_t ulOffset,
+                size_t ulLength, void *pvDest, size_t *pulRead) {
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pulRead != NULL);
+
+    *pulRead = 0;
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_readAtUnlocked(oFT, pcPath, ulOffset, ulLength, pvDest,
+                                pulRead);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_writeAtIn(FT_T oFT, const char *pcPath, size_t ulOffset,
+                 const void *pvData, size_t ulLength) {
+    size_t ulGrowth;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(pvData != NULL || ulLength == 0);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    while(!FT_tryWriteAt(oFT, pcPath, ulOffset, FALSE, pvData, ulLength,
+                         &iStatus, &ulGrowth))
+        ;
+    if(iStatus == SUCCESS)
+        FT_chargeBytes(oFT, ulGrowth);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_appendFileIn(FT_T oFT, const char *pcPath, const void *pvData,
+                    size_t ulLength) {
+    size_t ulGrowth;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(pvData != NULL || ulLength == 0);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    while(!FT_tryWriteAt(oFT, pcPath, 0, TRUE, pvData, ulLength,
+                         &iStatus, &ulGrowth))
+        ;
+    if(iStatus == SUCCESS)
+        FT_chargeBytes(oFT, ulGrowth);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_cloneFileIn(FT_T oFT, const char *pcSrcPath,
+                   const char *pcDstPath) {
+    struct fileContents sContents;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcSrcPath != NULL);
+    assert(pcDstPath != NULL);
+
+    sContents.pvContents = NULL;
+    sContents.ulLength = 0;
+    sContents.oContent = NULL;
+    sContents.bInline = FALSE;
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    while(!FT_tryShareFile(oFT, pcSrcPath, &sContents, &iStatus))
+        ;
+    /* the source's lock is not held here, so that the clone may go
+       anywhere without ordering the two directories' locks */
+    if(iStatus == SUCCESS)
+        iStatus = FT_insert(oFT, pcDstPath, IS_FILE, &sContents);
+    if(sContents.oContent != NULL)
+        Content_release(sContents.oContent);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_compressColdIn(FT_T oFT, size_t ulTarget, size_t *pulResident) {
+    struct sweep sSweep;
+    Node_T oNRoot;
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    if(!Epoch_load(&oFT->bIsInitialized)) {
+        Epoch_exit();
+        return INITIALIZATION_ERROR;
+    }
+
+    sSweep.ulTarget = ulTarget;
+    sSweep.ulResident = 0;
+    sSweep.ulExcess = (size_t) -1;
+    sSweep.ePass = PASS_COLD;
+    sSweep.psSpill = NULL;
+    oNRoot = Epoch_load(&oFT->oNRoot);
+    if(oNRoot != NULL) {
+        FT_sweepWalk(oNRoot, &sSweep);
+        if(sSweep.ulResident > ulTarget) {
+            sSweep.ePass = PASS_FORCE;
+            sSweep.ulExcess = sSweep.ulResident - ulTarget;
+            FT_sweepWalk(oNRoot, &sSweep);
+        }
+    }
+    Epoch_exit();
+
+    if(pulResident != NULL)
+        *pulResident = sSweep.ulResident;
+    return SUCCESS;
+}
+
+int FT_setChunkedContentsIn(FT_T oFT, boolean bEnabled) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    /* serialized with FT_init and FT_destroy, which reset the flag */
+    FT_lockRoot(oFT);
+    if(!oFT->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else {
+        Epoch_store(&oFT->bChunked, bEnabled);
+        iStatus = SUCCESS;
+    }
+    FT_unlockRoot(oFT);
+    return iStatus;
+}
+
+int FT_setInlineLimitIn(FT_T oFT, size_t ulLimit) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    /* serialized with FT_init and FT_destroy, which reset the limit */
+    FT_lockRoot(oFT);
+    if(!oFT->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else {
+        Epoch_store(&oFT->ulInlineLimit, ulLimit);
+        iStatus = SUCCESS;
+    }
+    FT_unlockRoot(oFT);
+    return iStatus;
+}
+
+int FT_setMemoryBudgetIn(FT_T oFT, size_t ulBudget) {
+    struct spill *psSpill;
+    int iStatus = SUCCESS;
+
+    assert(oFT != NULL);
+
+    /* serialized with FT_init and FT_destroy, which drop the budget */
+    FT_lockRoot(oFT);
+    if(!oFT->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else if(ulBudget == 0) {
+        Epoch_store(&oFT->ulBudget, 0);
+        FT_dropSpill(oFT);
+    }
+    else {
+        if(oFT->psSpill == NULL) {
+            iStatus = FT_newSpill(&psSpill);
+            if(iStatus == SUCCESS)
+                Epoch_store(&oFT->psSpill, psSpill);
+        }
+        if(iStatus == SUCCESS)
+            Epoch_store(&oFT->ulBudget, ulBudget);
+    }
+    FT_unlockRoot(oFT);
+    if(iStatus != SUCCESS || ulBudget == 0)
+        return iStatus;
+
+    /* what the files held before there was a budget was not charged */
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_enforceBudget(oFT, TRUE);
+    Epoch_exit();
+    return SUCCESS;
+}
+
+int FT_setContentStoreIn(FT_T oFT, boolean bEnabled) {
+    ContentStore_T oStore;
+    int iStatus = SUCCESS;
+
+    assert(oFT != NULL);
+
+    FT_lockRoot(oFT);
+    if(!oFT->bIsInitialized)
+        iStatus = INITIALIZATION_ERROR;
+    else if(!bEnabled)
+        FT_dropStore(oFT);
+    else if(oFT->oStore == NULL) {
+        oStore = ContentStore_new();
+        if(oStore == NULL)
+            iStatus = MEMORY_ERROR;
+        else
+            Epoch_store(&oFT->oStore, oStore);
+    }
+    FT_unlockRoot(oFT);
+    return iStatus;
+}
+
+int FT_getContentStoreStatsIn(FT_T oFT,
+                              struct contentStoreStats *psStats) {
+    ContentStore_T oStore;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(psStats != NULL);
+
+    psStats->ulContents = 0;
+    psStats->ulStoredBytes = 0;
+    psStats->ulReferences = 0;
+    psStats->ulReferencedBytes = 0;
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    if(!Epoch_load(&oFT->bIsInitialized))
+        iStatus = INITIALIZATION_ERROR;
+    else {
+        oStore = Epoch_load(&oFT->oStore);
+        if(oStore != NULL)
+            ContentStore_getStats(oStore, psStats);
+    }
+    Epoch_exit();
+    return iStatus;
+}
+
+void *FT_replaceFileContentsIn(FT_T oFT, const char *pcPath,
+                               void *pvNewContents,
+                               size_t ulNewLength) {
+    struct fileContents sContents;
+    Content_T oStored;
+    void *pvResult = NULL;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+
+    sContents.pvContents = pvNewContents;
+    sContents.ulLength = ulNewLength;
+    sContents.oContent = NULL;
+    sContents.bInline = FALSE;
+
+    if(Epoch_enter() != SUCCESS)
+        return NULL;
+    if(FT_storeContents(oFT, &sContents, &oStored) == SUCCESS) {
+        while(!FT_tryReplace(oFT, pcPath, &sContents, &pvResult,
+                             &iStatus))
+            ;
+        if(iStatus == SUCCESS)
+            FT_chargeContents(oFT, &sContents);
+    }
+    if(oStored != NULL)
+        Content_release(oStored);
+    Epoch_exit();
+    return pvResult;
+}
+
+int FT_replaceFileContentIn(FT_T oFT, const char *pcPath,
+                            Content_T oNewContent) {
+    struct fileContents sContents;
+    Content_T oStored;
+    void *pvOldContents;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+    assert(oNewContent != NULL);
+
+    sContents.pvContents = NULL;
+    sContents.ulLength = 0;
+    sContents.oContent = oNewContent;
+    sContents.bInline = FALSE;
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_storeContents(oFT, &sContents, &oStored);
+    if(iStatus == SUCCESS)
+        while(!FT_tryReplace(oFT, pcPath, &sContents, &pvOldContents,
+                             &iStatus))
+            ;
+    if(iStatus == SUCCESS)
+        FT_chargeContents(oFT, &sContents);
+    if(oStored != NULL)
+        Content_release(oStored);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_statIn(FT_T oFT, const char *pcPath, boolean *pbIsFile,
+              size_t *pulSize) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    if(Epoch_enter() != SUCCESS)
+        return MEMORY_ERROR;
+    iStatus = FT_statUnlocked(oFT, pcPath, pbIsFile, pulSize);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_initIn(FT_T oFT) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    FT_lockRoot(oFT);
+    iStatus = FT_initUnlocked(oFT);
+    FT_unlockRoot(oFT);
+    return iStatus;
+}
+
+int FT_buildFromSortedIn(FT_T oFT, const char **ppcPaths,
+                         const nodeType *peTypes, void **ppvContents,
+                         const size_t *pulLengths, size_t ulNum) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    FT_lockRoot(oFT);
+    iStatus = FT_buildFromSortedUnlocked(oFT, ppcPaths, peTypes,
+                                         ppvContents, pulLengths,
+                                         ulNum);
+    FT_unlockRoot(oFT);
+    return iStatus;
+}
+
+int FT_destroyIn(FT_T oFT) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    FT_lockRoot(oFT);
+    iStatus = FT_destroyUnlocked(oFT);
+    FT_unlockRoot(oFT);
+    return iStatus;
+}
+
+char *FT_toStringIn(FT_T oFT) {
+    char *pcResult;
+
+    assert(oFT != NULL);
+
+    if(Epoch_enter() != SUCCESS)
+        return NULL;
+    pcResult = FT_toStringAtUnlocked(oFT, NULL, 0);
+    Epoch_exit();
+    return pcResult;
+}
+
+char *FT_toStringAtIn(FT_T oFT, const char *pcPath, size_t ulMaxDepth) {
+    char *pcResult;
+
+    assert(oFT != NULL);
+    assert(pcPath != NULL);
+
+    if(Epoch_enter() != SUCCESS)
+        return NULL;
+    pcResult = FT_toStringAtUnlocked(oFT, pcPath, ulMaxDepth);
+    Epoch_exit();
+    return pcResult;
+}
+
+int FT_entryAtIn(FT_T oFT, size_t ulRank, struct ftEntry **ppsEntry) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_entryAtUnlocked(oFT, ulRank, ppsEntry);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_rankOfIn(FT_T oFT, const char *pcPath, size_t *pulRank) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_rankOfUnlocked(oFT, pcPath, pulRank);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_readdirIn(FT_T oFT, const char *pcPath, const char *pcStartAfter,
+                 size_t ulLimit, struct ftEntry **ppsEntries,
+                 size_t *pulCount) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_readdirUnlocked(oFT, pcPath, pcStartAfter, ulLimit,
+                                 ppsEntries, pulCount);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_writeToIn(FT_T oFT, FT_Sink pfSink, void *pvExtra) {
+    int iStatus;
+
+    assert(oFT != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_writeToUnlocked(oFT, pfSink, pvExtra);
+    Epoch_exit();
+    return iStatus;
+}
+
+int FT_writeToFileIn(FT_T oFT, FILE *psFile) {
+    assert(psFile != NULL);
+
+    return FT_writeToIn(oFT, FT_fileSink, psFile);
+}
+
+int FT_writeToFdIn(FT_T oFT, int iFd) {
+    return FT_writeToIn(oFT, FT_fdSink, &iFd);
+}
+
+/* ------------------------------------------------------------------ */
+
+FT_T FT_new(void) {
+    FT_T oFT;
+
+    oFT = calloc(1, sizeof(struct ft));
+    if(oFT == NULL)
+        return NULL;
+
+#ifdef FT_THREADSAFE
+    if(pthread_mutex_init(&oFT->sRootLock, NULL) != 0) {
+        free(oFT);
+        return NULL;
+    }
+    if(pthread_mutex_init(&oFT->sListingLock, NULL) != 0) {
+        (void) pthread_mutex_destroy(&oFT->sRootLock);
+        free(oFT);
+        return NULL;
+    }
+    if(pthread_mutex_init(&oFT->sIndexLock, NULL) != 0) {
+        (void) pthread_mutex_destroy(&oFT->sListingLock);
+        (void) pthread_mutex_destroy(&oFT->sRootLock);
+        free(oFT);
+        return NULL;
+    }
+#endif
+
+    (void) FT_initUnlocked(oFT);
+    return oFT;
+}
+
+/* ------------------------------------------------------------------ */
+
+void FT_free(FT_T oFT) {
+    assert(oFT != NULL);
+
+    if(oFT->bIsInitialized)
+        (void) FT_destroyUnlocked(oFT);
+#ifdef FT_THREADSAFE
+    (void) pthread_mutex_destroy(&oFT->sRootLock);
+    (void) pthread_mutex_destroy(&oFT->sListingLock);
+    (void) pthread_mutex_destroy(&oFT->sIndexLock);
+#endif
+    free(oFT);
+
+    /* free the retired nodes now if no reader holds them back, rather
+       than at some later retire, but never wait for readers: the
+       caller may itself be iterating over another FT */
+    Epoch_collect();
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions implement FT_Iter_T. An iterator holds a
+  stack of frames, one for each directory it is inside, each scanning
+  that directory's child snapshot twice: once for files, then once
+  for directories, pushing a frame for each one it reports.
+*/
+
+/* A directory an iterator is inside */
+struct iterFrame {
+    /* the directory's children, as of when it was entered */
+    DynArray_T oDChildren;
+    /* the index in oDChildren to examine next */
+    size_t ulNext;
+    /* FALSE during the pass over files, TRUE during the one over
+       directories */
+    boolean bDirPass;
+};
+
+/* A depth-first iteration over part of a FT */
+struct ftIter {
+    /* the node to report first, or NULL once it has been */
+    Node_T oNFirst;
+    /* the frames of the directories being scanned, innermost last */
+    struct iterFrame *psFrames;
+    /* the number of frames in use */
+    size_t ulDepth;
+    /* the number of frames allocated */
+    size_t ulCapacity;
+};
+
+/*
+  Fills in *psEntry to describe oNNode and, if oNNode is a directory,
+  pushes a frame onto oIter to scan its children. Returns SUCCESS, or
+  MEMORY_ERROR if the frame could not be pushed.
+*/
+static int FT_iterReport(FT_Iter_T oIter, Node_T oNNode,
+                         struct ftEntry *psEntry) {
+    DynArray_T oDChildren;
+
+    assert(oIter != NULL);
+    assert(oNNode != NULL);
+    assert(psEntry != NULL);
+
+    oDChildren = Node_getChildren(oNNode);
+    if(oDChildren != NULL) {
+        struct iterFrame *psFrame;
+
+        if(oIter->ulDepth == oIter->ulCapacity) {
+            size_t ulNewCapacity = 2 * oIter->ulCapacity + 4;
+            struct iterFrame *psNew =
+                realloc(oIter->psFrames,
+                        ulNewCapacity * sizeof(struct iterFrame));
+            if(psNew == NULL)
+                return MEMORY_ERROR;
+            oIter->psFrames = psNew;
+            oIter->ulCapacity = ulNewCapacity;
+        }
+
+        psFrame = &oIter->psFrames[oIter->ulDepth++];
+        psFrame->oDChildren = oDChildren;
+        psFrame->ulNext = 0;
+        psFrame->bDirPass = FALSE;
+    }
+
+    psEntry->pcPath = Path_getPathname(Node_getPath(oNNode));
+    psEntry->type = Node_getType(oNNode);
+    psEntry->ulSize = 0;
+    if(psEntry->type == IS_FILE)
+        psEntry->ulSize = Node_getSize(oNNode);
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+int FT_iterBeginIn(FT_T oFT, const char *pcPath, FT_Iter_T *poIter) {
+    FT_Iter_T oIter;
+    Node_T oNFirst = NULL;
+    int iStatus;
+
+    assert(oFT != NULL);
+    assert(poIter != NULL);
+
+    *poIter = NULL;
+
+    /* stays in the critical section until FT_iterEnd */
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(pcPath != NULL)
+        iStatus = FT_findNode(oFT, pcPath, &oNFirst);
+    else if(!Epoch_load(&oFT->bIsInitialized))
+        iStatus = INITIALIZATION_ERROR;
+    else
+        oNFirst = Epoch_load(&oFT->oNRoot);
+
+    if(iStatus == SUCCESS) {
+        oIter = calloc(1, sizeof(struct ftIter));
+        if(oIter == NULL)
+            iStatus = MEMORY_ERROR;
+    }
+    if(iStatus != SUCCESS) {
+        Epoch_exit();
+        return iStatus;
     }
 
-    /* starting at oNCurr, build rest of the path one level at a time */
-    while(ulIndex <= ulDepth) {
-        Path_T oPPrefix = NULL;
-        Node_T oNNewNode = NULL;
+    oIter->oNFirst = oNFirst;
+    *poIter = oIter;
+    return SUCCESS;
+}
 
-        /* generate a Path_T for this level */
-        iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-        if(iStatus != SUCCESS) {
-            Path_free(oPPath);
-            if(oNFirstNew != NULL)
-                (void) Node_free(oNFirstNew);
-            return iStatus;
-        }
+/* ------------------------------------------------------------------ */
 
-        /* insert the new directory type node for this level */
-        if (ulIndex < ulDepth)
-            iStatus = Node_new(oPPrefix, IS_DIRECTORY, oNCurr, &oNNewNode);
-        else
-            iStatus = Node_new(oPPrefix, IS_FILE, oNCurr, &oNNewNode);
-        
-        if(iStatus != SUCCESS) {
-            Path_free(oPPath);
-            Path_free(oPPrefix);
-            if(oNFirstNew != NULL)
-                (void) Node_free(oNFirstNew);
-            return iStatus;
-        }
+int FT_iterNext(FT_Iter_T oIter, struct ftEntry *psEntry) {
+    assert(oIter != NULL);
+    assert(psEntry != NULL);
 
-        /* check if file, insert contents if yes */
-        if (Node_getType(oNNewNode) == IS_FILE){
-            iStatus = Node_insertFileContents(oNNewNode, 
-            pvContents, ulLength);
-            if (iStatus !=SUCCESS){
-                Path_free(oPPath);
-                Path_free(oPPrefix);
-                if(oNFirstNew != NULL)
-                    (void) Node_free(oNFirstNew);
+    if(oIter->oNFirst != NULL) {
+        Node_T oNFirst = oIter->oNFirst;
+        oIter->oNFirst = NULL;
+        return FT_iterReport(oIter, oNFirst, psEntry);
+    }
+
+    while(oIter->ulDepth > 0) {
+        struct iterFrame *psFrame = &oIter->psFrames[oIter->ulDepth - 1];
+        size_t ulChildren = DynArray_getLength(psFrame->oDChildren);
+
+        while(psFrame->ulNext < ulChildren) {
+            Node_T oNChild = DynArray_get(psFrame->oDChildren,
+                                          psFrame->ulNext);
+            nodeType wanted = psFrame->bDirPass ? IS_DIRECTORY : IS_FILE;
+
+            if(Node_getType(oNChild) == wanted) {
+                /* a push may move the frames, so index them afresh;
+                   on failure, leave the child to be retried */
+                size_t ulTop = oIter->ulDepth - 1;
+                int iStatus = FT_iterReport(oIter, oNChild, psEntry);
+                if(iStatus == SUCCESS)
+                    oIter->psFrames[ulTop].ulNext++;
                 return iStatus;
             }
+            psFrame->ulNext++;
         }
 
-        /* set up for next level */
-        Path_free(oPPrefix);
-        oNCurr = oNNewNode;
-        ulNewNodes++;
-        if(oNFirstNew == NULL)
-            oNFirstNew = oNCurr;
-        ulIndex++;
+        /* files done: go round again for the directories */
+        if(!psFrame->bDirPass) {
+            psFrame->bDirPass = TRUE;
+            psFrame->ulNext = 0;
+        }
+        else
+            oIter->ulDepth--;
     }
 
-    Path_free(oPPath);
-    /* update FT state variables to reflect insertion */
-    if(oNRoot == NULL)
-        oNRoot = oNFirstNew;
-    ulCount += ulNewNodes;
-    
-    return SUCCESS;
+    return NO_SUCH_PATH;
 }
 
 /* ------------------------------------------------------------------ */
 
-boolean FT_containsFile(const char *pcPath){
+void FT_iterEnd(FT_Iter_T oIter) {
+    assert(oIter != NULL);
+
+    free(oIter->psFrames);
+    free(oIter);
+    Epoch_exit();
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions implement FT_glob. A pattern is compiled
+  into one segment per component, and the walk carries, for each node,
+  the set of segments that could match its next component below it,
+  as a bit mask. Bit i means "segment i comes next"; bit ulSegments
+  means the whole pattern has matched. Without "**" the set is a
+  single bit, which picks the children to visit by binary search;
+  with "**" in it, every child must be visited anyway.
+*/
+
+/* The kinds of segment a compiled pattern contains */
+enum globKind { GLOB_LITERAL, GLOB_WILDCARD, GLOB_ANY_DEPTH };
+
+/* One component of a compiled glob pattern */
+struct globSegment {
+    /* the component (not '\0'-terminated), and its length */
+    const char *pcText;
+    size_t ulLength;
+    /* the length of the literal prefix before the first wildcard */
+    size_t ulPrefix;
+    /* what the component matches */
+    enum globKind eKind;
+};
+
+/* A compiled pattern, and the query running it */
+struct glob {
+    /* the segments, and the number of them */
+    struct globSegment *psSegments;
+    size_t ulSegments;
+    /* the visitor, and the extra argument to pass it */
+    FT_Visitor pfVisit;
+    void *pvExtra;
+    /* the first status other than SUCCESS the visitor returned */
     int iStatus;
-    Node_T oNFound = NULL;
+};
 
-    assert(pcPath != NULL);
+/*
+  Compiles pcPattern into psGlob->psSegments, collapsing consecutive
+  "**" components. Returns SUCCESS, or BAD_PATH if pcPattern is not
+  well-formatted or has more than FT_GLOB_MAX_SEGMENTS components, or
+  MEMORY_ERROR.
+*/
+static int FT_globCompile(const char *pcPattern, struct glob *psGlob) {
+    const char *pc;
+    size_t ulComponents = 1;
+
+    assert(pcPattern != NULL);
+    assert(psGlob != NULL);
+
+    if(!FT_isWellFormatted(pcPattern))
+        return BAD_PATH;
+    for(pc = pcPattern; *pc != '\0'; pc++)
+        if(*pc == '/')
+            ulComponents++;
+    if(ulComponents > FT_GLOB_MAX_SEGMENTS)
+        return BAD_PATH;
+
+    psGlob->psSegments = malloc(ulComponents *
+                                sizeof(struct globSegment));
+    if(psGlob->psSegments == NULL)
+        return MEMORY_ERROR;
+    psGlob->ulSegments = 0;
+
+    for(pc = pcPattern; *pc != '\0'; ) {
+        struct globSegment *psSegment =
+            &psGlob->psSegments[psGlob->ulSegments];
+        size_t ulLength = strcspn(pc, "/");
+
+        psSegment->pcText = pc;
+        psSegment->ulLength = ulLength;
+        psSegment->ulPrefix = strcspn(pc, "*?/");
+        if(ulLength == 2 && pc[0] == '*' && pc[1] == '*')
+            psSegment->eKind = GLOB_ANY_DEPTH;
+        else if(psSegment->ulPrefix < ulLength)
+            psSegment->eKind = GLOB_WILDCARD;
+        else
+            psSegment->eKind = GLOB_LITERAL;
 
-    if (oNRoot == NULL)
-        return FALSE;
+        /* "**" twice in a row matches nothing more than once */
+        if(psSegment->eKind != GLOB_ANY_DEPTH ||
+           psGlob->ulSegments == 0 ||
+           psSegment[-1].eKind != GLOB_ANY_DEPTH)
+            psGlob->ulSegments++;
 
-    /* search for file node in the FT */
-    iStatus = FT_findNode(pcPath, &oNFound);
+        pc += ulLength;
+        if(*pc == '/')
+            pc++;
+    }
+    return SUCCESS;
+}
 
-    if (iStatus != SUCCESS)
-        return FALSE;
-    /* directory, not file */ 
-    if (Node_getType(oNFound) != IS_FILE) {
-        return FALSE;
+/*
+  Returns TRUE if the component pcName matches the segment psSegment,
+  which is not GLOB_ANY_DEPTH, and FALSE if it does not.
+*/
+static boolean FT_globMatchName(const struct globSegment *psSegment,
+                                const char *pcName) {
+    const char *pcPat;
+    const char *pcPatEnd;
+    const char *pcAfterStar = NULL;
+    const char *pcStarName = NULL;
+
+    assert(psSegment != NULL);
+    assert(pcName != NULL);
+
+    pcPat = psSegment->pcText;
+    pcPatEnd = pcPat + psSegment->ulLength;
+
+    if(psSegment->eKind == GLOB_LITERAL)
+        return (boolean) (strncmp(pcName, pcPat, psSegment->ulLength)
+                          == 0 && pcName[psSegment->ulLength] == '\0');
+
+    /* on a mismatch, let the most recent '*' absorb one more char */
+    while(*pcName != '\0') {
+        if(pcPat < pcPatEnd && (*pcPat == '?' || *pcPat == *pcName)) {
+            pcPat++;
+            pcName++;
+        }
+        else if(pcPat < pcPatEnd && *pcPat == '*') {
+            pcAfterStar = ++pcPat;
+            pcStarName = pcName;
+        }
+        else if(pcAfterStar != NULL) {
+            pcPat = pcAfterStar;
+            pcName = ++pcStarName;
+        }
+        else
+            return FALSE;
     }
-    return (boolean) (iStatus == SUCCESS);
+    while(pcPat < pcPatEnd && *pcPat == '*')
+        pcPat++;
+    return (boolean) (pcPat == pcPatEnd);
 }
 
-/* ------------------------------------------------------------------ */
+/*
+  Returns the state set ulStates with, for every "**" segment in it,
+  the segment after it added, since "**" may match no components.
+*/
+static unsigned long FT_globClosure(const struct glob *psGlob,
+                                    unsigned long ulStates) {
+    size_t i;
 
-int FT_rmFile(const char *pcPath){
-    int iStatus;
-    Node_T oNFound = NULL;
+    assert(psGlob != NULL);
 
-    assert(pcPath != NULL);
-   
-    /* search for file node */
-    iStatus = FT_findNode(pcPath, &oNFound);
+    for(i = 0; i < psGlob->ulSegments; i++)
+        if((ulStates & (1UL << i)) &&
+           psGlob->psSegments[i].eKind == GLOB_ANY_DEPTH)
+            ulStates |= 1UL << (i + 1);
+    return ulStates;
+}
 
-    if (iStatus != SUCCESS)
-        return iStatus;
-    
-    /* directory, not file */
-    if (Node_getType(oNFound) == IS_DIRECTORY)
-        return NOT_A_FILE;
+/*
+  Returns the state set of a node with final component pcName, given
+  the state set ulStates of its parent.
+*/
+static unsigned long FT_globStep(const struct glob *psGlob,
+                                 unsigned long ulStates,
+                                 const char *pcName) {
+    unsigned long ulNext = 0;
+    size_t i;
 
-    ulCount -= Node_free(oNFound);
-    if(ulCount == 0)
-        oNRoot = NULL;
+    assert(psGlob != NULL);
+    assert(pcName != NULL);
 
-    return SUCCESS;
-    
+    for(i = 0; i < psGlob->ulSegments; i++) {
+        const struct globSegment *psSegment = &psGlob->psSegments[i];
+
+        if(!(ulStates & (1UL << i)))
+            continue;
+        if(psSegment->eKind == GLOB_ANY_DEPTH)
+            ulNext |= 1UL << i;
+        else if(FT_globMatchName(psSegment, pcName))
+            ulNext |= 1UL << (i + 1);
+    }
+    return FT_globClosure(psGlob, ulNext);
 }
 
-/* ------------------------------------------------------------------ */
+/* Returns the final component of oNNode's path. */
+static const char *FT_globName(Node_T oNNode) {
+    Path_T oPPath;
 
-void *FT_getFileContents(const char *pcPath){
-    int iStatus;
-    Node_T oNFound = NULL;
+    assert(oNNode != NULL);
 
-    assert(pcPath != NULL);
+    oPPath = Node_getPath(oNNode);
+    return Path_getComponent(oPPath, Path_getDepth(oPPath) - 1);
+}
 
-    /* find node in the FT */
-    iStatus = FT_findNode(pcPath, &oNFound);
-    if (iStatus != SUCCESS) {
-        return NULL;
+/*
+  Reports oNNode to psGlob's visitor if its state set ulStates says
+  the pattern has matched it, and then visits, in FT_toString order,
+  those of its children that may match or lead to a match.
+*/
+static void FT_globVisit(struct glob *psGlob, Node_T oNNode,
+                         unsigned long ulStates) {
+    DynArray_T oDChildren;
+    unsigned long ulActive;
+    size_t ulFirst = 0;
+    size_t ulEnd;
+    int iPass;
+
+    assert(psGlob != NULL);
+    assert(oNNode != NULL);
+
+    if(ulStates & (1UL << psGlob->ulSegments)) {
+        Path_T oPPath = Node_getPath(oNNode);
+        struct ftEntry sEntry;
+
+        sEntry.pcPath = Path_getPathname(oPPath);
+        sEntry.type = Node_getType(oNNode);
+        sEntry.ulSize = 0;
+        if(sEntry.type == IS_FILE)
+            sEntry.ulSize = Node_getSize(oNNode);
+        psGlob->iStatus = (*psGlob->pfVisit)(&sEntry, psGlob->pvExtra);
+    }
+
+    oDChildren = Node_getChildren(oNNode);
+    ulActive = ulStates & ~(1UL << psGlob->ulSegments);
+    if(oDChildren == NULL || ulActive == 0 ||
+       psGlob->iStatus != SUCCESS)
+        return;
+    ulEnd = DynArray_getLength(oDChildren);
+
+    /* a single segment picks out the children it can match: names
+       sharing its literal prefix are adjacent in the sorted array */
+    if((ulActive & (ulActive - 1)) == 0) {
+        const struct globSegment *psSegment = psGlob->psSegments;
+
+        while(!(ulActive & 1UL)) {
+            ulActive >>= 1;
+            psSegment++;
+        }
+        if(psSegment->eKind == GLOB_LITERAL) {
+            if(Node_findChildIndex(oDChildren, psSegment->pcText,
+                                   psSegment->ulLength, &ulFirst))
+                ulEnd = ulFirst + 1;
+            else
+                ulEnd = ulFirst;
+        }
+        else if(psSegment->eKind == GLOB_WILDCARD) {
+            size_t ulLength = ulEnd;
+
+            (void) Node_findChildIndex(oDChildren, psSegment->pcText,
+                                       psSegment->ulPrefix, &ulFirst);
+            for(ulEnd = ulFirst; ulEnd < ulLength; ulEnd++)
+                if(strncmp(FT_globName(DynArray_get(oDChildren, ulEnd)),
+                           psSegment->pcText, psSegment->ulPrefix) != 0)
+                    break;
+        }
     }
 
-    return Node_getContents(oNFound);
+    /* files first, then directories, as FT_toString lists them */
+    for(iPass = 0; iPass < 2; iPass++) {
+        size_t i;
+
+        for(i = ulFirst; i < ulEnd && psGlob->iStatus == SUCCESS; i++) {
+            Node_T oNChild = DynArray_get(oDChildren, i);
+            unsigned long ulChildStates;
+
+            if((Node_getType(oNChild) == IS_FILE) != (iPass == 0))
+                continue;
+            ulChildStates = FT_globStep(psGlob, ulStates,
+                                        FT_globName(oNChild));
+            if(ulChildStates != 0)
+                FT_globVisit(psGlob, oNChild, ulChildStates);
+        }
+    }
 }
 
 /* ------------------------------------------------------------------ */
 
-void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
-                             size_t ulNewLength){
+int FT_globIn(FT_T oFT, const char *pcPattern, FT_Visitor pfVisit,
+              void *pvExtra) {
+    struct glob sGlob;
+    Node_T oNRoot;
     int iStatus;
-    Node_T oNFound = NULL;
-    void *pvOldContents;
 
-    assert(pcPath != NULL);
-    assert (pvNewContents != NULL);
+    assert(oFT != NULL);
+    assert(pcPattern != NULL);
+    assert(pfVisit != NULL);
 
-    /* search for the node in the FT */ 
-    iStatus = FT_findNode(pcPath, &oNFound);
-    if (iStatus != SUCCESS) {
-        return NULL;
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(!Epoch_load(&oFT->bIsInitialized)) {
+        Epoch_exit();
+        return INITIALIZATION_ERROR;
     }
 
-    /* store old contents to return */ 
-    pvOldContents = Node_getContents(oNFound);
-    iStatus = Node_insertFileContents(oNFound, pvNewContents, 
-    ulNewLength);
+    iStatus = FT_globCompile(pcPattern, &sGlob);
+    if(iStatus != SUCCESS) {
+        Epoch_exit();
+        return iStatus;
+    }
+    sGlob.pfVisit = pfVisit;
+    sGlob.pvExtra = pvExtra;
+    sGlob.iStatus = SUCCESS;
+
+    /* the root is matched like the only child of an imaginary node */
+    oNRoot = Epoch_load(&oFT->oNRoot);
+    if(oNRoot != NULL) {
+        unsigned long ulStates =
+            FT_globStep(&sGlob, FT_globClosure(&sGlob, 1UL),
+                        FT_globName(oNRoot));
+        if(ulStates != 0)
+            FT_globVisit(&sGlob, oNRoot, ulStates);
+    }
 
-    if (iStatus == SUCCESS)
-        return pvOldContents;
-    return NULL;
+    free(sGlob.psSegments);
+    Epoch_exit();
+    return sGlob.iStatus;
 }
 
-/* ------------------------------------------------------------------ */
+/* --------------------------------------------------------------------
 
-int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize){
-    Node_T oNFound = NULL;
+  The following functions implement FT_findByName and
+  FT_findByExtension, and the name index that answers them.
+*/
+
+/* A search for the nodes with a given name or extension */
+struct find {
+    /* the name or extension sought */
+    const char *pcKey;
+    /* TRUE if pcKey is an extension, FALSE if it is a name */
+    boolean bExtension;
+    /* the visitor, and the extra argument to pass it */
+    FT_Visitor pfVisit;
+    void *pvExtra;
+};
+
+/* Describes oNNode to psFind's visitor, and returns what it returns. */
+static int FT_findReport(Node_T oNNode, void *pvFind) {
+    struct find *psFind = pvFind;
+    struct ftEntry sEntry;
+
+    assert(oNNode != NULL);
+    assert(psFind != NULL);
+
+    sEntry.pcPath = Path_getPathname(Node_getPath(oNNode));
+    sEntry.type = Node_getType(oNNode);
+    sEntry.ulSize = 0;
+    if(sEntry.type == IS_FILE)
+        sEntry.ulSize = Node_getSize(oNNode);
+    return (*psFind->pfVisit)(&sEntry, psFind->pvExtra);
+}
+
+/*
+  Reports every node in the subtree rooted at oNNode that psFind
+  seeks, in FT_toString order, as FT_findByName does without an index.
+*/
+static int FT_findWalk(struct find *psFind, Node_T oNNode) {
+    const char *pcName;
+    DynArray_T oDChildren;
+    int iStatus = SUCCESS;
+    int iPass;
+
+    assert(psFind != NULL);
+    assert(oNNode != NULL);
+
+    pcName = FT_globName(oNNode);
+    if(psFind->bExtension) {
+        if(Node_getType(oNNode) == IS_FILE)
+            pcName = NameIndex_getExtension(pcName);
+        else
+            pcName = NULL;
+    }
+    if(pcName != NULL && strcmp(pcName, psFind->pcKey) == 0)
+        iStatus = FT_findReport(oNNode, psFind);
+
+    oDChildren = Node_getChildren(oNNode);
+    if(oDChildren == NULL)
+        return iStatus;
+
+    /* files first, then directories, as FT_toString lists them */
+    for(iPass = 0; iPass < 2; iPass++) {
+        size_t i;
+
+        for(i = 0; i < DynArray_getLength(oDChildren) &&
+                iStatus == SUCCESS; i++) {
+            Node_T oNChild = DynArray_get(oDChildren, i);
+
+            if((Node_getType(oNChild) == IS_FILE) == (iPass == 0))
+                iStatus = FT_findWalk(psFind, oNChild);
+        }
+    }
+    return iStatus;
+}
+
+/*
+  Reports the nodes psFind seeks in oFT, using its index if it has
+  one. Returns SUCCESS, or the first other status the visitor returns,
+  or INITIALIZATION_ERROR, BAD_PATH, or MEMORY_ERROR as documented for
+  FT_findByName.
+*/
+static int FT_find(FT_T oFT, struct find *psFind) {
+    Node_T oNRoot;
     int iStatus;
-    nodeType type;
 
-    assert(pcPath != NULL);
-    assert(pbIsFile != NULL);
-    assert (pulSize != NULL);
-    
-    /* search for node */
-    iStatus = FT_findNode(pcPath, &oNFound);
-    if (iStatus != SUCCESS) {
+    assert(oFT != NULL);
+    assert(psFind != NULL);
+    assert(psFind->pcKey != NULL);
+    assert(psFind->pfVisit != NULL);
+
+    if(*psFind->pcKey == '\0' || strchr(psFind->pcKey, '/') != NULL)
+        return BAD_PATH;
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
         return iStatus;
+
+    if(!Epoch_load(&oFT->bIsInitialized)) {
+        Epoch_exit();
+        return INITIALIZATION_ERROR;
     }
 
-    /* store node type, set type flags */ 
-    type = Node_getType(oNFound);
-    if (type == IS_DIRECTORY){
-        *pbIsFile = FALSE;
+    FT_lockIndex(oFT);
+    if(oFT->oIndex != NULL) {
+        if(psFind->bExtension)
+            iStatus = NameIndex_findExtension(oFT->oIndex,
+                                              psFind->pcKey,
+                                              FT_findReport, psFind);
+        else
+            iStatus = NameIndex_findName(oFT->oIndex, psFind->pcKey,
+                                         FT_findReport, psFind);
+        FT_unlockIndex(oFT);
     }
-    else{
-        *pbIsFile = TRUE;
-        *pulSize = Node_getSize(oNFound);
+    else {
+        FT_unlockIndex(oFT);
+        oNRoot = Epoch_load(&oFT->oNRoot);
+        if(oNRoot != NULL)
+            iStatus = FT_findWalk(psFind, oNRoot);
     }
 
-    return SUCCESS;
+    Epoch_exit();
+    return iStatus;
 }
 
 /* ------------------------------------------------------------------ */
 
-int FT_init(void){
-    if(bIsInitialized)
+int FT_setNameIndexIn(FT_T oFT, boolean bEnabled) {
+    NameIndex_T oIndex;
+    Node_T oNRoot;
+    int iStatus = SUCCESS;
+
+    assert(oFT != NULL);
+
+    iStatus = Epoch_enter();
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    if(!Epoch_load(&oFT->bIsInitialized)) {
+        Epoch_exit();
         return INITIALIZATION_ERROR;
+    }
 
-    bIsInitialized = TRUE;
-    oNRoot = NULL;
-    ulCount = 0;
+    FT_lockIndex(oFT);
+    if(!bEnabled)
+        FT_dropIndex(oFT);
+    else if(oFT->oIndex == NULL) {
+        oIndex = NameIndex_new();
+        if(oIndex == NULL)
+            iStatus = MEMORY_ERROR;
+        else {
+            Epoch_store(&oFT->oIndex, oIndex);
+#ifdef FT_THREADSAFE
+            /* pairs with the fence in FT_mayHaveIndex */
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+            oNRoot = Epoch_load(&oFT->oNRoot);
+            if(oNRoot != NULL)
+                iStatus = NameIndex_addSubtree(oIndex, oNRoot);
+            if(iStatus != SUCCESS)
+                FT_dropIndex(oFT);
+        }
+    }
+    FT_unlockIndex(oFT);
 
-    return SUCCESS;
+    Epoch_exit();
+    return iStatus;
 }
 
 /* ------------------------------------------------------------------ */
 
-int FT_destroy(void){
-    if(!bIsInitialized)
-        return INITIALIZATION_ERROR;
+int FT_findByNameIn(FT_T oFT, const char *pcName, FT_Visitor pfVisit,
+                    void *pvExtra) {
+    struct find sFind;
 
-    /* if FT has components, free them */
-    if(oNRoot) {
-        ulCount -= Node_free(oNRoot);
-        oNRoot = NULL;
-    }
+    assert(oFT != NULL);
+    assert(pcName != NULL);
+    assert(pfVisit != NULL);
 
-    bIsInitialized = FALSE;
+    sFind.pcKey = pcName;
+    sFind.bExtension = FALSE;
+    sFind.pfVisit = pfVisit;
+    sFind.pvExtra = pvExtra;
+    return FT_find(oFT, &sFind);
+}
 
-    return SUCCESS;
+/* ------------------------------------------------------------------ */
+
+int FT_findByExtensionIn(FT_T oFT, const char *pcExtension,
+                         FT_Visitor pfVisit, void *pvExtra) {
+    struct find sFind;
+
+    assert(oFT != NULL);
+    assert(pcExtension != NULL);
+    assert(pfVisit != NULL);
+
+    /* ".log" and "log" ask for the same thing */
+    if(*pcExtension == '.')
+        pcExtension++;
+
+    sFind.pcKey = pcExtension;
+    sFind.bExtension = TRUE;
+    sFind.pfVisit = pfVisit;
+    sFind.pvExtra = pvExtra;
+    return FT_find(oFT, &sFind);
 }
 
-/*--------------------------------------------------------------------*/
+/* --------------------------------------------------------------------
 
-char *FT_toString(void){
-    DynArray_T nodes;
-    size_t totalStrlen = 1;
-    char *result = NULL;
-    
-    if(!bIsInitialized)
-      return NULL;
+  The handle-less functions below operate on the default FT.
+*/
 
-    /* add nodes to dyn array in specified order */
-    nodes = DynArray_new(ulCount);
-    (void) FT_preOrderTraversal(oNRoot, nodes, 0);
+int FT_insertDir(const char *pcPath) {
+    return FT_insertDirIn(&sDefaultFT, pcPath);
+}
 
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strlenAccumulate,
-                (void*) &totalStrlen);
+boolean FT_containsDir(const char *pcPath) {
+    return FT_containsDirIn(&sDefaultFT, pcPath);
+}
 
-    /* allocate mem*/
-    result = malloc(totalStrlen);
-    if(result == NULL) {
-        DynArray_free(nodes);
-        return NULL;
-    }
-    *result = '\0';
+int FT_rmDir(const char *pcPath) {
+    return FT_rmDirIn(&sDefaultFT, pcPath);
+}
+
+int FT_insertFile(const char *pcPath, void *pvContents,
+                  size_t ulLength) {
+    return FT_insertFileIn(&sDefaultFT, pcPath, pvContents, ulLength);
+}
+
+int FT_insertFileMapped(const char *pcPath, int iFd, size_t ulOffset,
+                        size_t ulLength) {
+    return FT_insertFileMappedIn(&sDefaultFT, pcPath, iFd, ulOffset,
+                                 ulLength);
+}
+
+boolean FT_containsFile(const char *pcPath) {
+    return FT_containsFileIn(&sDefaultFT, pcPath);
+}
 
-    /* apply cat accumulate function to array*/
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strcatAccumulate,
-                    (void *) result);
+int FT_rmFile(const char *pcPath) {
+    return FT_rmFileIn(&sDefaultFT, pcPath);
+}
+
+void *FT_getFileContents(const char *pcPath) {
+    return FT_getFileContentsIn(&sDefaultFT, pcPath);
+}
+
+void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
+                             size_t ulNewLength) {
+    return FT_replaceFileContentsIn(&sDefaultFT, pcPath, pvNewContents,
+                                    ulNewLength);
+}
+
+int FT_insertFileContent(const char *pcPath, Content_T oContent) {
+    return FT_insertFileContentIn(&sDefaultFT, pcPath, oContent);
+}
+
+int FT_getFileContent(const char *pcPath, Content_T *poContent) {
+    return FT_getFileContentIn(&sDefaultFT, pcPath, poContent);
+}
+
+int FT_replaceFileContent(const char *pcPath, Content_T oNewContent) {
+    return FT_replaceFileContentIn(&sDefaultFT, pcPath, oNewContent);
+}
+
+int FT_readAt(const char *pcPath, size_t ulOffset, size_t ulLength,
+              void *pvDest, size_t *pulRead) {
+    return FT_readAtIn(&sDefaultFT, pcPath, ulOffset, ulLength, pvDest,
+                       pulRead);
+}
+
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvData,
+               size_t ulLength) {
+    return FT_writeAtIn(&sDefaultFT, pcPath, ulOffset, pvData,
+                        ulLength);
+}
+
+int FT_appendFile(const char *pcPath, const void *pvData,
+                  size_t ulLength) {
+    return FT_appendFileIn(&sDefaultFT, pcPath, pvData, ulLength);
+}
+
+int FT_cloneFile(const char *pcSrcPath, const char *pcDstPath) {
+    return FT_cloneFileIn(&sDefaultFT, pcSrcPath, pcDstPath);
+}
+
+int FT_compressCold(size_t ulTarget, size_t *pulResident) {
+    return FT_compressColdIn(&sDefaultFT, ulTarget, pulResident);
+}
+
+int FT_setChunkedContents(boolean bEnabled) {
+    return FT_setChunkedContentsIn(&sDefaultFT, bEnabled);
+}
+
+int FT_setInlineLimit(size_t ulLimit) {
+    return FT_setInlineLimitIn(&sDefaultFT, ulLimit);
+}
+
+int FT_setMemoryBudget(size_t ulBudget) {
+    return FT_setMemoryBudgetIn(&sDefaultFT, ulBudget);
+}
+
+int FT_setContentStore(boolean bEnabled) {
+    return FT_setContentStoreIn(&sDefaultFT, bEnabled);
+}
+
+int FT_getContentStoreStats(struct contentStoreStats *psStats) {
+    return FT_getContentStoreStatsIn(&sDefaultFT, psStats);
+}
 
-    DynArray_free(nodes);
+int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize) {
+    return FT_statIn(&sDefaultFT, pcPath, pbIsFile, pulSize);
+}
+
+int FT_init(void) {
+    return FT_initIn(&sDefaultFT);
+}
+
+int FT_buildFromSorted(const char **ppcPaths, const nodeType *peTypes,
+                       void **ppvContents, const size_t *pulLengths,
+                       size_t ulNum) {
+    return FT_buildFromSortedIn(&sDefaultFT, ppcPaths, peTypes,
+                                ppvContents, pulLengths, ulNum);
+}
+
+int FT_destroy(void) {
+    return FT_destroyIn(&sDefaultFT);
+}
+
+char *FT_toString(void) {
+    return FT_toStringIn(&sDefaultFT);
+}
+
+char *FT_toStringAt(const char *pcPath, size_t ulMaxDepth) {
+    return FT_toStringAtIn(&sDefaultFT, pcPath, ulMaxDepth);
+}
+
+int FT_entryAt(size_t ulRank, struct ftEntry **ppsEntry) {
+    return FT_entryAtIn(&sDefaultFT, ulRank, ppsEntry);
+}
+
+int FT_rankOf(const char *pcPath, size_t *pulRank) {
+    return FT_rankOfIn(&sDefaultFT, pcPath, pulRank);
+}
+
+int FT_writeTo(FT_Sink pfSink, void *pvExtra) {
+    return FT_writeToIn(&sDefaultFT, pfSink, pvExtra);
+}
+
+int FT_writeToFile(FILE *psFile) {
+    return FT_writeToFileIn(&sDefaultFT, psFile);
+}
+
+int FT_writeToFd(int iFd) {
+    return FT_writeToFdIn(&sDefaultFT, iFd);
+}
+
+int FT_iterBegin(const char *pcPath, FT_Iter_T *poIter) {
+    return FT_iterBeginIn(&sDefaultFT, pcPath, poIter);
+}
+
+int FT_readdir(const char *pcPath, const char *pcStartAfter,
+               size_t ulLimit, struct ftEntry **ppsEntries,
+               size_t *pulCount) {
+    return FT_readdirIn(&sDefaultFT, pcPath, pcStartAfter, ulLimit,
+                        ppsEntries, pulCount);
+}
+
+int FT_glob(const char *pcPattern, FT_Visitor pfVisit,
+            void *pvExtra) {
+    return FT_globIn(&sDefaultFT, pcPattern, pfVisit, pvExtra);
+}
+
+int FT_setNameIndex(boolean bEnabled) {
+    return FT_setNameIndexIn(&sDefaultFT, bEnabled);
+}
+
+int FT_findByName(const char *pcName, FT_Visitor pfVisit,
+                  void *pvExtra) {
+    return FT_findByNameIn(&sDefaultFT, pcName, pfVisit, pvExtra);
+}
 
-    return result;
-}
\ No newline at end of file
+int FT_findByExtension(const char *pcExtension, FT_Visitor pfVisit,
+                       void *pvExtra) {
+    return FT_findByExtensionIn(&sDefaultFT, pcExtension, pfVisit,
+                                pvExtra);
+}
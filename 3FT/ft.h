@@ -13,7 +13,15 @@
 */
 
 #include <stddef.h>
+#include <stdio.h>
 #include "a4def.h"
+#include "content.h"
+
+/*
+  An FT_T is a handle to an independent File Tree. The functions
+  without a handle parameter operate on a single default File Tree.
+*/
+typedef struct ft *FT_T;
 
 /*
    Inserts a new directory into the FT with absolute path pcPath.
@@ -96,11 +104,249 @@ void *FT_getFileContents(const char *pcPath);
   Replaces current contents of the file with absolute path pcPath with
   the parameter pvNewContents of size ulNewLength bytes.
   Returns the old contents if successful. (Note: contents may be NULL.)
-  Returns NULL if unable to complete the request for any reason.
+  Returns NULL if unable to complete the request for any reason, or if
+  the old contents were a Content_T the file owned, which it releases.
 */
 void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
                              size_t ulNewLength);
 
+/*
+  FT_insertFileContent, FT_getFileContent, and FT_replaceFileContent
+  work with owned contents: instead of borrowing the caller's bytes,
+  which must then outlive the file, the file takes a reference to an
+  immutable Content_T (see content.h). A buffer may be shared by any
+  number of files and readers, so storing or reading it costs no copy.
+  FT_getFileContents still returns the bytes of owned contents, valid
+  until the file's contents are next replaced or the file is removed.
+*/
+
+/*
+  Like FT_insertFile, but the new file takes a reference to oContent,
+  which the caller keeps its own reference to, as its contents.
+*/
+int FT_insertFileContent(const char *pcPath, Content_T oContent);
+
+/*
+  Like FT_insertFile, but the new file's contents are the ulLength
+  bytes at offset ulOffset of the host file open for reading as iFd,
+  mapped into memory as Content_newMapped (see content.h) describes:
+  inserting takes no time to read them, they are paged in from disk
+  as they are used, and they are unmapped when the file is removed or
+  its contents replaced. FT_getFileContents returns a pointer into
+  the mapping. iFd may be closed once this returns, but the host file
+  must not be truncated while the file holds the mapping: reading its
+  contents past the host file's new end then kills the process with
+  SIGBUS. Also returns IO_ERROR if the host file could not be mapped
+  or does not extend to ulOffset + ulLength.
+*/
+int FT_insertFileMapped(const char *pcPath, int iFd, size_t ulOffset,
+                        size_t ulLength);
+
+/*
+  Sets *poContent to a read-only lease on the contents of the file
+  with absolute path pcPath, i.e., a reference the caller must release
+  with Content_release, and returns SUCCESS. The lease stays valid
+  however the file changes. If the file's contents are borrowed from
+  the caller of FT_insertFile or FT_replaceFileContents, the lease is
+  on a new copy of them. Otherwise sets *poContent to NULL and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_FILE if pcPath is in the FT as a directory not a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_getFileContent(const char *pcPath, Content_T *poContent);
+
+/*
+  Makes oNewContent, to which the file takes its own reference, the
+  contents of the file with absolute path pcPath, and releases the old
+  contents if the file owned them (readers holding a lease keep it).
+  Returns SUCCESS, or the status FT_getFileContent would return other
+  than MEMORY_ERROR.
+*/
+int FT_replaceFileContent(const char *pcPath, Content_T oNewContent);
+
+/*
+  Copies into pvDest up to ulLength bytes of the contents of the file
+  with absolute path pcPath, starting ulOffset bytes in, stores how
+  many were copied in *pulRead (fewer than ulLength only at the end of
+  the file), and returns SUCCESS. Otherwise sets *pulRead to 0 and
+  returns the status FT_getFileContent would, which is MEMORY_ERROR
+  only if compressed contents could not be decompressed (see
+  FT_compressCold). Takes time proportional to the bytes copied.
+*/
+int FT_readAt(const char *pcPath, size_t ulOffset, size_t ulLength,
+              void *pvDest, size_t *pulRead);
+
+/*
+  Writes the ulLength bytes at pvData into the file with absolute path
+  pcPath, starting ulOffset bytes in, and returns SUCCESS. A file that
+  ends before ulOffset + ulLength grows to that size, any gap being
+  filled with zero bytes, and FT_stat reports the new size.
+
+  The first write to a file copies its contents into a writable buffer
+  the file owns, with room to double in size; later writes change that
+  buffer in place, in time proportional to the bytes written, until it
+  must grow or FT_getFileContent leases it, when it is copied again.
+  Bytes returned earlier by FT_getFileContents may therefore change.
+
+  Returns SUCCESS, or the status FT_getFileContent would, where
+  MEMORY_ERROR means the file was left unchanged.
+*/
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvData,
+               size_t ulLength);
+
+/*
+  Like FT_writeAt, but writes the ulLength bytes at pvData at the end
+  of the file with absolute path pcPath, wherever that is when the
+  write happens, so that concurrent appends never overwrite each
+  other. Since the file's buffer doubles in room as it grows, a run of
+  appends takes time proportional to the bytes appended, resolving
+  the path once per call.
+*/
+int FT_appendFile(const char *pcPath, const void *pvData,
+                  size_t ulLength);
+
+/*
+  Inserts a file with absolute path pcDstPath, as FT_insertFile does,
+  with the contents of the file with absolute path pcSrcPath, in time
+  independent of their size. A buffer the source owns is shared by
+  both files, and the first write through either name copies it (only
+  the chunks written, if it is chunked); contents the source borrows
+  from the caller are borrowed by the clone too, and must outlive both
+  files; and contents held inline are copied. Neither file sees writes
+  made to the other afterwards.
+
+  Returns SUCCESS, or:
+  * NOT_A_FILE if pcSrcPath is a directory in the FT
+  * a status of FT_stat for pcSrcPath, if it is not in the FT
+  * a status of FT_insertFile for pcDstPath, if the clone cannot be
+    inserted there
+*/
+int FT_cloneFile(const char *pcSrcPath, const char *pcDstPath);
+
+/*
+  Makes FT_writeAt copy files into chunked buffers (see content.h), if
+  bEnabled is TRUE, or flat ones, until this is called again or the FT
+  is destroyed. A chunked file is written in fixed-size chunks, so a
+  write, including one that extends the file, touches only the chunks
+  it covers; a gap left by writing past the end takes no memory; and a
+  lease shares the chunks with the file, so the next write copies only
+  the chunks it changes rather than the whole file. FT_getFileContents
+  returns NULL for a chunked file, whose bytes are not contiguous: read
+  it with FT_readAt or FT_getFileContent instead. Files already chunked
+  stay so either way.
+
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_setChunkedContents(boolean bEnabled);
+
+/*
+  Sweeps the FT for cold file contents: those owned by a file (not
+  borrowed from the caller) that have not been read or written since
+  the previous sweep, which this one compresses, so that calling it
+  periodically keeps the files in use decompressed while the rest are
+  compressed, approximating LRU order. If the contents files own still
+  take more than ulTarget bytes of memory, contents in use are
+  compressed too until they take no more. Only contents a file alone
+  holds in a flat buffer are compressed, and only if compression
+  saves space.
+
+  Compressed contents are decompressed the next time they are read or
+  written, which FT_getFileContents, FT_getFileContent, FT_readAt,
+  and FT_writeAt do transparently. FT_stat still reports their
+  decompressed size. Compressing contents ends the life of a pointer
+  to them returned by FT_getFileContents, as replacing them would.
+
+  Stores in *pulResident, unless pulResident is NULL, the bytes the
+  contents files own take after the sweep, counting a buffer shared
+  by several files once for each. Returns SUCCESS, or
+  INITIALIZATION_ERROR if the FT is not in an initialized state.
+*/
+int FT_compressCold(size_t ulTarget, size_t *pulResident);
+
+/*
+  Keeps the contents files own (not those borrowed from the caller)
+  within ulBudget bytes of memory, until this is called again with
+  another budget or the FT is destroyed; a budget of 0, the initial
+  one, turns the limit off. Whenever writes or insertions of owned
+  buffers may have taken them over budget, and once now, the FT
+  sweeps them as FT_compressCold does, spilling contents to an
+  append-only scratch file instead of compressing them: first those
+  not used since the last sweep, then any, until they take at most
+  seven eighths of the budget, leaving room to grow before the next
+  sweep. Only contents a file alone holds, and that are not
+  compressed, are spilled, and not those FT_getFileContents returned
+  since they were last replaced, so that the pointer it returned stays
+  valid. The sweep runs in the thread that set off the write, and is
+  skipped if another thread is sweeping already.
+
+  Spilled contents are mapped back from the scratch file, which is
+  mapped in large segments rather than one file at a time, so the
+  directories and files stay in memory and reading them is
+  transparent: FT_getFileContents returns the mapped bytes, which the
+  system pages in on use and may drop again under pressure, and
+  FT_writeAt copies them back into memory. The scratch file only
+  grows while the budget is on; its space is freed once the budget is
+  turned off and no spilled contents remain in use.
+
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * IO_ERROR if the scratch file could not be created
+*/
+int FT_setMemoryBudget(size_t ulBudget);
+
+/*
+  Turns the content store on, if bEnabled is TRUE, or off, until this
+  is called again or the FT is destroyed. While it is on, the FT keeps
+  one copy of each distinct run of bytes given as file contents, found
+  by a hash of the bytes and confirmed by comparing them, and files
+  with equal contents share it. FT_insertFile and
+  FT_replaceFileContents then copy the caller's bytes (unless they are
+  NULL) instead of borrowing them, so the caller may free them at
+  once, and FT_getFileContents returns the shared copy. Flat buffers
+  given to FT_insertFileContent and FT_replaceFileContent are replaced
+  by the shared copy of their bytes; chunked ones are kept as they
+  are. Files inserted before the store was on keep their contents, and
+  those inserted while it was on keep sharing after it is turned off.
+
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if the store could not be allocated
+  With the store on, the functions above may also return MEMORY_ERROR
+  if the bytes could not be copied into it.
+*/
+int FT_setContentStore(boolean bEnabled);
+
+/*
+  Stores in *psStats how many distinct buffers the content store holds
+  and their bytes, and how many references (files' and leases') are
+  held to them and the bytes those would take unshared; the ratio of
+  the two byte counts is the saving. All are 0 if the store is off.
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_getContentStoreStats(struct contentStoreStats *psStats);
+
+/*
+  Makes FT_insertFile copy contents of at most ulLimit bytes (other
+  than NULL or empty ones) into the new file's own node, until this is
+  called again or the FT is destroyed; 0, the initial limit, copies
+  none. Reading such a file then touches no memory beyond its node,
+  and the caller may free the bytes at once. FT_getFileContents
+  returns the copy, and replacing it returns NULL rather than a
+  pointer to it; the copy is not freed until the file is, so files
+  whose contents change often are better left with a limit of 0.
+  Contents within the limit bypass the content store.
+
+  Returns SUCCESS, or INITIALIZATION_ERROR if the FT is not in an
+  initialized state.
+*/
+int FT_setInlineLimit(size_t ulLimit);
+
 /*
   Returns SUCCESS if pcPath exists in the hierarchy,
   Otherwise, returns:
@@ -135,6 +381,32 @@ int FT_init(void);
 */
 int FT_destroy(void);
 
+/*
+  Populates the empty FT in one linear pass from a manifest of ulNum
+  absolute paths ppcPaths, where entry i has type peTypes[i] and, if
+  it is a file, contents ppvContents[i] of size pulLengths[i] bytes
+  (those two entries are ignored for directories).
+
+  The manifest must be sorted component by component, i.e., each
+  path's ancestors come before it and siblings ascend
+  lexicographically. Ancestors that are not listed are created as
+  directories, as with FT_insertDir and FT_insertFile.
+
+  Returns SUCCESS if the whole manifest was inserted. Otherwise, the
+  FT is left empty and the status is:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * ALREADY_IN_TREE if the FT is not empty, or if a path repeats an
+                    earlier path or one of its ancestors
+  * BAD_PATH if a path is not well-formatted or is out of order
+  * CONFLICTING_PATH if the paths do not share a root,
+                     or if a file would be the FT root
+  * NOT_A_DIRECTORY if a proper prefix of a path is listed as a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_buildFromSorted(const char **ppcPaths, const nodeType *peTypes,
+                       void **ppvContents, const size_t *pulLengths,
+                       size_t ulNum);
+
 /*
   Returns a string representation of the
   data structure, or NULL if the structure is
@@ -144,9 +416,340 @@ int FT_destroy(void);
   before directories at any given level, and nodes
   of the same type ordered lexicographically.
 
+  Each directory caches its own lines of the representation, and
+  only directories whose children changed since the last call are
+  rebuilt, so repeated calls on a mostly unchanged FT cost little
+  more than copying the result. In thread-safe builds, a large
+  result is copied by several threads at once.
+
   Allocates memory for the returned string,
   which is then owned by client!
 */
 char *FT_toString(void);
 
+/*
+  Returns a string representation of the part of the data structure
+  rooted at pcPath, in the same format as FT_toString: pcPath itself,
+  then (if it is a directory) the nodes below it, down to ulMaxDepth
+  levels below pcPath, or all of them if ulMaxDepth is 0. pcPath is
+  resolved once and only that part of the hierarchy is visited, so
+  the cost grows with the size of the result, not of the FT.
+
+  Returns NULL if the structure is not initialized, pcPath is not a
+  well-formatted path or does not exist in the hierarchy, or there is
+  an allocation error.
+
+  Allocates memory for the returned string,
+  which is then owned by client!
+*/
+char *FT_toStringAt(const char *pcPath, size_t ulMaxDepth);
+
+/* The most bytes FT_writeTo passes to its sink in one call */
+enum { FT_CHUNK_SIZE = 4096 };
+
+/*
+  A sink for FT_writeTo: consumes the ulLength bytes at pcChunk (which
+  are not '\0'-terminated), given the pvExtra that was passed to
+  FT_writeTo. Returns SUCCESS to continue the listing, or any other
+  status to stop it.
+*/
+typedef int (*FT_Sink)(const char *pcChunk, size_t ulLength,
+                       void *pvExtra);
+
+/*
+  Writes the same representation that FT_toString returns (without
+  the terminating '\0') to pfSink, in chunks of at most FT_CHUNK_SIZE
+  bytes, without materializing it: the memory used grows only with
+  the depth of the hierarchy. pfSink must not modify the FT.
+
+  Returns SUCCESS, or INITIALIZATION_ERROR if the structure is not
+  initialized, or the first other status pfSink returns, in which case
+  the listing is cut short.
+*/
+int FT_writeTo(FT_Sink pfSink, void *pvExtra);
+
+/*
+  Like FT_writeTo, but writes the representation to psFile, or to
+  file descriptor iFd, returning IO_ERROR if a write fails.
+*/
+int FT_writeToFile(FILE *psFile);
+int FT_writeToFd(int iFd);
+
+/* An FT_Iter_T is a cursor over the nodes of part of a File Tree */
+typedef struct ftIter *FT_Iter_T;
+
+/* A node of a File Tree, as reported by FT_iterNext */
+struct ftEntry {
+    /* the node's absolute path */
+    const char *pcPath;
+    /* the node's type, either IS_DIRECTORY or IS_FILE */
+    nodeType type;
+    /* the size in bytes of a file's contents; 0 for a directory */
+    size_t ulSize;
+};
+
+/*
+  Begins an iteration over the node with absolute path pcPath and
+  everything under it, or over the whole hierarchy if pcPath is NULL,
+  in the same order as FT_toString. Returns SUCCESS and sets *poIter
+  to the new iterator, to be freed with FT_iterEnd. Otherwise, sets
+  *poIter to NULL and returns status:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if no node with pcPath exists in the hierarchy
+  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  The iterator keeps one small frame per level of the hierarchy it is
+  currently inside, and allocates nothing else. Unless built with
+  FT_THREADSAFE, the FT must not be modified while it is in use. In
+  thread-safe builds it reports each directory as it was when the
+  iterator entered it, and it must be used and ended by the thread
+  that began it; nothing removed from the FT meanwhile is freed until
+  it ends.
+*/
+int FT_iterBegin(const char *pcPath, FT_Iter_T *poIter);
+
+/*
+  Advances oIter. Returns SUCCESS and fills in *psEntry with the next
+  node, whose pcPath remains valid until FT_iterEnd, or returns
+  NO_SUCH_PATH if every node has been reported, or MEMORY_ERROR if
+  the iterator could not grow to descend another level.
+*/
+int FT_iterNext(FT_Iter_T oIter, struct ftEntry *psEntry);
+
+/* Ends the iteration oIter and frees it. */
+void FT_iterEnd(FT_Iter_T oIter);
+
+/*
+  Lists one page of the children of the directory with absolute path
+  pcPath: up to ulLimit of them, in lexicographic order of their names
+  (files and directories together), beginning after the child named
+  pcStartAfter, or with the first child if pcStartAfter is NULL. To
+  continue a listing, pass the name (final path component) of the
+  last entry of the previous page; it need not still exist. Seeking
+  to it is a binary search, so a page costs O(log n + ulLimit) for a
+  directory with n children.
+
+  Returns SUCCESS, sets *pulCount to the number of entries listed
+  (fewer than ulLimit only at the end of the directory), and sets
+  *ppsEntries to an array of them, allocated together with the paths
+  they point to as a single block that the caller owns and must free,
+  or to NULL if there are none. Otherwise, sets *ppsEntries to NULL
+  and *pulCount to 0 and returns status:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if no node with pcPath exists in the hierarchy
+  * NOT_A_DIRECTORY if pcPath is a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_readdir(const char *pcPath, const char *pcStartAfter,
+               size_t ulLimit, struct ftEntry **ppsEntries,
+               size_t *pulCount);
+
+/*
+  Looks up the entry with 0-based index ulRank in the order FT_toString
+  lists the nodes, without building the listing. Returns SUCCESS and
+  sets *ppsEntry to a description of it, allocated together with its
+  path as a single block that the caller owns and must free.
+  Otherwise, sets *ppsEntry to NULL and returns status:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * NO_SUCH_PATH if the FT has no more than ulRank nodes
+  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  Each directory caches its children in listing order with the sizes
+  of their subtrees, brought up to date as FT_toString does, so a
+  lookup after a small change takes O(d log n) time for depth d and
+  n children per directory.
+*/
+int FT_entryAt(size_t ulRank, struct ftEntry **ppsEntry);
+
+/*
+  Stores in *pulRank the 0-based index of the node with absolute path
+  pcPath in the order FT_toString lists the nodes, in the same time as
+  FT_entryAt, and returns SUCCESS. Otherwise returns status:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if no node with pcPath exists in the hierarchy
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_rankOf(const char *pcPath, size_t *pulRank);
+
+/* The most components a FT_glob pattern may have */
+enum { FT_GLOB_MAX_SEGMENTS = 31 };
+
+/*
+  A visitor for FT_glob and the find functions: is given each matching
+  node as *psEntry, whose pcPath is valid only during the call, and
+  the pvExtra that was passed to the query. Returns SUCCESS to
+  continue the query, or any other status to stop it.
+*/
+typedef int (*FT_Visitor)(const struct ftEntry *psEntry, void *pvExtra);
+
+/*
+  Calls pfVisit for every node whose absolute path matches pcPattern,
+  in the order FT_toString lists them. pcPattern is a path whose
+  components may contain wildcards: '*' matches any run of characters
+  within a component and '?' any single character, and a component
+  that is exactly "**" matches zero or more whole components. Other
+  characters match themselves.
+
+  The pattern is compiled once and only branches that can still match
+  are visited: a literal component is found by binary search, and one
+  with wildcards scans only the children that share its literal
+  prefix, so the cost grows with the number of matches and branch
+  points rather than with the size of the FT. (Below a "**", every
+  node must be visited.) pfVisit must not modify the FT.
+
+  Returns SUCCESS, or the first other status pfVisit returns, which
+  stops the query, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPattern is not well-formatted as a path or has more
+             than FT_GLOB_MAX_SEGMENTS components
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_glob(const char *pcPattern, FT_Visitor pfVisit,
+            void *pvExtra);
+
+/*
+  Turns the name index on, if bEnabled is TRUE, or off. The index maps
+  each final path component, and each file's extension, to the nodes
+  carrying it, and is kept up to date by every change to the FT until
+  it is turned off or the FT is destroyed. It costs a few words per
+  node, and building it visits every node once.
+
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if the index could not be built, in which case the
+                 FT has none
+  Should a later change find no memory to update the index, the index
+  is turned off; the find functions then still work, but by walking
+  the whole FT.
+*/
+int FT_setNameIndex(boolean bEnabled);
+
+/*
+  Calls pfVisit for every node whose final path component is pcName,
+  such as every node named "config.yaml". With the name index, this
+  takes time proportional to the number of matches, and the nodes are
+  reported in no particular order; without it, every node is visited
+  and they are reported in the order FT_toString lists them. pfVisit
+  must not modify the FT.
+
+  Returns SUCCESS, or the first other status pfVisit returns, which
+  stops the query, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcName is empty or contains '/'
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_findByName(const char *pcName, FT_Visitor pfVisit, void *pvExtra);
+
+/*
+  Like FT_findByName, but reports every file with extension
+  pcExtension, which may be given with or without its leading '.'. A
+  file's extension is the text after the last '.' in its final path
+  component; a name that begins with its only '.', or ends with '.',
+  has none, and directories never do.
+*/
+int FT_findByExtension(const char *pcExtension, FT_Visitor pfVisit,
+                       void *pvExtra);
+
+/*
+  Returns a new File Tree handle, already in an initialized (empty)
+  state, or NULL if memory could not be allocated.
+*/
+FT_T FT_new(void);
+
+/*
+  Destroys oFT, if it is initialized, and frees the handle itself.
+*/
+void FT_free(FT_T oFT);
+
+/*
+  The functions below behave exactly like their handle-less
+  counterparts above, but operate on oFT instead of the default FT.
+  Distinct handles share no state, so each may be used by a different
+  thread without coordination.
+
+  When built with FT_THREADSAFE defined, a single FT_T (including the
+  default FT) may also be shared between threads. The contains, stat,
+  getFileContents, getFileContent, readAt, writeTo, readdir, glob, and
+  iterator functions take no locks and never block: they read an
+  RCU-published tree whose removed nodes, and released contents, are
+  freed only after concurrent readers finish. (The exception is a
+  file FT_writeAt changes in place: getFileContent and readAt read it
+  holding its directory's lock, which writeAt also takes.)
+  toString, toStringAt, entryAt, and rankOf read it the same way, but
+  run one at a time per FT because they share its cached listings.
+  (Listings show each directory as it was at some moment during the
+  call, and nothing removed meanwhile is freed until a writeTo sink or
+  an iterator is done.) The functions that modify the FT lock only the
+  directory they change, so writers working in different directories
+  proceed in parallel; init, destroy, and buildFromSorted, and changes
+  to the root itself, run one at a time. With a name index, they also
+  update it briefly under a lock of its own, which setNameIndex and
+  the find functions hold while they run.
+*/
+int FT_insertDirIn(FT_T oFT, const char *pcPath);
+boolean FT_containsDirIn(FT_T oFT, const char *pcPath);
+int FT_rmDirIn(FT_T oFT, const char *pcPath);
+int FT_insertFileIn(FT_T oFT, const char *pcPath, void *pvContents,
+                    size_t ulLength);
+boolean FT_containsFileIn(FT_T oFT, const char *pcPath);
+int FT_rmFileIn(FT_T oFT, const char *pcPath);
+void *FT_getFileContentsIn(FT_T oFT, const char *pcPath);
+int FT_insertFileContentIn(FT_T oFT, const char *pcPath,
+                           Content_T oContent);
+int FT_insertFileMappedIn(FT_T oFT, const char *pcPath, int iFd,
+                          size_t ulOffset, size_t ulLength);
+int FT_getFileContentIn(FT_T oFT, const char *pcPath,
+                        Content_T *poContent);
+int FT_replaceFileContentIn(FT_T oFT, const char *pcPath,
+                            Content_T oNewContent);
+int FT_readAtIn(FT_T oFT, const char *pcPath, size_t ulOffset,
+                size_t ulLength, void *pvDest, size_t *pulRead);
+int FT_writeAtIn(FT_T oFT, const char *pcPath, size_t ulOffset,
+                 const void *pvData, size_t ulLength);
+int FT_appendFileIn(FT_T oFT, const char *pcPath, const void *pvData,
+                    size_t ulLength);
+int FT_cloneFileIn(FT_T oFT, const char *pcSrcPath,
+                   const char *pcDstPath);
+int FT_setChunkedContentsIn(FT_T oFT, boolean bEnabled);
+int FT_compressColdIn(FT_T oFT, size_t ulTarget, size_t *pulResident);
+int FT_setMemoryBudgetIn(FT_T oFT, size_t ulBudget);
+int FT_setContentStoreIn(FT_T oFT, boolean bEnabled);
+int FT_getContentStoreStatsIn(FT_T oFT,
+                              struct contentStoreStats *psStats);
+int FT_setInlineLimitIn(FT_T oFT, size_t ulLimit);
+void *FT_replaceFileContentsIn(FT_T oFT, const char *pcPath,
+                               void *pvNewContents,
+                               size_t ulNewLength);
+int FT_statIn(FT_T oFT, const char *pcPath, boolean *pbIsFile,
+              size_t *pulSize);
+int FT_initIn(FT_T oFT);
+int FT_buildFromSortedIn(FT_T oFT, const char **ppcPaths,
+                         const nodeType *peTypes, void **ppvContents,
+                         const size_t *pulLengths, size_t ulNum);
+int FT_destroyIn(FT_T oFT);
+char *FT_toStringIn(FT_T oFT);
+char *FT_toStringAtIn(FT_T oFT, const char *pcPath, size_t ulMaxDepth);
+int FT_writeToIn(FT_T oFT, FT_Sink pfSink, void *pvExtra);
+int FT_writeToFileIn(FT_T oFT, FILE *psFile);
+int FT_writeToFdIn(FT_T oFT, int iFd);
+int FT_iterBeginIn(FT_T oFT, const char *pcPath, FT_Iter_T *poIter);
+int FT_entryAtIn(FT_T oFT, size_t ulRank, struct ftEntry **ppsEntry);
+int FT_rankOfIn(FT_T oFT, const char *pcPath, size_t *pulRank);
+int FT_readdirIn(FT_T oFT, const char *pcPath, const char *pcStartAfter,
+                 size_t ulLimit, struct ftEntry **ppsEntries,
+                 size_t *pulCount);
+int FT_globIn(FT_T oFT, const char *pcPattern, FT_Visitor pfVisit,
+              void *pvExtra);
+int FT_setNameIndexIn(FT_T oFT, boolean bEnabled);
+int FT_findByNameIn(FT_T oFT, const char *pcName, FT_Visitor pfVisit,
+                    void *pvExtra);
+int FT_findByExtensionIn(FT_T oFT, const char *pcExtension,
+                         FT_Visitor pfVisit, void *pvExtra);
+
 #endif
@@ -0,0 +1,275 @@
+/*--------------------------------------------------------------------*/
+/* ft_bench.c                                                         */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+/* for clock_gettime and pthreads under a strict ISO C compilation */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ft.h"
+
+enum { NUM_DIRS = 64, FILES_PER_DIR = 256, PATH_LEN = 32 };
+enum { DEFAULT_MAX_THREADS = 8, DEFAULT_OPS = 200000 };
+
+/* The tree shared by every thread, and the paths of its files. */
+static FT_T oFTShared;
+static char acPaths[NUM_DIRS * FILES_PER_DIR][PATH_LEN];
+
+/* Set by the main thread to tell the writer thread to stop. */
+static int iStopWriter;
+
+/* The number of lookups each reader thread performs. */
+static size_t ulOpsPerReader = DEFAULT_OPS;
+
+/*
+  Returns the current time in seconds, from a monotonic clock.
+*/
+static double Bench_now(void) {
+    struct timespec sTime;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &sTime);
+    return (double) sTime.tv_sec + (double) sTime.tv_nsec / 1e9;
+}
+
+/*
+  Performs ulOpsPerReader random lookups against oFTShared, cycling
+  through FT_containsFileIn, FT_statIn, and FT_getFileContentsIn.
+  pvSeed points to this thread's random seed, which is overwritten
+  with the number of lookups that failed. Returns NULL.
+*/
+static void *Bench_reader(void *pvSeed) {
+    unsigned long ulSeed = *(unsigned long *) pvSeed;
+    unsigned long ulMisses = 0;
+    size_t ulOp;
+    boolean bIsFile;
+    size_t ulSize;
+
+    for(ulOp = 0; ulOp < ulOpsPerReader; ulOp++) {
+        const char *pcPath;
+
+        ulSeed = ulSeed * 1103515245UL + 12345UL;
+        pcPath = acPaths[(ulSeed >> 8) % (NUM_DIRS * FILES_PER_DIR)];
+
+        switch(ulOp % 3) {
+        case 0:
+            if(!FT_containsFileIn(oFTShared, pcPath))
+                ulMisses++;
+            break;
+        case 1:
+            if(FT_statIn(oFTShared, pcPath, &bIsFile, &ulSize)
+               != SUCCESS)
+                ulMisses++;
+            break;
+        default:
+            if(FT_getFileContentsIn(oFTShared, pcPath) == NULL)
+                ulMisses++;
+            break;
+        }
+    }
+
+    *(unsigned long *) pvSeed = ulMisses;
+    return NULL;
+}
+
+/*
+  Until iStopWriter is set, repeatedly replaces the contents of files
+  in oFTShared and inserts and removes a scratch file next to them, so
+  that readers race with changes to the directories they search.
+  pvCount points to a counter of the updates made. Returns NULL.
+*/
+static void *Bench_writer(void *pvCount) {
+    static char acContents[] = "updated";
+    char acScratch[PATH_LEN];
+    size_t *pulCount = pvCount;
+    size_t ulNext = 0;
+
+    while(!__atomic_load_n(&iStopWriter, __ATOMIC_ACQUIRE)) {
+        (void) FT_replaceFileContentsIn(oFTShared, acPaths[ulNext],
+                                        acContents, sizeof(acContents));
+        sprintf(acScratch, "bench/d%02lu/scratch",
+                (unsigned long) (ulNext / FILES_PER_DIR));
+        (void) FT_insertFileIn(oFTShared, acScratch, acContents,
+                               sizeof(acContents));
+        (void) FT_rmFileIn(oFTShared, acScratch);
+        ulNext = (ulNext + 1) % (NUM_DIRS * FILES_PER_DIR);
+        (*pulCount)++;
+    }
+
+    return NULL;
+}
+
+/*
+  Inserts and then removes ulOpsPerReader / 2 files in bench/wNN, a
+  directory of its own, where NN is the number pvIndex points to,
+  which is then overwritten with the number of operations that
+  failed. Returns NULL.
+*/
+static void *Bench_inserter(void *pvIndex) {
+    unsigned long ulIndex = *(unsigned long *) pvIndex;
+    unsigned long ulFailures = 0;
+    char acPath[PATH_LEN];
+    size_t ulOp;
+
+    for(ulOp = 0; ulOp < ulOpsPerReader / 2; ulOp++) {
+        sprintf(acPath, "bench/w%02lu/f%06lu", ulIndex,
+                (unsigned long) ulOp);
+        if(FT_insertFileIn(oFTShared, acPath, acPaths[0], PATH_LEN)
+           != SUCCESS)
+            ulFailures++;
+    }
+    for(ulOp = 0; ulOp < ulOpsPerReader / 2; ulOp++) {
+        sprintf(acPath, "bench/w%02lu/f%06lu", ulIndex,
+                (unsigned long) ulOp);
+        if(FT_rmFileIn(oFTShared, acPath) != SUCCESS)
+            ulFailures++;
+    }
+
+    *(unsigned long *) pvIndex = ulFailures;
+    return NULL;
+}
+
+/*
+  Runs one round of the benchmark with ulThreads writer threads, each
+  changing a directory of its own, and prints their throughput
+  relative to dBaseline. Returns the throughput in changes per second.
+*/
+static double Bench_writerRound(size_t ulThreads, double dBaseline) {
+    pthread_t *psWriters;
+    unsigned long *pulIndices;
+    unsigned long ulFailures = 0;
+    double dStart, dElapsed, dRate;
+    size_t i;
+
+    psWriters = calloc(ulThreads, sizeof(pthread_t));
+    pulIndices = calloc(ulThreads, sizeof(unsigned long));
+    assert(psWriters != NULL && pulIndices != NULL);
+
+    dStart = Bench_now();
+    for(i = 0; i < ulThreads; i++) {
+        pulIndices[i] = (unsigned long) i;
+        (void) pthread_create(&psWriters[i], NULL, Bench_inserter,
+                              &pulIndices[i]);
+    }
+    for(i = 0; i < ulThreads; i++) {
+        (void) pthread_join(psWriters[i], NULL);
+        ulFailures += pulIndices[i];
+    }
+    dElapsed = Bench_now() - dStart;
+
+    dRate = (double) (ulThreads * (ulOpsPerReader / 2) * 2) / dElapsed;
+    printf("%3lu writers: %12.0f changes/s  %6.2fx\n",
+           (unsigned long) ulThreads, dRate,
+           dBaseline > 0 ? dRate / dBaseline : 1.0);
+    if(ulFailures != 0)
+        printf("     %lu changes failed!\n", ulFailures);
+
+    free(psWriters);
+    free(pulIndices);
+    return dRate;
+}
+
+/*
+  Runs one round of the benchmark with ulThreads reader threads and
+  one writer thread, and prints the reader throughput relative to
+  dBaseline. Returns the throughput in lookups per second.
+*/
+static double Bench_round(size_t ulThreads, double dBaseline) {
+    pthread_t *psReaders;
+    unsigned long *pulSeeds;
+    pthread_t sWriter;
+    size_t ulWrites = 0;
+    unsigned long ulMisses = 0;
+    double dStart, dElapsed, dRate;
+    size_t i;
+
+    psReaders = calloc(ulThreads, sizeof(pthread_t));
+    pulSeeds = calloc(ulThreads, sizeof(unsigned long));
+    assert(psReaders != NULL && pulSeeds != NULL);
+
+    __atomic_store_n(&iStopWriter, 0, __ATOMIC_RELEASE);
+    (void) pthread_create(&sWriter, NULL, Bench_writer, &ulWrites);
+
+    dStart = Bench_now();
+    for(i = 0; i < ulThreads; i++) {
+        pulSeeds[i] = (unsigned long) i * 7919UL + 1UL;
+        (void) pthread_create(&psReaders[i], NULL, Bench_reader,
+                              &pulSeeds[i]);
+    }
+    for(i = 0; i < ulThreads; i++) {
+        (void) pthread_join(psReaders[i], NULL);
+        ulMisses += pulSeeds[i];
+    }
+    dElapsed = Bench_now() - dStart;
+
+    __atomic_store_n(&iStopWriter, 1, __ATOMIC_RELEASE);
+    (void) pthread_join(sWriter, NULL);
+
+    dRate = (double) (ulThreads * ulOpsPerReader) / dElapsed;
+    printf("%3lu readers: %12.0f lookups/s  %6.2fx  (%lu writes)\n",
+           (unsigned long) ulThreads, dRate,
+           dBaseline > 0 ? dRate / dBaseline : 1.0,
+           (unsigned long) ulWrites);
+    if(ulMisses != 0)
+        printf("     %lu lookups failed!\n", ulMisses);
+
+    free(psReaders);
+    free(pulSeeds);
+    return dRate;
+}
+
+/*
+  Measures FT lookup throughput with 1, 2, 4, ... up to argv[1]
+  (default 8) reader threads sharing one tree with a concurrent
+  writer, and then the throughput of as many writers working in
+  separate directories. argv[2], if given, is the number of lookups
+  per reader (and of changes per writer). Returns 0, or 1 if the tree
+  could not be built.
+*/
+int main(int argc, char *argv[]) {
+    size_t ulMaxThreads = DEFAULT_MAX_THREADS;
+    double dBaseline = 0;
+    size_t ulThreads;
+    size_t i;
+
+    if(argc > 1)
+        ulMaxThreads = (size_t) strtoul(argv[1], NULL, 10);
+    if(argc > 2)
+        ulOpsPerReader = (size_t) strtoul(argv[2], NULL, 10);
+
+    oFTShared = FT_new();
+    if(oFTShared == NULL)
+        return 1;
+    if(FT_insertDirIn(oFTShared, "bench") != SUCCESS)
+        return 1;
+
+    for(i = 0; i < NUM_DIRS * FILES_PER_DIR; i++) {
+        sprintf(acPaths[i], "bench/d%02lu/f%04lu",
+                (unsigned long) (i / FILES_PER_DIR),
+                (unsigned long) (i % FILES_PER_DIR));
+        if(FT_insertFileIn(oFTShared, acPaths[i], acPaths[i],
+                           PATH_LEN) != SUCCESS)
+            return 1;
+    }
+
+    for(ulThreads = 1; ulThreads <= ulMaxThreads; ulThreads *= 2) {
+        double dRate = Bench_round(ulThreads, dBaseline);
+        if(ulThreads == 1)
+            dBaseline = dRate;
+    }
+
+    dBaseline = 0;
+    for(ulThreads = 1; ulThreads <= ulMaxThreads; ulThreads *= 2) {
+        double dRate = Bench_writerRound(ulThreads, dBaseline);
+        if(ulThreads == 1)
+            dBaseline = dRate;
+    }
+
+    FT_free(oFTShared);
+    return 0;
+}
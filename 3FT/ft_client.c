@@ -3,6 +3,9 @@
 /* Author: Christopher Moretti                                        */
 /*--------------------------------------------------------------------*/
 
+/* for fileno under a strict ISO C compilation */
+#define _POSIX_C_SOURCE 200112L
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -10,6 +13,38 @@
 #include <string.h>
 #include "ft.h"
 
+/* The output collected by appendSink */
+struct sinkBuffer {
+  char acData[80];
+  size_t ulUsed;
+};
+
+/* An FT_Sink that appends the ulLength bytes at pcChunk to the
+   sinkBuffer pvBuffer. Returns SUCCESS, or MEMORY_ERROR once the
+   buffer is full. */
+static int appendSink(const char *pcChunk, size_t ulLength,
+                      void *pvBuffer) {
+  struct sinkBuffer *psBuffer = pvBuffer;
+
+  if(ulLength >= sizeof(psBuffer->acData) - psBuffer->ulUsed)
+    return MEMORY_ERROR;
+  memcpy(psBuffer->acData + psBuffer->ulUsed, pcChunk, ulLength);
+  psBuffer->ulUsed += ulLength;
+  psBuffer->acData[psBuffer->ulUsed] = '\0';
+  return SUCCESS;
+}
+
+/* An FT_Visitor that appends psEntry's path and a newline to the
+   sinkBuffer pvBuffer. Returns SUCCESS, or MEMORY_ERROR once the
+   buffer is full. */
+static int appendPath(const struct ftEntry *psEntry, void *pvBuffer) {
+  int iStatus = appendSink(psEntry->pcPath, strlen(psEntry->pcPath),
+                           pvBuffer);
+  if(iStatus != SUCCESS)
+    return iStatus;
+  return appendSink("\n", 1, pvBuffer);
+}
+
 /* Tests the FT implementation with an assortment of checks.
    Prints the status of the data structure along the way to stderr.
    Returns 0. */
@@ -241,5 +276,743 @@ int main(void) {
   assert(FT_containsFile("1root") == FALSE);
   assert((temp = FT_toString()) == NULL);
 
+  /* a sorted manifest builds the same tree as one-by-one insertion,
+     creating unlisted ancestors, and bad manifests leave it empty */
+  {
+    const char *apcPaths[] = {"1root", "1root/a/F", "1root/a/b",
+                              "1root/a/b/G", "1root/c"};
+    const nodeType aeTypes[] = {IS_DIRECTORY, IS_FILE, IS_DIRECTORY,
+                                IS_FILE, IS_DIRECTORY};
+    void *apvContents[] = {NULL, "Aho", NULL, "Weinberger", NULL};
+    size_t aulLengths[] = {0, 4, 0, 11, 0};
+    const char *apcBad[] = {"1root/x", "1root/b"};
+    const char *apcUnder[] = {"1root/a/F", "1root/a/F/G"};
+
+    assert(FT_buildFromSorted(apcPaths, aeTypes, apvContents,
+                              aulLengths, 5) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_buildFromSorted(apcBad, aeTypes, apvContents,
+                              aulLengths, 2) == BAD_PATH);
+    assert(FT_buildFromSorted(apcUnder, aeTypes + 1, apvContents,
+                              aulLengths, 2) == NOT_A_DIRECTORY);
+    assert((temp = FT_toString()) != NULL);
+    assert(!strcmp(temp, ""));
+    free(temp);
+    assert(FT_buildFromSorted(apcPaths + 1, aeTypes + 1,
+                              apvContents + 1, aulLengths + 1, 4)
+           == SUCCESS);
+    assert(FT_buildFromSorted(apcPaths, aeTypes, apvContents,
+                              aulLengths, 5) == ALREADY_IN_TREE);
+    assert(FT_containsDir("1root/a/b") == TRUE);
+    assert(!strcmp(FT_getFileContents("1root/a/b/G"), "Weinberger"));
+    assert(FT_insertFile("1root/a/E", "Kernighan",
+                         strlen("Kernighan")+1) == SUCCESS);
+    assert((temp = FT_toString()) != NULL);
+    assert(!strcmp(temp, "1root\n1root/a\n1root/a/E\n1root/a/F\n"
+                   "1root/a/b\n1root/a/b/G\n1root/c\n"));
+    free(temp);
+
+    /* the cached listing follows changes deep in the tree */
+    assert(FT_rmFile("1root/a/b/G") == SUCCESS);
+    assert(FT_insertFile("1root/c/H", NULL, 0) == SUCCESS);
+    assert((temp = FT_toString()) != NULL);
+    assert(!strcmp(temp, "1root\n1root/a\n1root/a/E\n1root/a/F\n"
+                   "1root/a/b\n1root/c\n1root/c/H\n"));
+    free(temp);
+    assert(FT_rmDir("1root/a") == SUCCESS);
+    assert((temp = FT_toString()) != NULL);
+    assert(!strcmp(temp, "1root\n1root/c\n1root/c/H\n"));
+    free(temp);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* writeTo streams the same listing as toString to a sink, stopping
+     at the sink's first failure */
+  {
+    struct sinkBuffer sBuffer;
+    FILE *psFile;
+
+    sBuffer.ulUsed = 0;
+    assert(FT_writeTo(appendSink, &sBuffer) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_writeTo(appendSink, &sBuffer) == SUCCESS);
+    assert(sBuffer.ulUsed == 0);
+    assert(FT_insertDir("1root/b") == SUCCESS);
+    assert(FT_insertFile("1root/b/f", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/a", NULL, 0) == SUCCESS);
+    assert(FT_writeTo(appendSink, &sBuffer) == SUCCESS);
+    assert(!strcmp(sBuffer.acData, "1root\n1root/a\n1root/b\n"
+                   "1root/b/f\n"));
+    assert(FT_writeTo(appendSink, &sBuffer) == SUCCESS);
+    assert(FT_writeTo(appendSink, &sBuffer) == MEMORY_ERROR);
+
+    assert((psFile = tmpfile()) != NULL);
+    assert(FT_writeToFile(psFile) == SUCCESS);
+    rewind(psFile);
+    assert(fread(arr, 1, ARRLEN, psFile) == strlen(sBuffer.acData) / 2);
+    fclose(psFile);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* an iterator visits a subtree in toString order */
+  {
+    FT_Iter_T oIter;
+    struct ftEntry sEntry;
+
+    assert(FT_iterBegin(NULL, &oIter) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_iterBegin(NULL, &oIter) == SUCCESS);
+    assert(FT_iterNext(oIter, &sEntry) == NO_SUCH_PATH);
+    FT_iterEnd(oIter);
+    assert(FT_insertDir("1root/b/c") == SUCCESS);
+    assert(FT_insertFile("1root/b/f", "Pike", strlen("Pike")+1)
+           == SUCCESS);
+    assert(FT_insertFile("1root/a", NULL, 0) == SUCCESS);
+    assert(FT_iterBegin("1root/b/f/g", &oIter) == NO_SUCH_PATH);
+    assert(oIter == NULL);
+
+    arr[0] = '\0';
+    assert(FT_iterBegin(NULL, &oIter) == SUCCESS);
+    while(FT_iterNext(oIter, &sEntry) == SUCCESS) {
+      strcat(arr, sEntry.pcPath);
+      strcat(arr, sEntry.type == IS_FILE ? "*" : "/");
+    }
+    FT_iterEnd(oIter);
+    assert(!strcmp(arr, "1root/1root/a*1root/b/1root/b/f*1root/b/c/"));
+
+    assert(FT_iterBegin("1root/b/f", &oIter) == SUCCESS);
+    assert(FT_iterNext(oIter, &sEntry) == SUCCESS);
+    assert(!strcmp(sEntry.pcPath, "1root/b/f"));
+    assert(sEntry.type == IS_FILE && sEntry.ulSize == 5);
+    assert(FT_iterNext(oIter, &sEntry) == NO_SUCH_PATH);
+    FT_iterEnd(oIter);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* toStringAt lists one subtree, optionally only its top levels */
+  assert(FT_toStringAt("1root", 0) == NULL);
+  assert(FT_init() == SUCCESS);
+  assert(FT_insertDir("1root/a/b") == SUCCESS);
+  assert(FT_insertFile("1root/a/b/F", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/a/E", NULL, 0) == SUCCESS);
+  assert(FT_insertDir("1root/c") == SUCCESS);
+  assert(FT_toStringAt("1root/x", 0) == NULL);
+  assert(FT_toStringAt("1root/a/", 0) == NULL);
+  assert((temp = FT_toStringAt("1root/a", 0)) != NULL);
+  assert(!strcmp(temp, "1root/a\n1root/a/E\n1root/a/b\n"
+                 "1root/a/b/F\n"));
+  free(temp);
+  assert((temp = FT_toStringAt("1root", 1)) != NULL);
+  assert(!strcmp(temp, "1root\n1root/a\n1root/c\n"));
+  free(temp);
+  assert((temp = FT_toStringAt("1root", 2)) != NULL);
+  assert(!strcmp(temp, "1root\n1root/a\n1root/a/E\n1root/a/b\n"
+                 "1root/c\n"));
+  free(temp);
+  assert((temp = FT_toStringAt("1root/a/E", 3)) != NULL);
+  assert(!strcmp(temp, "1root/a/E\n"));
+  free(temp);
+  /* a depth-limited listing leaves the parts it does not show to be
+     refreshed by the next full one */
+  assert(FT_insertFile("1root/a/b/G", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/c/H", NULL, 0) == SUCCESS);
+  assert((temp = FT_toStringAt("1root", 1)) != NULL);
+  assert(!strcmp(temp, "1root\n1root/a\n1root/c\n"));
+  free(temp);
+  assert((temp = FT_toStringAt("1root", 2)) != NULL);
+  assert(!strcmp(temp, "1root\n1root/a\n1root/a/E\n1root/a/b\n"
+                 "1root/c\n1root/c/H\n"));
+  free(temp);
+  assert((temp = FT_toString()) != NULL);
+  assert(!strcmp(temp, "1root\n1root/a\n1root/a/E\n1root/a/b\n"
+                 "1root/a/b/F\n1root/a/b/G\n1root/c\n1root/c/H\n"));
+  free(temp);
+  assert(FT_destroy() == SUCCESS);
+
+  /* glob reports matching paths in toString order */
+  {
+    struct sinkBuffer sBuffer;
+
+    assert(FT_glob("1root/*", appendPath, &sBuffer)
+           == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root/b1/logs") == SUCCESS);
+    assert(FT_insertFile("1root/b1/logs/a.txt", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/b1/logs/b.log", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/b2/logs/c.txt", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/b2/M", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/M", NULL, 0) == SUCCESS);
+    assert(FT_glob("1root//M", appendPath, &sBuffer) == BAD_PATH);
+
+    sBuffer.ulUsed = 0;
+    assert(FT_glob("1root/b?/logs/*.txt", appendPath, &sBuffer)
+           == SUCCESS);
+    assert(!strcmp(sBuffer.acData, "1root/b1/logs/a.txt\n"
+                   "1root/b2/logs/c.txt\n"));
+    sBuffer.ulUsed = 0;
+    assert(FT_glob("**/M", appendPath, &sBuffer) == SUCCESS);
+    assert(!strcmp(sBuffer.acData, "1root/M\n1root/b2/M\n"));
+    sBuffer.ulUsed = 0;
+    sBuffer.acData[0] = '\0';
+    assert(FT_glob("1root/b1/x*", appendPath, &sBuffer) == SUCCESS);
+    assert(sBuffer.ulUsed == 0);
+    assert(FT_glob("**", appendPath, &sBuffer) == MEMORY_ERROR);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* entryAt and rankOf index into the toString order */
+  {
+    struct ftEntry *psEntry;
+    size_t ulRank;
+
+    assert(FT_entryAt(0, &psEntry) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_entryAt(0, &psEntry) == NO_SUCH_PATH);
+    assert(FT_insertDir("1root/a/b") == SUCCESS);
+    assert(FT_insertFile("1root/c", "Ritchie", strlen("Ritchie")+1)
+           == SUCCESS);
+    assert(FT_insertFile("1root/a/E", NULL, 0) == SUCCESS);
+    /* 1root, 1root/c, 1root/a, 1root/a/E, 1root/a/b */
+    assert(FT_entryAt(1, &psEntry) == SUCCESS);
+    assert(!strcmp(psEntry->pcPath, "1root/c"));
+    assert(psEntry->type == IS_FILE && psEntry->ulSize == 8);
+    free(psEntry);
+    assert(FT_entryAt(4, &psEntry) == SUCCESS);
+    assert(!strcmp(psEntry->pcPath, "1root/a/b"));
+    free(psEntry);
+    assert(FT_entryAt(5, &psEntry) == NO_SUCH_PATH);
+    assert(FT_rankOf("1root/a/E", &ulRank) == SUCCESS && ulRank == 3);
+    assert(FT_rankOf("1root/a/x", &ulRank) == NO_SUCH_PATH);
+    assert(FT_rmFile("1root/c") == SUCCESS);
+    assert(FT_rankOf("1root/a/E", &ulRank) == SUCCESS && ulRank == 2);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* readdir pages through one directory's children by name */
+  {
+    struct ftEntry *psEntries;
+    size_t ulCount;
+
+    assert(FT_readdir("1root", NULL, 2, &psEntries, &ulCount)
+           == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root/c/d") == SUCCESS);
+    assert(FT_insertFile("1root/a", "Mashey", strlen("Mashey")+1)
+           == SUCCESS);
+    assert(FT_insertFile("1root/e", NULL, 0) == SUCCESS);
+    assert(FT_readdir("1root/a", NULL, 2, &psEntries, &ulCount)
+           == NOT_A_DIRECTORY);
+    assert(psEntries == NULL && ulCount == 0);
+
+    assert(FT_readdir("1root", NULL, 2, &psEntries, &ulCount)
+           == SUCCESS);
+    assert(ulCount == 2);
+    assert(!strcmp(psEntries[0].pcPath, "1root/a"));
+    assert(psEntries[0].type == IS_FILE && psEntries[0].ulSize == 7);
+    assert(!strcmp(psEntries[1].pcPath, "1root/c"));
+    assert(psEntries[1].type == IS_DIRECTORY);
+    free(psEntries);
+
+    /* resume after "c", and after a name that is not there */
+    assert(FT_readdir("1root", "c", 2, &psEntries, &ulCount)
+           == SUCCESS);
+    assert(ulCount == 1 && !strcmp(psEntries[0].pcPath, "1root/e"));
+    free(psEntries);
+    assert(FT_readdir("1root", "b", 5, &psEntries, &ulCount)
+           == SUCCESS);
+    assert(ulCount == 2 && !strcmp(psEntries[0].pcPath, "1root/c"));
+    free(psEntries);
+    assert(FT_readdir("1root", "e", 2, &psEntries, &ulCount)
+           == SUCCESS);
+    assert(psEntries == NULL && ulCount == 0);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* findByName and findByExtension, with and without the index */
+  {
+    struct sinkBuffer sBuffer;
+
+    assert(FT_setNameIndex(TRUE) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root/x") == SUCCESS);
+    assert(FT_insertFile("1root/x/a.log", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/y/a.log", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/y/.log", NULL, 0) == SUCCESS);
+    sBuffer.ulUsed = 0;
+    assert(FT_findByName("a.log", appendPath, &sBuffer) == SUCCESS);
+    assert(!strcmp(sBuffer.acData, "1root/x/a.log\n1root/y/a.log\n"));
+    assert(FT_findByName("x/a.log", appendPath, &sBuffer)
+           == BAD_PATH);
+
+    assert(FT_setNameIndex(TRUE) == SUCCESS);
+    assert(FT_rmDir("1root/x") == SUCCESS);
+    assert(FT_insertDir("1root/z/y") == SUCCESS);
+    assert(FT_insertFile("1root/z/b.log", NULL, 0) == SUCCESS);
+    sBuffer.ulUsed = 0;
+    assert(FT_findByName("a.log", appendPath, &sBuffer) == SUCCESS);
+    assert(!strcmp(sBuffer.acData, "1root/y/a.log\n"));
+    sBuffer.ulUsed = 0;
+    assert(FT_findByName("y", appendPath, &sBuffer) == SUCCESS);
+    assert(sBuffer.ulUsed == strlen("1root/y\n1root/z/y\n"));
+    sBuffer.ulUsed = 0;
+    assert(FT_findByExtension(".log", appendPath, &sBuffer)
+           == SUCCESS);
+    assert(sBuffer.ulUsed == strlen("1root/y/a.log\n1root/z/b.log\n"));
+    assert(strstr(sBuffer.acData, "1root/z/b.log\n") != NULL);
+    assert(FT_setNameIndex(FALSE) == SUCCESS);
+    sBuffer.ulUsed = 0;
+    assert(FT_findByExtension("log", appendPath, &sBuffer) == SUCCESS);
+    assert(!strcmp(sBuffer.acData, "1root/y/a.log\n1root/z/b.log\n"));
+    assert(FT_setNameIndex(TRUE) == SUCCESS);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* owned contents are shared by reference, and leases outlive
+     replacement */
+  {
+    Content_T oContent, oLease, oLease2;
+
+    assert((oContent = Content_new("Kernighan", strlen("Kernighan")+1))
+           != NULL);
+    assert(FT_getFileContent("1root/a", &oLease)
+           == INITIALIZATION_ERROR);
+    assert(oLease == NULL);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_insertFileContent("1root/a", oContent) == SUCCESS);
+    assert(FT_insertFileContent("1root/b", oContent) == SUCCESS);
+    assert(FT_getFileContent("1root/a", &oLease) == SUCCESS);
+    assert(oLease == oContent);
+    assert(FT_getFileContents("1root/b") == Content_getData(oContent));
+    Content_release(oContent);
+
+    assert((oContent = Content_new("Pike", strlen("Pike")+1)) != NULL);
+    assert(FT_replaceFileContent("1root/a", oContent) == SUCCESS);
+    assert(FT_replaceFileContent("1root", oContent) == NOT_A_FILE);
+    Content_release(oContent);
+    assert(FT_rmFile("1root/b") == SUCCESS);
+    assert(!strcmp(Content_getData(oLease), "Kernighan"));
+    Content_release(oLease);
+    assert(FT_stat("1root/a", &bIsFile, &l) == SUCCESS && l == 5);
+
+    /* borrowed contents are copied into a lease */
+    assert(FT_replaceFileContents("1root/a", "Aho", strlen("Aho")+1)
+           == NULL);
+    assert(FT_getFileContent("1root/a", &oLease2) == SUCCESS);
+    assert(!strcmp(Content_getData(oLease2), "Aho"));
+    assert(Content_getLength(oLease2) == 4);
+    Content_release(oLease2);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* readAt and writeAt touch only the bytes asked for */
+  {
+    Content_T oLease;
+    char acBuf[16];
+    size_t ulRead;
+
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_insertFile("1root/a", "Thompson", strlen("Thompson"))
+           == SUCCESS);
+    assert(FT_readAt("1root", 0, 4, acBuf, &ulRead) == NOT_A_FILE);
+    assert(FT_readAt("1root/a", 2, 4, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 4 && !strncmp(acBuf, "omps", 4));
+    assert(FT_readAt("1root/a", 6, 16, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 2 && !strncmp(acBuf, "on", 2));
+    assert(FT_readAt("1root/a", 9, 1, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 0);
+
+    assert(FT_writeAt("1root/a", 0, "Tim", 3) == SUCCESS);
+    assert(FT_getFileContent("1root/a", &oLease) == SUCCESS);
+    assert(FT_writeAt("1root/a", 10, "!", 2) == SUCCESS);
+    assert(FT_stat("1root/a", &bIsFile, &l) == SUCCESS && l == 12);
+    assert(FT_readAt("1root/a", 0, 16, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 12 && !memcmp(acBuf, "Timmpson\0\0!", 12));
+    /* the lease kept the contents as they were */
+    assert(Content_getLength(oLease) == 8);
+    assert(!strncmp(Content_getData(oLease), "Timmpson", 8));
+    Content_release(oLease);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* chunked files are sparse, and a lease shares their chunks */
+  {
+    Content_T oLease;
+    char acBuf[16];
+    size_t ulRead;
+
+    assert(FT_setChunkedContents(TRUE) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_setChunkedContents(TRUE) == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_insertFile("1root/a", "Thompson", strlen("Thompson"))
+           == SUCCESS);
+    /* across a chunk boundary, far past the end */
+    assert(FT_writeAt("1root/a", 1000000 - 2, "Ritchie", 7) == SUCCESS);
+    assert(FT_stat("1root/a", &bIsFile, &l) == SUCCESS && l == 1000005);
+    assert(FT_getFileContents("1root/a") == NULL);
+    assert(FT_readAt("1root/a", 6, 4, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 4 && !memcmp(acBuf, "on\0\0", 4));
+    assert(FT_readAt("1root/a", 1000000 - 2, 16, acBuf, &ulRead)
+           == SUCCESS);
+    assert(ulRead == 7 && !memcmp(acBuf, "Ritchie", 7));
+
+    assert(FT_getFileContent("1root/a", &oLease) == SUCCESS);
+    assert(Content_isChunked(oLease));
+    assert(FT_writeAt("1root/a", 0, "Tim", 3) == SUCCESS);
+    assert(Content_read(oLease, 0, 3, acBuf) == 3);
+    assert(!memcmp(acBuf, "Tho", 3));
+    assert(FT_readAt("1root/a", 0, 4, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 4 && !memcmp(acBuf, "Timm", 4));
+    Content_release(oLease);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* the content store keeps one copy of equal contents */
+  {
+    struct contentStoreStats sStats;
+    Content_T oContent;
+    char acBytes[] = "Kernighan";
+
+    assert(FT_setContentStore(TRUE) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_setContentStore(TRUE) == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_insertFile("1root/a", acBytes, 9) == SUCCESS);
+    assert(FT_insertFile("1root/b", "Kernighan", 9) == SUCCESS);
+    assert(FT_insertFile("1root/c", "Pike", 4) == SUCCESS);
+    /* the bytes were copied, not borrowed */
+    strcpy(acBytes, "Ritchie");
+    assert(FT_getFileContents("1root/a") ==
+           FT_getFileContents("1root/b"));
+    assert(!strncmp(FT_getFileContents("1root/a"), "Kernighan", 9));
+    assert((oContent = Content_new("Pike", 4)) != NULL);
+    assert(FT_insertFileContent("1root/d", oContent) == SUCCESS);
+    Content_release(oContent);
+    assert(FT_getFileContents("1root/c") ==
+           FT_getFileContents("1root/d"));
+
+    assert(FT_getContentStoreStats(&sStats) == SUCCESS);
+    assert(sStats.ulContents == 2 && sStats.ulStoredBytes == 13);
+    assert(sStats.ulReferences == 4 && sStats.ulReferencedBytes == 26);
+    assert(FT_rmFile("1root/c") == SUCCESS);
+    assert(FT_replaceFileContents("1root/d", "Kernighan", 9) == NULL);
+    /* removed contents may be freed later in thread-safe builds */
+    assert(FT_getContentStoreStats(&sStats) == SUCCESS);
+    assert(sStats.ulContents >= 1 && sStats.ulReferences >= 3);
+
+    /* turning it off keeps existing files shared */
+    assert(FT_setContentStore(FALSE) == SUCCESS);
+    assert(FT_getContentStoreStats(&sStats) == SUCCESS);
+    assert(sStats.ulContents == 0);
+    assert(FT_insertFile("1root/e", acBytes, 7) == SUCCESS);
+    assert(FT_getFileContents("1root/e") == acBytes);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* cold contents are compressed, and decompressed when used */
+  {
+    Content_T oContent;
+    char acText[4096];
+    char acBuf[8];
+    size_t ulResident, ulColder, ulRead, i;
+
+    for(i = 0; i < sizeof(acText); i++)
+      acText[i] = "Thompson and Ritchie\n"[i % 21];
+
+    assert(FT_compressCold(0, NULL) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert((oContent = Content_new(acText, sizeof(acText))) != NULL);
+    assert(FT_insertFileContent("1root/a", oContent) == SUCCESS);
+    Content_release(oContent);
+    assert((oContent = Content_new(acText, sizeof(acText))) != NULL);
+    assert(FT_insertFileContent("1root/b", oContent) == SUCCESS);
+    Content_release(oContent);
+    assert(FT_insertFile("1root/c", acText, sizeof(acText)) == SUCCESS);
+
+    /* new contents count as used, so the first sweep keeps them */
+    assert(FT_compressCold((size_t) -1, &ulResident) == SUCCESS);
+    assert(ulResident >= 2 * sizeof(acText));
+    assert(FT_readAt("1root/b", 0, 4, acBuf, &ulRead) == SUCCESS);
+    assert(FT_compressCold((size_t) -1, &ulColder) == SUCCESS);
+    assert(ulColder < ulResident - sizeof(acText) / 2);
+    assert(FT_stat("1root/a", &bIsFile, &l) == SUCCESS &&
+           l == sizeof(acText));
+    assert(!memcmp(FT_getFileContents("1root/a"), acText,
+                   sizeof(acText)));
+
+    /* a target compresses contents in use too */
+    assert(FT_compressCold(0, &ulResident) == SUCCESS);
+    assert(ulResident < sizeof(acText));
+    assert(FT_getFileContents("1root/c") == acText);
+    assert(FT_readAt("1root/a", 21, 8, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 8 && !memcmp(acBuf, "Thompson", 8));
+    assert(FT_writeAt("1root/b", 0, "Kernighan", 9) == SUCCESS);
+    assert(FT_readAt("1root/b", 8, 8, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 8 && !memcmp(acBuf, "nand Rit", 8));
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* mapped contents are read from the host file in place */
+  {
+    FILE *psFile;
+    char acBuf[8];
+    size_t ulRead, i;
+
+    assert((psFile = tmpfile()) != NULL);
+    for(i = 0; i < 5000; i++)
+      assert(fputs("Thompson", psFile) >= 0);
+    assert(fflush(psFile) == 0);
+
+    assert(FT_insertFileMapped("1root/a", fileno(psFile), 0, 8) ==
+           INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    /* an offset need not be on a page boundary */
+    assert(FT_insertFileMapped("1root/a", fileno(psFile), 39997, 3) ==
+           SUCCESS);
+    assert(FT_insertFileMapped("1root/b", fileno(psFile), 0, 40000) ==
+           SUCCESS);
+    assert(FT_insertFileMapped("1root/c", -1, 0, 8) == IO_ERROR);
+    /* nor may the bytes extend past the host file's end */
+    assert(FT_insertFileMapped("1root/c", fileno(psFile), 39997, 4) ==
+           IO_ERROR);
+    assert(FT_insertFileMapped("1root/c", fileno(psFile), 40001, 1) ==
+           IO_ERROR);
+    assert(FT_containsFile("1root/c") == FALSE);
+    fclose(psFile);
+
+    assert(!strncmp(FT_getFileContents("1root/a"), "son", 3));
+    assert(FT_stat("1root/b", &bIsFile, &l) == SUCCESS && l == 40000);
+    assert(FT_readAt("1root/b", 39992, 16, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 8 && !strncmp(acBuf, "Thompson", 8));
+    /* writing copies the contents out of the mapping */
+    assert(FT_writeAt("1root/a", 0, "n", 1) == SUCCESS);
+    assert(!strncmp(FT_getFileContents("1root/a"), "non", 3));
+    assert(FT_rmFile("1root/b") == SUCCESS);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* appends go at the end, however the file got there */
+  {
+    char acBuf[8];
+    size_t ulRead, i;
+
+    assert(FT_appendFile("1root/a", "x", 1) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_appendFile("1root/a", "x", 1) == NO_SUCH_PATH);
+    assert(FT_appendFile("1root", "x", 1) == NOT_A_FILE);
+    assert(FT_insertFile("1root/a", "Thompson", strlen("Thompson"))
+           == SUCCESS);
+    for(i = 0; i < 10000; i++)
+      assert(FT_appendFile("1root/a", "Ritchie", 7) == SUCCESS);
+    assert(FT_appendFile("1root/a", NULL, 0) == SUCCESS);
+    assert(FT_stat("1root/a", &bIsFile, &l) == SUCCESS &&
+           l == 8 + 7 * 10000);
+    assert(FT_readAt("1root/a", 4, 8, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 8 && !memcmp(acBuf, "psonRitc", 8));
+    assert(FT_readAt("1root/a", l - 7, 8, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 7 && !memcmp(acBuf, "Ritchie", 7));
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* small contents are copied into the file's node */
+  {
+    char acSmall[] = "Thompson";
+    char acBig[] = "Kernighan and Ritchie";
+
+    assert(FT_setInlineLimit(16) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_setInlineLimit(16) == SUCCESS);
+    assert(FT_insertFile("1root/a", acSmall, 8) == SUCCESS);
+    assert(FT_insertFile("1root/b", acBig, strlen(acBig)) == SUCCESS);
+    assert(FT_insertFile("1root/c", NULL, 0) == SUCCESS);
+    acSmall[0] = 't';
+    assert(FT_getFileContents("1root/a") != acSmall);
+    assert(!strncmp(FT_getFileContents("1root/a"), "Thompson", 8));
+    assert(FT_getFileContents("1root/b") == acBig);
+    assert(FT_getFileContents("1root/c") == NULL);
+    assert(FT_stat("1root/a", &bIsFile, &l) == SUCCESS && l == 8);
+    /* writes copy the contents out, as for borrowed ones */
+    assert(FT_writeAt("1root/a", 8, "!", 1) == SUCCESS);
+    assert(!strncmp(FT_getFileContents("1root/a"), "Thompson!", 9));
+    assert(FT_rmFile("1root/a") == SUCCESS);
+    assert(FT_insertFile("1root/a", acSmall, 8) == SUCCESS);
+    assert(FT_replaceFileContents("1root/a", acBig, 3) == NULL);
+    assert(FT_replaceFileContents("1root/a", NULL, 0) == acBig);
+    assert(FT_destroy() == SUCCESS);
+    /* destroying the FT resets the limit */
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_insertFile("1root/a", acSmall, 8) == SUCCESS);
+    assert(FT_getFileContents("1root/a") == acSmall);
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* clones share contents until either is written */
+  {
+    char acBuf[8];
+    size_t ulRead;
+
+    assert(FT_cloneFile("1root/a", "1root/b") == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root/d") == SUCCESS);
+    assert(FT_insertFile("1root/a", "Thompson", 8) == SUCCESS);
+    assert(FT_cloneFile("1root/x", "1root/b") == NO_SUCH_PATH);
+    assert(FT_cloneFile("1root/d", "1root/b") == NOT_A_FILE);
+    assert(FT_cloneFile("1root/a", "1root/d") == ALREADY_IN_TREE);
+    /* borrowed contents are borrowed by the clone too */
+    assert(FT_cloneFile("1root/a", "1root/d/b") == SUCCESS);
+    assert(FT_getFileContents("1root/d/b") ==
+           FT_getFileContents("1root/a"));
+    assert(FT_writeAt("1root/a", 0, "T", 1) == SUCCESS);
+    assert(FT_cloneFile("1root/a", "1root/c") == SUCCESS);
+    assert(FT_getFileContents("1root/c") ==
+           FT_getFileContents("1root/a"));
+    assert(FT_writeAt("1root/c", 0, "t", 1) == SUCCESS);
+    assert(FT_writeAt("1root/a", 8, "!", 1) == SUCCESS);
+    assert(!strncmp(FT_getFileContents("1root/a"), "Thompson!", 9));
+    assert(!strncmp(FT_getFileContents("1root/c"), "thompson", 8));
+    assert(FT_stat("1root/c", &bIsFile, &l) == SUCCESS && l == 8);
+    /* chunked contents keep sharing the chunks not written */
+    assert(FT_setChunkedContents(TRUE) == SUCCESS);
+    assert(FT_writeAt("1root/e", 0, "x", 1) == NO_SUCH_PATH);
+    assert(FT_insertFile("1root/e", NULL, 0) == SUCCESS);
+    assert(FT_writeAt("1root/e", 200000, "Ritchie", 7) == SUCCESS);
+    assert(FT_cloneFile("1root/e", "1root/f") == SUCCESS);
+    assert(FT_writeAt("1root/f", 200000, "r", 1) == SUCCESS);
+    assert(FT_readAt("1root/e", 200000, 8, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 7 && !memcmp(acBuf, "Ritchie", 7));
+    assert(FT_readAt("1root/f", 200000, 8, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 7 && !memcmp(acBuf, "ritchie", 7));
+    assert(FT_rmFile("1root/e") == SUCCESS);
+    assert(FT_readAt("1root/f", 0, 1, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 1 && acBuf[0] == '\0');
+    /* inline contents are copied into the clone's node */
+    assert(FT_setInlineLimit(16) == SUCCESS);
+    assert(FT_insertFile("1root/g", "Kernighan", 9) == SUCCESS);
+    assert(FT_cloneFile("1root/g", "1root/h") == SUCCESS);
+    assert(FT_rmFile("1root/g") == SUCCESS);
+    assert(!strncmp(FT_getFileContents("1root/h"), "Kernighan", 9));
+    assert(FT_destroy() == SUCCESS);
+  }
+
+  /* over budget, the least recently used contents are spilled */
+  {
+    enum {SPILL_LEN = 100000};
+    char *pcData;
+    char *pcContents;
+    char acBuf[8];
+    size_t ulRead;
+    Content_T oLease;
+
+    assert((pcData = malloc(SPILL_LEN)) != NULL);
+    memset(pcData, 'K', SPILL_LEN);
+    memcpy(pcData + SPILL_LEN - 8, "Thompson", 8);
+
+    assert(FT_setMemoryBudget(250000) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert(FT_insertFile("1root/a", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/b", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/c", NULL, 0) == SUCCESS);
+    assert(FT_insertFile("1root/d", NULL, 0) == SUCCESS);
+    assert(FT_writeAt("1root/a", 0, pcData, SPILL_LEN) == SUCCESS);
+    assert(FT_writeAt("1root/b", 0, pcData, SPILL_LEN) == SUCCESS);
+    assert(FT_writeAt("1root/c", 0, pcData, SPILL_LEN) == SUCCESS);
+    /* all were used, so one is spilled to fit */
+    assert(FT_setMemoryBudget(250000) == SUCCESS);
+    assert(FT_getFileContent("1root/a", &oLease) == SUCCESS);
+    assert(Content_isMapped(oLease));
+    Content_release(oLease);
+    /* b is now the least recently used */
+    assert(FT_writeAt("1root/d", 0, pcData, SPILL_LEN) == SUCCESS);
+    assert(FT_getFileContent("1root/b", &oLease) == SUCCESS);
+    assert(Content_isMapped(oLease));
+    Content_release(oLease);
+    assert(FT_getFileContent("1root/c", &oLease) == SUCCESS);
+    assert(!Content_isMapped(oLease));
+    Content_release(oLease);
+    assert(FT_stat("1root/b", &bIsFile, &l) == SUCCESS &&
+           l == SPILL_LEN);
+    assert(!memcmp(FT_getFileContents("1root/b"), pcData, SPILL_LEN));
+    /* writing copies the contents back into memory, which may spill
+       others */
+    assert(FT_writeAt("1root/b", 0, "k", 1) == SUCCESS);
+    assert(FT_readAt("1root/b", 0, 1, acBuf, &ulRead) == SUCCESS);
+    assert(ulRead == 1 && acBuf[0] == 'k');
+    assert(FT_readAt("1root/b", SPILL_LEN - 8, 8, acBuf, &ulRead)
+           == SUCCESS);
+    assert(ulRead == 8 && !memcmp(acBuf, "Thompson", 8));
+    /* spilled contents outlive the budget */
+    assert(FT_setMemoryBudget(0) == SUCCESS);
+    assert(!memcmp(FT_getFileContents("1root/a"), pcData, SPILL_LEN));
+    assert(FT_destroy() == SUCCESS);
+
+    /* contents whose bytes were handed out stay in memory, so the
+       pointer outlives sweeps set off by other files */
+    assert(FT_init() == SUCCESS);
+    assert(FT_insertDir("1root") == SUCCESS);
+    assert((oLease = Content_new(pcData, SPILL_LEN)) != NULL);
+    assert(FT_insertFileContent("1root/a", oLease) == SUCCESS);
+    Content_release(oLease);
+    pcContents = FT_getFileContents("1root/a");
+    assert(pcContents != NULL);
+    assert(FT_setMemoryBudget(150000) == SUCCESS);
+    assert(FT_insertFile("1root/b", NULL, 0) == SUCCESS);
+    assert(FT_writeAt("1root/b", 0, pcData, SPILL_LEN) == SUCCESS);
+    assert(!memcmp(pcContents, pcData, SPILL_LEN));
+    assert(FT_getFileContent("1root/a", &oLease) == SUCCESS);
+    assert(!Content_isMapped(oLease));
+    Content_release(oLease);
+    assert(FT_getFileContent("1root/b", &oLease) == SUCCESS);
+    assert(Content_isMapped(oLease));
+    Content_release(oLease);
+    /* until they are replaced */
+    assert((oLease = Content_new(pcData, SPILL_LEN)) != NULL);
+    assert(FT_replaceFileContent("1root/a", oLease) == SUCCESS);
+    Content_release(oLease);
+    assert(FT_setMemoryBudget(50000) == SUCCESS);
+    assert(FT_getFileContent("1root/a", &oLease) == SUCCESS);
+    assert(Content_isMapped(oLease));
+    Content_release(oLease);
+    assert(FT_destroy() == SUCCESS);
+    free(pcData);
+  }
+
+  /* separate handles are independent of each other and of the
+     default FT */
+  {
+    FT_T oFT1, oFT2;
+    FT_Iter_T oIter;
+    struct ftEntry sEntry;
+
+    assert((oFT1 = FT_new()) != NULL);
+    assert((oFT2 = FT_new()) != NULL);
+    assert(FT_initIn(oFT1) == INITIALIZATION_ERROR);
+    assert(FT_insertDirIn(oFT1, "1root/2child") == SUCCESS);
+    assert(FT_insertDirIn(oFT2, "1other") == SUCCESS);
+    assert(FT_containsDirIn(oFT1, "1root/2child") == TRUE);
+    assert(FT_containsDirIn(oFT2, "1root/2child") == FALSE);
+    assert(FT_containsDir("1root/2child") == FALSE);
+    assert((temp = FT_toStringIn(oFT2)) != NULL);
+    assert(!strcmp(temp, "1other\n"));
+    free(temp);
+    /* freeing one does not wait for an iteration over the other */
+    assert(FT_insertDirIn(oFT2, "1other/gone") == SUCCESS);
+    assert(FT_rmDirIn(oFT2, "1other/gone") == SUCCESS);
+    assert(FT_iterBeginIn(oFT1, NULL, &oIter) == SUCCESS);
+    FT_free(oFT2);
+    assert(FT_iterNext(oIter, &sEntry) == SUCCESS);
+    assert(!strcmp(sEntry.pcPath, "1root"));
+    FT_iterEnd(oIter);
+    assert(FT_destroyIn(oFT1) == SUCCESS);
+    FT_free(oFT1);
+  }
+
   return 0;
 }
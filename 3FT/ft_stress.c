@@ -0,0 +1,260 @@
+/*--------------------------------------------------------------------*/
+/* ft_stress.c                                                        */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+/* for pthreads under a strict ISO C compilation */
+#define _POSIX_C_SOURCE 200112L
+
+#include <assert.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ft.h"
+
+enum { NUM_WRITERS = 4, NUM_READERS = 4, FILES_PER_WRITER = 200,
+       ROUNDS = 500, PATH_LEN = 48 };
+enum { LIST_DIRS = 32, LIST_FILES = 8, LIST_DEPTH = 16 };
+
+/* The tree the threads share. */
+static FT_T oFTShared;
+
+/* The contents files are given; readers check they see only these. */
+static char acOld[] = "Thompson";
+static char acNew[] = "Ritchie";
+
+/* Set by the main thread once every writer has finished. */
+static int iWritersDone;
+
+/*
+  Builds in acPath, which has room for PATH_LEN bytes, the path of
+  file iFile of writer iWriter.
+*/
+static void Stress_filePath(char *acPath, int iWriter, int iFile) {
+    sprintf(acPath, "r/w%d/f%03d", iWriter, iFile);
+}
+
+/*
+  Applies to oFT the changes writer iWriter makes, leaving its
+  directory holding the files of even number, whose contents were
+  replaced with acNew, and an empty directory "keep". When bRepeat is
+  TRUE, subtrees that end up removed are first built and removed
+  ROUNDS times, so that readers meet them coming and going.
+*/
+static void Stress_write(FT_T oFT, int iWriter, boolean bRepeat) {
+    char acPath[PATH_LEN];
+    int iRound;
+    int i;
+
+    for(i = 0; i < FILES_PER_WRITER; i++) {
+        Stress_filePath(acPath, iWriter, i);
+        assert(FT_insertFileIn(oFT, acPath, acOld, sizeof(acOld))
+               == SUCCESS);
+    }
+    for(iRound = 0; iRound < (bRepeat ? ROUNDS : 1); iRound++) {
+        sprintf(acPath, "r/w%d/tmp/a/b", iWriter);
+        assert(FT_insertDirIn(oFT, acPath) == SUCCESS);
+        sprintf(acPath, "r/w%d/tmp/a/file", iWriter);
+        assert(FT_insertFileIn(oFT, acPath, acOld, sizeof(acOld))
+               == SUCCESS);
+        sprintf(acPath, "r/w%d/tmp", iWriter);
+        assert(FT_rmDirIn(oFT, acPath) == SUCCESS);
+    }
+    for(i = 0; i < FILES_PER_WRITER; i++) {
+        Stress_filePath(acPath, iWriter, i);
+        if(i % 2 != 0)
+            assert(FT_rmFileIn(oFT, acPath) == SUCCESS);
+        else
+            assert(FT_replaceFileContentsIn(oFT, acPath, acNew,
+                                            sizeof(acNew)) == acOld);
+    }
+    sprintf(acPath, "r/w%d/keep", iWriter);
+    assert(FT_insertDirIn(oFT, acPath) == SUCCESS);
+}
+
+/* Runs Stress_write for the writer whose number pvWriter points to. */
+static void *Stress_writer(void *pvWriter) {
+    Stress_write(oFTShared, *(int *) pvWriter, TRUE);
+    return NULL;
+}
+
+/*
+  Asserts that every line of pcListing is a path in "r", which a
+  listing copied to the wrong place or with gaps would not be.
+*/
+static void Stress_checkListing(const char *pcListing) {
+    assert(pcListing != NULL);
+
+    while(*pcListing != '\0') {
+        assert(!strncmp(pcListing, "r\n", 2) ||
+               !strncmp(pcListing, "r/", 2));
+        pcListing = strchr(pcListing, '\n');
+        assert(pcListing != NULL);
+        pcListing++;
+    }
+}
+
+/*
+  Reads oFTShared until the writers are done, checking that every
+  answer is one some moment of the writers' work could give. Returns
+  NULL.
+*/
+static void *Stress_reader(void *pvSeed) {
+    unsigned long ulSeed = *(unsigned long *) pvSeed;
+    char acPath[PATH_LEN];
+    char acBuf[sizeof(acOld)];
+    boolean bIsFile;
+    size_t ulSize;
+    char *pcContents;
+    char *pcListing;
+    Content_T oLease;
+
+    while(!__atomic_load_n(&iWritersDone, __ATOMIC_ACQUIRE)) {
+        ulSeed = ulSeed * 1103515245UL + 12345UL;
+        Stress_filePath(acPath, (int) ((ulSeed >> 8) % NUM_WRITERS),
+                        (int) ((ulSeed >> 16) % FILES_PER_WRITER));
+
+        pcContents = FT_getFileContentsIn(oFTShared, acPath);
+        assert(pcContents == NULL || pcContents == acOld ||
+               pcContents == acNew);
+        if(FT_statIn(oFTShared, acPath, &bIsFile, &ulSize) == SUCCESS)
+            assert(bIsFile && (ulSize == sizeof(acOld) ||
+                               ulSize == sizeof(acNew)));
+        /* the contents are replaced by ones of another length, so a
+           size loaded apart from them would show here */
+        if(FT_readAtIn(oFTShared, acPath, 0, sizeof(acBuf), acBuf,
+                       &ulSize) == SUCCESS)
+            assert((ulSize == sizeof(acOld) &&
+                    !memcmp(acBuf, acOld, sizeof(acOld))) ||
+                   (ulSize == sizeof(acNew) &&
+                    !memcmp(acBuf, acNew, sizeof(acNew))));
+        /* likewise for the copy a lease of borrowed contents makes */
+        if(FT_getFileContentIn(oFTShared, acPath, &oLease) == SUCCESS) {
+            ulSize = Content_getLength(oLease);
+            assert((ulSize == sizeof(acOld) &&
+                    !memcmp(Content_getData(oLease), acOld, ulSize)) ||
+                   (ulSize == sizeof(acNew) &&
+                    !memcmp(Content_getData(oLease), acNew, ulSize)));
+            Content_release(oLease);
+        }
+
+        if((ulSeed >> 24) % 64 == 0) {
+            pcListing = FT_toStringIn(oFTShared);
+            assert(pcListing != NULL);
+            assert(!strncmp(pcListing, "r\n", 2));
+            Stress_checkListing(pcListing);
+            free(pcListing);
+        }
+    }
+    return NULL;
+}
+
+/*
+  Checks that oFT's full listing, which a build with a lowered
+  FT_PARALLEL_MIN_LENGTH copies in parallel, matches the one copied
+  serially when a depth limit is given.
+*/
+static void Stress_compareListings(FT_T oFT) {
+    char *pcParallel;
+    char *pcSerial;
+
+    pcParallel = FT_toStringIn(oFT);
+    pcSerial = FT_toStringAtIn(oFT, "r", LIST_DEPTH);
+    assert(pcParallel != NULL && pcSerial != NULL);
+    assert(!strcmp(pcParallel, pcSerial));
+    Stress_checkListing(pcParallel);
+    free(pcParallel);
+    free(pcSerial);
+}
+
+/*
+  Builds a tree of LIST_DIRS directories, each holding LIST_FILES
+  files and a directory of as many more, and checks its listings.
+*/
+static void Stress_list(void) {
+    char acPath[PATH_LEN];
+    FT_T oFT;
+    int iDir;
+    int iFile;
+
+    oFT = FT_new();
+    assert(oFT != NULL);
+    assert(FT_insertDirIn(oFT, "r") == SUCCESS);
+    for(iDir = 0; iDir < LIST_DIRS; iDir++)
+        for(iFile = 0; iFile < LIST_FILES; iFile++) {
+            sprintf(acPath, "r/d%02d/f%02d", iDir, iFile);
+            assert(FT_insertFileIn(oFT, acPath, acOld, sizeof(acOld))
+                   == SUCCESS);
+            sprintf(acPath, "r/d%02d/sub/f%02d", iDir, iFile);
+            assert(FT_insertFileIn(oFT, acPath, acOld, sizeof(acOld))
+                   == SUCCESS);
+        }
+    Stress_compareListings(oFT);
+    FT_free(oFT);
+}
+
+/*
+  Runs NUM_WRITERS writer threads, each in its own directory, against
+  NUM_READERS reader threads, then checks that the tree they leave
+  matches the one the same changes make when applied one at a time.
+  Listings are checked throughout, as copied both in parallel and
+  serially. Returns 0, or aborts if a check fails.
+*/
+int main(void) {
+    pthread_t asWriters[NUM_WRITERS];
+    pthread_t asReaders[NUM_READERS];
+    int aiWriters[NUM_WRITERS];
+    unsigned long aulSeeds[NUM_READERS];
+    FT_T oFTSerial;
+    char *pcResult;
+    char *pcExpected;
+    const char *pcListing;
+    int i;
+
+    Stress_list();
+
+    oFTShared = FT_new();
+    oFTSerial = FT_new();
+    assert(oFTShared != NULL && oFTSerial != NULL);
+    assert(FT_insertDirIn(oFTShared, "r") == SUCCESS);
+    assert(FT_insertDirIn(oFTSerial, "r") == SUCCESS);
+
+    for(i = 0; i < NUM_READERS; i++) {
+        aulSeeds[i] = (unsigned long) i + 1;
+        assert(pthread_create(&asReaders[i], NULL, Stress_reader,
+                              &aulSeeds[i]) == 0);
+    }
+    for(i = 0; i < NUM_WRITERS; i++) {
+        aiWriters[i] = i;
+        assert(pthread_create(&asWriters[i], NULL, Stress_writer,
+                              &aiWriters[i]) == 0);
+    }
+    for(i = 0; i < NUM_WRITERS; i++)
+        assert(pthread_join(asWriters[i], NULL) == 0);
+    __atomic_store_n(&iWritersDone, 1, __ATOMIC_RELEASE);
+    for(i = 0; i < NUM_READERS; i++)
+        assert(pthread_join(asReaders[i], NULL) == 0);
+
+    for(i = 0; i < NUM_WRITERS; i++)
+        Stress_write(oFTSerial, i, FALSE);
+    pcResult = FT_toStringIn(oFTShared);
+    pcExpected = FT_toStringIn(oFTSerial);
+    assert(pcResult != NULL && pcExpected != NULL);
+    assert(!strcmp(pcResult, pcExpected));
+    Stress_compareListings(oFTShared);
+    /* r, and for each writer its directory, keep, and its files */
+    for(i = 0, pcListing = pcResult; *pcListing != '\0'; pcListing++)
+        if(*pcListing == '\n')
+            i++;
+    assert(i == 1 + NUM_WRITERS * (2 + FILES_PER_WRITER / 2));
+    free(pcResult);
+    free(pcExpected);
+
+    FT_free(oFTShared);
+    FT_free(oFTSerial);
+    printf("ft_stress: %d writers and %d readers agree\n",
+           NUM_WRITERS, NUM_READERS);
+    return 0;
+}
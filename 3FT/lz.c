@@ -0,0 +1,226 @@
+/*--------------------------------------------------------------------*/
+/* lz.c                                                               */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+
+#include "lz.h"
+
+/*
+  Each sequence starts with a token byte: its high 4 bits give the
+  number of literals, its low 4 bits the length of the match less
+  MIN_MATCH. A field of 15 continues in the bytes after the token (for
+  literals) or after the offset (for the match), each adding its value
+  until one is less than 255. Then come the literals, and the match's
+  offset back into the output, 2 bytes, least significant first. The
+  last sequence has literals only, and ends the input.
+*/
+enum { MIN_MATCH = 4, MAX_OFFSET = 65535, FIELD_MAX = 15 };
+
+/* The number of bits in a hash, and so of slots in the match table */
+enum { HASH_BITS = 12 };
+
+/* Returns the hash of the MIN_MATCH bytes at pucBytes. */
+static size_t LZ_hash(const unsigned char *pucBytes) {
+    unsigned long ulWord = (unsigned long) pucBytes[0] |
+                           (unsigned long) pucBytes[1] << 8 |
+                           (unsigned long) pucBytes[2] << 16 |
+                           (unsigned long) pucBytes[3] << 24;
+
+    return (size_t) (((ulWord * 2654435761UL) & 0xffffffffUL) >>
+                     (32 - HASH_BITS));
+}
+
+/*
+  Writes the continuation bytes of a field of ulValue (which has
+  reached FIELD_MAX) at *ppucOut, advancing it, unless that would pass
+  pucEnd. Returns 0 if it would, or else 1.
+*/
+static int LZ_putLength(unsigned char **ppucOut,
+                        const unsigned char *pucEnd, size_t ulValue) {
+    assert(ppucOut != NULL);
+    assert(ulValue >= FIELD_MAX);
+
+    for(ulValue -= FIELD_MAX; ; ulValue -= 255) {
+        if(*ppucOut == pucEnd)
+            return 0;
+        if(ulValue < 255) {
+            *(*ppucOut)++ = (unsigned char) ulValue;
+            return 1;
+        }
+        *(*ppucOut)++ = 255;
+    }
+}
+
+/*
+  Writes a sequence at *ppucOut, advancing it, unless that would pass
+  pucEnd: the ulLiterals bytes at pucLiterals, then, if ulMatch is not
+  0, a match of ulMatch bytes at ulOffset back. Returns 0 if it would
+  not fit, or else 1.
+*/
+static int LZ_putSequence(unsigned char **ppucOut,
+                          const unsigned char *pucEnd,
+                          const unsigned char *pucLiterals,
+                          size_t ulLiterals, size_t ulOffset,
+                          size_t ulMatch) {
+    unsigned char *pucToken;
+    size_t ulMatchField = 0;
+
+    assert(ppucOut != NULL);
+    assert(ulMatch == 0 || ulMatch >= MIN_MATCH);
+
+    if(ulMatch != 0)
+        ulMatchField = ulMatch - MIN_MATCH;
+
+    if(*ppucOut == pucEnd)
+        return 0;
+    pucToken = (*ppucOut)++;
+    *pucToken = (unsigned char)
+        ((ulLiterals < FIELD_MAX ? ulLiterals : FIELD_MAX) << 4 |
+         (ulMatchField < FIELD_MAX ? ulMatchField : FIELD_MAX));
+
+    if(ulLiterals >= FIELD_MAX &&
+       !LZ_putLength(ppucOut, pucEnd, ulLiterals))
+        return 0;
+    if((size_t) (pucEnd - *ppucOut) < ulLiterals)
+        return 0;
+    memcpy(*ppucOut, pucLiterals, ulLiterals);
+    *ppucOut += ulLiterals;
+
+    if(ulMatch == 0)
+        return 1;
+    if(pucEnd - *ppucOut < 2)
+        return 0;
+    *(*ppucOut)++ = (unsigned char) (ulOffset & 0xff);
+    *(*ppucOut)++ = (unsigned char) (ulOffset >> 8);
+    if(ulMatchField >= FIELD_MAX &&
+       !LZ_putLength(ppucOut, pucEnd, ulMatchField))
+        return 0;
+    return 1;
+}
+
+/* ------------------------------------------------------------------ */
+
+size_t LZ_compress(const void *pvSource, size_t ulLength, void *pvDest,
+                   size_t ulCapacity) {
+    const unsigned char *pucIn = pvSource;
+    unsigned char *pucOut = pvDest;
+    unsigned char *pucEnd = pucOut + ulCapacity;
+    /* each slot holds 1 more than the position of the last run of
+       bytes with that hash, or 0 if there was none */
+    size_t aulTable[1 << HASH_BITS];
+    size_t ulPos = 0;
+    size_t ulAnchor = 0;
+
+    assert(pvSource != NULL || ulLength == 0);
+    assert(pvDest != NULL || ulCapacity == 0);
+
+    memset(aulTable, 0, sizeof(aulTable));
+
+    while(ulLength >= MIN_MATCH && ulPos <= ulLength - MIN_MATCH) {
+        size_t ulHash = LZ_hash(pucIn + ulPos);
+        size_t ulCandidate = aulTable[ulHash];
+        size_t ulMatch;
+
+        aulTable[ulHash] = ulPos + 1;
+        if(ulCandidate == 0 || ulPos - (ulCandidate - 1) > MAX_OFFSET ||
+           memcmp(pucIn + ulCandidate - 1, pucIn + ulPos,
+                  MIN_MATCH) != 0) {
+            ulPos++;
+            continue;
+        }
+
+        ulCandidate--;
+        ulMatch = MIN_MATCH;
+        while(ulPos + ulMatch < ulLength &&
+              pucIn[ulCandidate + ulMatch] == pucIn[ulPos + ulMatch])
+            ulMatch++;
+
+        if(!LZ_putSequence(&pucOut, pucEnd, pucIn + ulAnchor,
+                           ulPos - ulAnchor, ulPos - ulCandidate,
+                           ulMatch))
+            return 0;
+        ulPos += ulMatch;
+        ulAnchor = ulPos;
+    }
+
+    if(!LZ_putSequence(&pucOut, pucEnd, pucIn + ulAnchor,
+                       ulLength - ulAnchor, 0, 0))
+        return 0;
+    return (size_t) (pucOut - (unsigned char *) pvDest);
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  Reads the continuation bytes of a field at *ppucIn, advancing it,
+  and adds them to *pulValue. Returns 0 if the input ends at pucEnd
+  first or the value overflows, or else 1.
+*/
+static int LZ_getLength(const unsigned char **ppucIn,
+                        const unsigned char *pucEnd, size_t *pulValue) {
+    unsigned char ucByte;
+
+    assert(ppucIn != NULL);
+    assert(pulValue != NULL);
+
+    do {
+        if(*ppucIn == pucEnd || *pulValue > (size_t) -1 - 255)
+            return 0;
+        ucByte = *(*ppucIn)++;
+        *pulValue += ucByte;
+    } while(ucByte == 255);
+    return 1;
+}
+
+size_t LZ_decompress(const void *pvSource, size_t ulLength, void *pvDest,
+                     size_t ulCapacity) {
+    const unsigned char *pucIn = pvSource;
+    const unsigned char *pucEnd = pucIn + ulLength;
+    unsigned char *pucOut = pvDest;
+    size_t ulOut = 0;
+
+    assert(pvSource != NULL || ulLength == 0);
+    assert(pvDest != NULL || ulCapacity == 0);
+
+    while(pucIn != pucEnd) {
+        unsigned char ucToken = *pucIn++;
+        size_t ulLiterals = ucToken >> 4;
+        size_t ulMatch = ucToken & FIELD_MAX;
+        size_t ulOffset;
+
+        if(ulLiterals == FIELD_MAX &&
+           !LZ_getLength(&pucIn, pucEnd, &ulLiterals))
+            return 0;
+        if((size_t) (pucEnd - pucIn) < ulLiterals ||
+           ulCapacity - ulOut < ulLiterals)
+            return 0;
+        memcpy(pucOut + ulOut, pucIn, ulLiterals);
+        pucIn += ulLiterals;
+        ulOut += ulLiterals;
+
+        /* the last sequence has no match */
+        if(pucIn == pucEnd)
+            break;
+
+        if(pucEnd - pucIn < 2)
+            return 0;
+        ulOffset = (size_t) pucIn[0] | (size_t) pucIn[1] << 8;
+        pucIn += 2;
+        if(ulMatch == FIELD_MAX &&
+           !LZ_getLength(&pucIn, pucEnd, &ulMatch))
+            return 0;
+        ulMatch += MIN_MATCH;
+        if(ulOffset == 0 || ulOffset > ulOut ||
+           ulCapacity - ulOut < ulMatch)
+            return 0;
+
+        /* byte by byte, since the copy may overlap its source */
+        for(; ulMatch > 0; ulMatch--, ulOut++)
+            pucOut[ulOut] = pucOut[ulOut - ulOffset];
+    }
+    return ulOut;
+}
@@ -0,0 +1,37 @@
+/*--------------------------------------------------------------------*/
+/* lz.h                                                               */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+#ifndef LZ_INCLUDED
+#define LZ_INCLUDED
+
+#include <stddef.h>
+
+/*
+  A fast LZ77 block codec in the style of LZ4: the compressed form is
+  a run of sequences, each some literal bytes followed by a copy of
+  earlier output at most 65535 bytes back. It favours speed over
+  ratio, and does well on text and other repetitive data.
+*/
+
+/*
+  Compresses the ulLength bytes at pvSource into pvDest, which has
+  room for ulCapacity bytes. Returns the length of the compressed
+  form, or 0 if it would not fit in ulCapacity bytes (so passing a
+  capacity below ulLength asks for compression only if it saves
+  space).
+*/
+size_t LZ_compress(const void *pvSource, size_t ulLength, void *pvDest,
+                   size_t ulCapacity);
+
+/*
+  Decompresses the ulLength bytes at pvSource, as LZ_compress wrote
+  them, into pvDest, which has room for ulCapacity bytes. Returns the
+  length of the decompressed form, or 0 if pvSource is not a valid
+  compressed form or its decompressed form would not fit.
+*/
+size_t LZ_decompress(const void *pvSource, size_t ulLength, void *pvDest,
+                     size_t ulCapacity);
+
+#endif
@@ -0,0 +1,475 @@
+/*--------------------------------------------------------------------*/
+/* nameindex.c                                                        */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "a4def.h"
+#include "dynarray.h"
+#include "path.h"
+#include "nodeFT.h"
+#include "nameindex.h"
+
+/* The number of buckets a table starts with; it doubles whenever the
+   keys outnumber the buckets. */
+enum { INITIAL_BUCKETS = 64 };
+
+struct indexKey;
+
+/* One node's membership in the set of one key */
+struct indexEntry {
+    /* the node */
+    Node_T oNNode;
+    /* the key whose set this entry is in */
+    struct indexKey *psKey;
+    /* the neighbouring entries in that set */
+    struct indexEntry *psPrev;
+    struct indexEntry *psNext;
+};
+
+/* A name or extension, and the set of nodes carrying it */
+struct indexKey {
+    /* the key, '\0'-terminated, and its hash */
+    char *pcKey;
+    size_t ulHash;
+    /* the next key in the same bucket */
+    struct indexKey *psNext;
+    /* the first entry of the set, which is never empty */
+    struct indexEntry *psFirst;
+};
+
+/*
+  What an indexed node's index slot points to. The name entry comes
+  first, so a pointer to it is also a pointer to the whole.
+*/
+struct indexLinks {
+    /* the node's entry under its name */
+    struct indexEntry sName;
+    /* the node's entry under its extension; its psKey is NULL if the
+       node is a directory or has no extension */
+    struct indexEntry sExtension;
+};
+
+/* A chained hash table of keys */
+struct table {
+    /* the buckets, and the number of them (a power of 2) */
+    struct indexKey **ppsBuckets;
+    size_t ulBuckets;
+    /* the number of keys in the table */
+    size_t ulKeys;
+};
+
+/* An index: one table of names and one of extensions */
+struct nameIndex {
+    struct table sNames;
+    struct table sExtensions;
+};
+
+/* ------------------------------------------------------------------ */
+
+/* Returns the FNV-1a hash of pcKey. */
+static size_t NameIndex_hash(const char *pcKey) {
+    size_t ulHash = 2166136261UL;
+
+    assert(pcKey != NULL);
+
+    for(; *pcKey != '\0'; pcKey++) {
+        ulHash ^= (unsigned char) *pcKey;
+        ulHash *= 16777619UL;
+    }
+    return ulHash;
+}
+
+/* Returns the final component of oNNode's path. */
+static const char *NameIndex_getName(Node_T oNNode) {
+    Path_T oPPath;
+
+    assert(oNNode != NULL);
+
+    oPPath = Node_getPath(oNNode);
+    return Path_getComponent(oPPath, Path_getDepth(oPPath) - 1);
+}
+
+/*
+  Sets up psTable as an empty table. Returns SUCCESS, or MEMORY_ERROR
+  if its buckets could not be allocated.
+*/
+static int NameIndex_initTable(struct table *psTable) {
+    assert(psTable != NULL);
+
+    psTable->ppsBuckets = calloc(INITIAL_BUCKETS,
+                                 sizeof(struct indexKey *));
+    if(psTable->ppsBuckets == NULL)
+        return MEMORY_ERROR;
+    psTable->ulBuckets = INITIAL_BUCKETS;
+    psTable->ulKeys = 0;
+    return SUCCESS;
+}
+
+/*
+  Frees every key in psTable, and its buckets. If bNames is TRUE,
+  psTable is a table of names, whose entries head the nodes' links,
+  and those links are freed too, after resetting the nodes' index
+  slots to NULL if bDetach is TRUE.
+*/
+static void NameIndex_clearTable(struct table *psTable, boolean bNames,
+                                 boolean bDetach) {
+    size_t i;
+
+    assert(psTable != NULL);
+
+    for(i = 0; i < psTable->ulBuckets; i++) {
+        struct indexKey *psKey = psTable->ppsBuckets[i];
+
+        while(psKey != NULL) {
+            struct indexKey *psNextKey = psKey->psNext;
+
+            while(bNames && psKey->psFirst != NULL) {
+                struct indexEntry *psEntry = psKey->psFirst;
+
+                psKey->psFirst = psEntry->psNext;
+                if(bDetach)
+                    Node_setIndexData(psEntry->oNNode, NULL);
+                free((struct indexLinks *) psEntry);
+            }
+            free(psKey->pcKey);
+            free(psKey);
+            psKey = psNextKey;
+        }
+    }
+    free(psTable->ppsBuckets);
+}
+
+/*
+  Doubles the number of buckets in psTable. If they cannot be
+  allocated, psTable keeps the ones it has, which only makes its
+  chains longer.
+*/
+static void NameIndex_grow(struct table *psTable) {
+    struct indexKey **ppsBuckets;
+    size_t ulBuckets;
+    size_t i;
+
+    assert(psTable != NULL);
+
+    ulBuckets = psTable->ulBuckets * 2;
+    ppsBuckets = calloc(ulBuckets, sizeof(struct indexKey *));
+    if(ppsBuckets == NULL)
+        return;
+
+    for(i = 0; i < psTable->ulBuckets; i++) {
+        struct indexKey *psKey = psTable->ppsBuckets[i];
+
+        while(psKey != NULL) {
+            struct indexKey *psNextKey = psKey->psNext;
+            size_t ulBucket = psKey->ulHash & (ulBuckets - 1);
+
+            psKey->psNext = ppsBuckets[ulBucket];
+            ppsBuckets[ulBucket] = psKey;
+            psKey = psNextKey;
+        }
+    }
+    free(psTable->ppsBuckets);
+    psTable->ppsBuckets = ppsBuckets;
+    psTable->ulBuckets = ulBuckets;
+}
+
+/*
+  Returns the key in psTable equal to pcKey, whose hash is ulHash, or
+  NULL if there is none.
+*/
+static struct indexKey *NameIndex_lookup(const struct table *psTable,
+                                         const char *pcKey,
+                                         size_t ulHash) {
+    struct indexKey *psKey;
+
+    assert(psTable != NULL);
+    assert(pcKey != NULL);
+
+    for(psKey = psTable->ppsBuckets[ulHash & (psTable->ulBuckets - 1)];
+        psKey != NULL; psKey = psKey->psNext)
+        if(psKey->ulHash == ulHash && strcmp(psKey->pcKey, pcKey) == 0)
+            return psKey;
+    return NULL;
+}
+
+/*
+  Puts psEntry, for node oNNode, in the set of pcKey in psTable,
+  adding the key if it is new. Returns SUCCESS, or MEMORY_ERROR if a
+  new key could not be allocated (in which case psEntry is not in
+  psTable).
+*/
+static int NameIndex_link(struct table *psTable, const char *pcKey,
+                          Node_T oNNode, struct indexEntry *psEntry) {
+    size_t ulHash;
+    struct indexKey *psKey;
+
+    assert(psTable != NULL);
+    assert(pcKey != NULL);
+    assert(psEntry != NULL);
+
+    ulHash = NameIndex_hash(pcKey);
+    psKey = NameIndex_lookup(psTable, pcKey, ulHash);
+    if(psKey == NULL) {
+        size_t ulBucket;
+
+        psKey = malloc(sizeof(struct indexKey));
+        if(psKey == NULL)
+            return MEMORY_ERROR;
+        psKey->pcKey = malloc(strlen(pcKey) + 1);
+        if(psKey->pcKey == NULL) {
+            free(psKey);
+            return MEMORY_ERROR;
+        }
+        strcpy(psKey->pcKey, pcKey);
+        psKey->ulHash = ulHash;
+        psKey->psFirst = NULL;
+
+        if(psTable->ulKeys >= psTable->ulBuckets)
+            NameIndex_grow(psTable);
+        ulBucket = ulHash & (psTable->ulBuckets - 1);
+        psKey->psNext = psTable->ppsBuckets[ulBucket];
+        psTable->ppsBuckets[ulBucket] = psKey;
+        psTable->ulKeys++;
+    }
+
+    psEntry->oNNode = oNNode;
+    psEntry->psKey = psKey;
+    psEntry->psPrev = NULL;
+    psEntry->psNext = psKey->psFirst;
+    if(psKey->psFirst != NULL)
+        psKey->psFirst->psPrev = psEntry;
+    psKey->psFirst = psEntry;
+    return SUCCESS;
+}
+
+/*
+  Takes psEntry out of its key's set in psTable, and removes the key
+  if that leaves its set empty.
+*/
+static void NameIndex_unlink(struct table *psTable,
+                             struct indexEntry *psEntry) {
+    struct indexKey *psKey;
+    struct indexKey **ppsLink;
+
+    assert(psTable != NULL);
+    assert(psEntry != NULL);
+
+    psKey = psEntry->psKey;
+    assert(psKey != NULL);
+
+    if(psEntry->psPrev != NULL)
+        psEntry->psPrev->psNext = psEntry->psNext;
+    else
+        psKey->psFirst = psEntry->psNext;
+    if(psEntry->psNext != NULL)
+        psEntry->psNext->psPrev = psEntry->psPrev;
+    psEntry->psKey = NULL;
+
+    if(psKey->psFirst != NULL)
+        return;
+
+    ppsLink = &psTable->ppsBuckets[psKey->ulHash &
+                                   (psTable->ulBuckets - 1)];
+    while(*ppsLink != psKey)
+        ppsLink = &(*ppsLink)->psNext;
+    *ppsLink = psKey->psNext;
+    psTable->ulKeys--;
+    free(psKey->pcKey);
+    free(psKey);
+}
+
+/*
+  Adds oNNode alone to oIndex, unless it is already indexed. Returns
+  SUCCESS, or MEMORY_ERROR, in which case oNNode stays unindexed.
+*/
+static int NameIndex_addNode(NameIndex_T oIndex, Node_T oNNode) {
+    struct indexLinks *psLinks;
+    const char *pcName;
+    const char *pcExtension = NULL;
+    int iStatus;
+
+    assert(oIndex != NULL);
+    assert(oNNode != NULL);
+
+    if(Node_getIndexData(oNNode) != NULL)
+        return SUCCESS;
+
+    psLinks = malloc(sizeof(struct indexLinks));
+    if(psLinks == NULL)
+        return MEMORY_ERROR;
+    psLinks->sExtension.psKey = NULL;
+
+    pcName = NameIndex_getName(oNNode);
+    iStatus = NameIndex_link(&oIndex->sNames, pcName, oNNode,
+                             &psLinks->sName);
+    if(iStatus != SUCCESS) {
+        free(psLinks);
+        return iStatus;
+    }
+
+    if(Node_getType(oNNode) == IS_FILE)
+        pcExtension = NameIndex_getExtension(pcName);
+    if(pcExtension != NULL) {
+        iStatus = NameIndex_link(&oIndex->sExtensions, pcExtension,
+                                 oNNode, &psLinks->sExtension);
+        if(iStatus != SUCCESS) {
+            NameIndex_unlink(&oIndex->sNames, &psLinks->sName);
+            free(psLinks);
+            return iStatus;
+        }
+    }
+
+    Node_setIndexData(oNNode, psLinks);
+    return SUCCESS;
+}
+
+/*
+  Calls pfVisit, with pvExtra, for each node in the set of pcKey in
+  psTable, as NameIndex_findName does.
+*/
+static int NameIndex_find(const struct table *psTable, const char *pcKey,
+                          int (*pfVisit)(Node_T oNNode, void *pvExtra),
+                          void *pvExtra) {
+    struct indexKey *psKey;
+    struct indexEntry *psEntry;
+
+    assert(psTable != NULL);
+    assert(pcKey != NULL);
+    assert(pfVisit != NULL);
+
+    psKey = NameIndex_lookup(psTable, pcKey, NameIndex_hash(pcKey));
+    if(psKey == NULL)
+        return SUCCESS;
+
+    for(psEntry = psKey->psFirst; psEntry != NULL;
+        psEntry = psEntry->psNext) {
+        int iStatus = (*pfVisit)(psEntry->oNNode, pvExtra);
+        if(iStatus != SUCCESS)
+            return iStatus;
+    }
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+NameIndex_T NameIndex_new(void) {
+    NameIndex_T oIndex;
+
+    oIndex = malloc(sizeof(struct nameIndex));
+    if(oIndex == NULL)
+        return NULL;
+
+    if(NameIndex_initTable(&oIndex->sNames) != SUCCESS) {
+        free(oIndex);
+        return NULL;
+    }
+    if(NameIndex_initTable(&oIndex->sExtensions) != SUCCESS) {
+        free(oIndex->sNames.ppsBuckets);
+        free(oIndex);
+        return NULL;
+    }
+    return oIndex;
+}
+
+/* ------------------------------------------------------------------ */
+
+void NameIndex_free(NameIndex_T oIndex, boolean bDetach) {
+    assert(oIndex != NULL);
+
+    NameIndex_clearTable(&oIndex->sExtensions, FALSE, FALSE);
+    NameIndex_clearTable(&oIndex->sNames, TRUE, bDetach);
+    free(oIndex);
+}
+
+/* ------------------------------------------------------------------ */
+
+int NameIndex_addSubtree(NameIndex_T oIndex, Node_T oNNode) {
+    DynArray_T oDChildren;
+    size_t i;
+    int iStatus;
+
+    assert(oIndex != NULL);
+    assert(oNNode != NULL);
+
+    iStatus = NameIndex_addNode(oIndex, oNNode);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    oDChildren = Node_getChildren(oNNode);
+    if(oDChildren == NULL)
+        return SUCCESS;
+    for(i = 0; i < DynArray_getLength(oDChildren); i++) {
+        iStatus = NameIndex_addSubtree(oIndex,
+                                       DynArray_get(oDChildren, i));
+        if(iStatus != SUCCESS)
+            return iStatus;
+    }
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+void NameIndex_removeSubtree(NameIndex_T oIndex, Node_T oNNode) {
+    struct indexLinks *psLinks;
+    DynArray_T oDChildren;
+    size_t i;
+
+    assert(oIndex != NULL);
+    assert(oNNode != NULL);
+
+    psLinks = Node_getIndexData(oNNode);
+    if(psLinks != NULL) {
+        NameIndex_unlink(&oIndex->sNames, &psLinks->sName);
+        if(psLinks->sExtension.psKey != NULL)
+            NameIndex_unlink(&oIndex->sExtensions,
+                             &psLinks->sExtension);
+        Node_setIndexData(oNNode, NULL);
+        free(psLinks);
+    }
+
+    oDChildren = Node_getChildren(oNNode);
+    if(oDChildren == NULL)
+        return;
+    for(i = 0; i < DynArray_getLength(oDChildren); i++)
+        NameIndex_removeSubtree(oIndex, DynArray_get(oDChildren, i));
+}
+
+/* ------------------------------------------------------------------ */
+
+const char *NameIndex_getExtension(const char *pcName) {
+    const char *pcDot;
+
+    assert(pcName != NULL);
+
+    pcDot = strrchr(pcName, '.');
+    if(pcDot == NULL || pcDot == pcName || pcDot[1] == '\0')
+        return NULL;
+    return pcDot + 1;
+}
+
+/* ------------------------------------------------------------------ */
+
+int NameIndex_findName(NameIndex_T oIndex, const char *pcName,
+                       int (*pfVisit)(Node_T oNNode, void *pvExtra),
+                       void *pvExtra) {
+    assert(oIndex != NULL);
+
+    return NameIndex_find(&oIndex->sNames, pcName, pfVisit, pvExtra);
+}
+
+/* ------------------------------------------------------------------ */
+
+int NameIndex_findExtension(NameIndex_T oIndex, const char *pcExtension,
+                            int (*pfVisit)(Node_T oNNode,
+                                           void *pvExtra),
+                            void *pvExtra) {
+    assert(oIndex != NULL);
+
+    return NameIndex_find(&oIndex->sExtensions, pcExtension, pfVisit,
+                          pvExtra);
+}
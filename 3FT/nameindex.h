@@ -0,0 +1,78 @@
+/*--------------------------------------------------------------------*/
+/* nameindex.h                                                        */
+/* Author: Mirabelle Weinbach and John Wallace                        */
+/*--------------------------------------------------------------------*/
+
+#ifndef NAMEINDEX_INCLUDED
+#define NAMEINDEX_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "nodeFT.h"
+
+/*
+  A NameIndex_T maps final path components, and the extensions of
+  file names, to the set of nodes carrying them, so that every node
+  with a given name or extension is found in time proportional to the
+  number found. Each indexed node keeps its place in the index in its
+  index slot (see Node_setIndexData), so it is removed in O(1) time.
+
+  An index does no locking of its own: the caller serializes every
+  call on the same index, and keeps each indexed node allocated until
+  it has been removed from the index.
+*/
+typedef struct nameIndex *NameIndex_T;
+
+/*
+  Returns a new, empty index, or NULL if memory could not be
+  allocated.
+*/
+NameIndex_T NameIndex_new(void);
+
+/*
+  Frees oIndex and everything it allocated. If bDetach is TRUE, the
+  index slots of the nodes still in oIndex are reset to NULL, so they
+  may later be added to another index; otherwise those nodes are not
+  touched, and must not be used with an index again.
+*/
+void NameIndex_free(NameIndex_T oIndex, boolean bDetach);
+
+/*
+  Adds every node in the subtree rooted at oNNode that is not in an
+  index yet to oIndex. Returns SUCCESS, or MEMORY_ERROR if memory
+  could not be allocated, in which case some of those nodes may
+  remain unindexed.
+*/
+int NameIndex_addSubtree(NameIndex_T oIndex, Node_T oNNode);
+
+/*
+  Removes every node in the subtree rooted at oNNode from oIndex,
+  resetting their index slots to NULL. Nodes that are not indexed are
+  skipped.
+*/
+void NameIndex_removeSubtree(NameIndex_T oIndex, Node_T oNNode);
+
+/*
+  Returns the extension of pcName, a final path component of a file:
+  the text after its last '.', or NULL if it has none. A name that
+  only begins with '.', or ends with it, has no extension.
+*/
+const char *NameIndex_getExtension(const char *pcName);
+
+/*
+  NameIndex_findName and NameIndex_findExtension call pfVisit, with
+  pvExtra, for each node in oIndex whose final path component is
+  pcName, or for each file whose extension (as NameIndex_getExtension
+  defines it) is pcExtension, in no particular order, until pfVisit
+  returns something other than SUCCESS. pfVisit must not change
+  oIndex. Return SUCCESS, or the first other status pfVisit returned.
+*/
+int NameIndex_findName(NameIndex_T oIndex, const char *pcName,
+                       int (*pfVisit)(Node_T oNNode, void *pvExtra),
+                       void *pvExtra);
+int NameIndex_findExtension(NameIndex_T oIndex, const char *pcExtension,
+                            int (*pfVisit)(Node_T oNNode,
+                                           void *pvExtra),
+                            void *pvExtra);
+
+#endif
@@ -3,10 +3,18 @@
 /* Author: Mirabelle Weinbach and John Wallace                        */
 /*--------------------------------------------------------------------*/
 
+#ifdef FT_THREADSAFE
+/* for pthread_mutex_t under a strict ISO C compilation */
+#define _POSIX_C_SOURCE 200112L
+#include <pthread.h>
+#endif
+
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
 #include "dynarray.h"
+#include "epoch.h"
+#include "content.h"
 #include "nodeFT.h"
 #include "a4def.h"
 
@@ -24,10 +32,112 @@ struct node {
     void *pvContents;
     /* the size of the file; 0 if node is a directory */
     size_t ulSize;
+    /* odd while a writer changes pvContents and ulSize, and advanced
+       by each change, so that a lock-free reader can tell it loaded
+       both from the same one */
+    unsigned long ulContentsSeq;
+    /* the buffer pvContents points into, if the file owns a reference
+       to its contents; NULL if they are borrowed from the caller */
+    Content_T oContent;
+    /* set when the file's contents are used, and cleared by a sweep
+       for cold contents */
+    boolean bUsed;
+    /* set once the bytes of the buffer the file owns are handed out,
+       and cleared when it owns another */
+    boolean bPinned;
+    /* TRUE if the file was created with its contents in the node's
+       own allocation, after the struct */
+    boolean bInline;
+    /* this directory's own lines of the FT listing (its path, then
+       its files' paths), and their length; NULL until first built */
+    char *pcListing;
+    size_t ulListingLength;
+    /* the length of the listing of the whole subtree, and the number
+       of nodes in it */
+    size_t ulSubtreeLength;
+    size_t ulSubtreeCount;
+    /* the children as of pcListing, in listing order (files, then
+       directories), how many there are and how many are files, and
+       for each the number of subtree entries up to and including its
+       own part of the listing */
+    Node_T *poNOrder;
+    size_t ulOrderLength;
+    size_t ulOrderFiles;
+    size_t *pulOrderEnds;
+    /* set by writers when a change to the children leaves pcListing,
+       or ulSubtreeLength, out of date; cleared on rebuilding it */
+    boolean bListingStale;
+    boolean bSubtreeStale;
+    /* this node's place in a name index, or NULL if it is in none */
+    void *pvIndex;
+#ifdef FT_THREADSAFE
+    /* serializes writers changing this directory's children */
+    pthread_mutex_t sLock;
+    /* TRUE once this node has been unlinked (or is about to be);
+       protected by sLock */
+    boolean bRemoved;
+#endif
+};
+
+/* A component name that is not necessarily '\0'-terminated */
+struct name {
+    /* the first character of the name */
+    const char *pcName;
+    /* the number of characters in the name */
+    size_t ulLength;
 };
 
 /* ------------------------------------------------------------------ */
 
+/*
+  In thread-safe builds, readers scan a directory's children without
+  locks, so a child array is never modified once it is published:
+  adding or removing a child publishes an updated copy and retires
+  the old array through Epoch_retire. Writers to the same directory
+  are serialized by its lock, which the caller holds.
+*/
+
+#ifdef FT_THREADSAFE
+/* Frees pvArray, a child array. Used as an Epoch_retire callback. */
+static void Node_freeChildArray(void *pvArray) {
+    DynArray_free(pvArray);
+}
+#endif
+
+/*
+  Records that oNDir's children have changed: its own listing lines
+  must be rebuilt, and the subtree lengths of it and its ancestors
+  recomputed. Called after the new children are published.
+*/
+static void Node_markStale(Node_T oNDir) {
+    Node_T oNCurr;
+
+    assert(oNDir != NULL);
+
+    Epoch_store(&oNDir->bListingStale, TRUE);
+    for(oNCurr = oNDir; oNCurr != NULL; oNCurr = oNCurr->oNParent)
+        Epoch_store(&oNCurr->bSubtreeStale, TRUE);
+}
+
+/*
+  Clears the flag *pbFlag and returns its previous value. In
+  thread-safe builds this is atomic, and the writes made before the
+  flag was set are visible afterwards.
+*/
+static boolean Node_takeFlag(boolean *pbFlag) {
+    assert(pbFlag != NULL);
+
+#ifdef FT_THREADSAFE
+    return __atomic_exchange_n(pbFlag, FALSE, __ATOMIC_ACQUIRE);
+#else
+    {
+        boolean bOld = *pbFlag;
+        *pbFlag = FALSE;
+        return bOld;
+    }
+#endif
+}
+
 /*
   Links new child oNChild into oNParent's children array at index
   ulIndex. Returns SUCCESS if the new child was added successfully,
@@ -36,16 +146,187 @@ struct node {
 
 static int Node_addChild(Node_T oNParent, Node_T oNChild,
                          size_t ulIndex) {
+#ifdef FT_THREADSAFE
+    DynArray_T oDOld;
+    DynArray_T oDNew;
+    size_t ulLength;
+    size_t i;
+#endif
+
     assert(oNParent != NULL);
     assert(oNChild != NULL);
 
     if(oNParent -> type != IS_DIRECTORY)
         return NOT_A_DIRECTORY;
 
-    if(DynArray_addAt(oNParent->oDChildren, ulIndex, oNChild))
-        return SUCCESS;
-    else
+#ifdef FT_THREADSAFE
+    oDOld = oNParent->oDChildren;
+    ulLength = DynArray_getLength(oDOld);
+    oDNew = DynArray_new(ulLength + 1);
+    if(oDNew == NULL)
+        return MEMORY_ERROR;
+
+    for(i = 0; i < ulIndex; i++)
+        (void) DynArray_set(oDNew, i, DynArray_get(oDOld, i));
+    (void) DynArray_set(oDNew, ulIndex, oNChild);
+    for(i = ulIndex; i < ulLength; i++)
+        (void) DynArray_set(oDNew, i + 1, DynArray_get(oDOld, i));
+
+    Epoch_store(&oNParent->oDChildren, oDNew);
+    Epoch_retire(oDOld, Node_freeChildArray);
+#else
+    if(!DynArray_addAt(oNParent->oDChildren, ulIndex, oNChild))
         return MEMORY_ERROR;
+#endif
+    Node_markStale(oNParent);
+    return SUCCESS;
+}
+
+#ifdef FT_THREADSAFE
+/*
+  Returns a new copy of oNParent's children array without the child at
+  index ulIndex, for Node_removeChild to install, or NULL if it could
+  not be allocated.
+*/
+static DynArray_T Node_copyWithout(Node_T oNParent, size_t ulIndex) {
+    DynArray_T oDOld;
+    DynArray_T oDNew;
+    size_t ulLength;
+    size_t i;
+
+    assert(oNParent != NULL);
+
+    oDOld = oNParent->oDChildren;
+    ulLength = DynArray_getLength(oDOld);
+    assert(ulIndex < ulLength);
+    oDNew = DynArray_new(ulLength - 1);
+    if(oDNew == NULL)
+        return NULL;
+
+    for(i = 0; i < ulIndex; i++)
+        (void) DynArray_set(oDNew, i, DynArray_get(oDOld, i));
+    for(i = ulIndex + 1; i < ulLength; i++)
+        (void) DynArray_set(oDNew, i - 1, DynArray_get(oDOld, i));
+    return oDNew;
+}
+#endif
+
+/*
+  Unlinks the child at index ulIndex from oNParent's children array.
+  In thread-safe builds, oDNew is the copy of the array without it
+  that Node_copyWithout made, which oNParent takes; otherwise it is
+  NULL and the array is changed in place. Cannot fail, so that the
+  caller can do everything that can before committing to it.
+*/
+static void Node_removeChild(Node_T oNParent, size_t ulIndex,
+                             DynArray_T oDNew) {
+#ifdef FT_THREADSAFE
+    DynArray_T oDOld;
+#endif
+
+    assert(oNParent != NULL);
+
+#ifdef FT_THREADSAFE
+    assert(oDNew != NULL);
+    (void) ulIndex;
+    oDOld = oNParent->oDChildren;
+    Epoch_store(&oNParent->oDChildren, oDNew);
+    Epoch_retire(oDOld, Node_freeChildArray);
+#else
+    assert(oDNew == NULL);
+    (void) oDNew;
+    (void) DynArray_removeAt(oNParent->oDChildren, ulIndex);
+#endif
+    Node_markStale(oNParent);
+}
+
+/*
+  Frees the subtree rooted at oNNode, which is already unlinked from
+  its parent, without unlinking each descendant from its own parent.
+  Returns the number of nodes freed.
+*/
+static size_t Node_destroy(Node_T oNNode) {
+    size_t ulCount = 1;
+    size_t ulLength;
+    size_t i;
+
+    assert(oNNode != NULL);
+
+    ulLength = DynArray_getLength(oNNode->oDChildren);
+    for(i = 0; i < ulLength; i++)
+        ulCount += Node_destroy(DynArray_get(oNNode->oDChildren, i));
+    DynArray_free(oNNode->oDChildren);
+    free(oNNode->pcListing);
+    free(oNNode->poNOrder);
+    free(oNNode->pulOrderEnds);
+    if(oNNode->oContent != NULL)
+        Content_release(oNNode->oContent);
+
+#ifdef FT_THREADSAFE
+    (void) pthread_mutex_destroy(&oNNode->sLock);
+#endif
+    Path_free(oNNode->oPPath);
+    free(oNNode);
+    return ulCount;
+}
+
+#ifdef FT_THREADSAFE
+/* Frees the unlinked subtree pvNode. Used as an Epoch_retire callback. */
+static void Node_destroyRetired(void *pvNode) {
+    (void) Node_destroy(pvNode);
+}
+
+/*
+  Marks every node in the subtree rooted at oNNode as removed, taking
+  each one's lock in turn from the top down, so that it waits out any
+  writer already working there and turns away any that arrives later.
+  Returns the number of nodes marked.
+*/
+static size_t Node_markRemoved(Node_T oNNode) {
+    DynArray_T oDChildren;
+    size_t ulCount = 1;
+    size_t ulLength;
+    size_t i;
+
+    assert(oNNode != NULL);
+
+    Node_lock(oNNode);
+    oNNode->bRemoved = TRUE;
+    /* no writer can change the children once the flag is set */
+    oDChildren = oNNode->oDChildren;
+    Node_unlock(oNNode);
+
+    ulLength = DynArray_getLength(oDChildren);
+    for(i = 0; i < ulLength; i++)
+        ulCount += Node_markRemoved(DynArray_get(oDChildren, i));
+    return ulCount;
+}
+#endif
+
+/* ------------------------------------------------------------------ */
+
+/*
+  Compares the final component of oNNode's path with the name
+  described by psName.
+  Returns <0, 0, or >0 if the component is "less than", "equal to", or
+  "greater than" the name, respectively.
+*/
+static int Node_compareName(const Node_T oNNode,
+                            const struct name *psName) {
+    const char *pcComponent;
+    int iCompare;
+
+    assert(oNNode != NULL);
+    assert(psName != NULL);
+
+    pcComponent = Path_getComponent(oNNode->oPPath,
+                                    Path_getDepth(oNNode->oPPath) - 1);
+    iCompare = strncmp(pcComponent, psName->pcName, psName->ulLength);
+    if(iCompare != 0)
+        return iCompare;
+
+    /* equal up to the name's length: a longer component is greater */
+    return pcComponent[psName->ulLength] != '\0';
 }
 
 /* ------------------------------------------------------------------ */
@@ -67,91 +348,103 @@ static int Node_compareString(const Node_T oNFirst,
 
 /* ------------------------------------------------------------------ */
 
+/*
+  Initializes the writer lock of new node psNew, if built with
+  FT_THREADSAFE. Returns SUCCESS, or MEMORY_ERROR if it could not be.
+*/
+static int Node_initLock(struct node *psNew) {
+    assert(psNew != NULL);
+
+#ifdef FT_THREADSAFE
+    if(pthread_mutex_init(&psNew->sLock, NULL) != 0)
+        return MEMORY_ERROR;
+    psNew->bRemoved = FALSE;
+#else
+    (void) psNew;
+#endif
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
 int Node_new(Path_T oPPath, nodeType type, Node_T oNParent,
              Node_T *poNResult) {
-    struct node *psNew;
-    Path_T oPParentPath = NULL;
-    Path_T oPNewPath = NULL;
+    Node_T oNNew = NULL;
     int iStatus;
-    size_t ulIndex = 0;
-    
+
     assert(oPPath != NULL);
     assert(poNResult != NULL);
 
     /* allocate space for a new node */
-    psNew = calloc(1, sizeof(struct node));
-    if(psNew == NULL) {
+    iStatus = Node_newUnlinked(oPPath, type, &oNNew);
+    if(iStatus != SUCCESS) {
         *poNResult = NULL;
-        return MEMORY_ERROR;
+        return iStatus;
     }
-    psNew->pvContents = NULL;
-    psNew->type = type; /* set the node's type */
 
-    /* set the new node's path */
-    iStatus = Path_dup(oPPath, &oPNewPath);
+    /* validate and set the new node's parent */
+    if(oNParent != NULL)
+        iStatus = Node_link(oNParent, oNNew);
+    /* new node must be root and therefore must be directory*/
+    /* can only create one "level" at a time */
+    else if(Path_getDepth(oNNew->oPPath) != 1)
+        iStatus = NO_SUCH_PATH;
+
     if(iStatus != SUCCESS) {
-        free(psNew);
+        (void) Node_destroy(oNNew);
         *poNResult = NULL;
         return iStatus;
     }
-    psNew->oPPath = oPNewPath;
 
-    /* validate and set the new node's parent */
-    if(oNParent != NULL) {
-        size_t ulSharedDepth;
-        size_t ulParentDepth;
-
-        oPParentPath = oNParent->oPPath;
-        ulParentDepth = Path_getDepth(oPParentPath);
-        ulSharedDepth = Path_getSharedPrefixDepth(psNew->oPPath,
-                                                    oPParentPath);
-
-        /* parent must be a directory */
-        if (oNParent -> type == IS_FILE){
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return NOT_A_DIRECTORY;
-        }
+    *poNResult = oNNew;
+    return SUCCESS;
+}
 
-        /* parent must be an ancestor of child */
-        if(ulSharedDepth < ulParentDepth) {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return CONFLICTING_PATH;
-        }
+/* ------------------------------------------------------------------ */
 
-        /* parent must be exactly one level up from child */
-        if(Path_getDepth(psNew->oPPath) != ulParentDepth + 1) {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return NO_SUCH_PATH;
-        }
+/*
+  Creates a node as Node_newUnlinked does, with room for ulExtra more
+  bytes after it in the same allocation.
+*/
+static int Node_allocate(Path_T oPPath, nodeType type, size_t ulExtra,
+                         Node_T *poNResult) {
+    struct node *psNew;
+    int iStatus;
 
-        /* parent must not already have child with this path */
-        if(Node_hasChild(oNParent, oPPath, &ulIndex)) {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return ALREADY_IN_TREE;
-        }
+    assert(oPPath != NULL);
+    assert(poNResult != NULL);
+
+    if(ulExtra > (size_t) -1 - sizeof(struct node)) {
+        *poNResult = NULL;
+        return MEMORY_ERROR;
     }
-    else {
-        /* new node must be root and therefore must be directory*/
-        /* can only create one "level" at a time */
-
-        if(Path_getDepth(psNew->oPPath) != 1) {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return NO_SUCH_PATH;
-        }
+    psNew = calloc(1, sizeof(struct node) + ulExtra);
+    if(psNew == NULL) {
+        *poNResult = NULL;
+        return MEMORY_ERROR;
+    }
+    psNew->pvContents = NULL;
+    psNew->ulContentsSeq = 0;
+    psNew->oContent = NULL;
+    psNew->bUsed = FALSE;
+    psNew->bPinned = FALSE;
+    psNew->bInline = FALSE;
+    psNew->type = type;
+    psNew->oNParent = NULL;
+    psNew->pcListing = NULL;
+    psNew->poNOrder = NULL;
+    psNew->pulOrderEnds = NULL;
+    psNew->bListingStale = TRUE;
+    psNew->bSubtreeStale = TRUE;
+    psNew->pvIndex = NULL;
+
+    iStatus = Path_dup(oPPath, &psNew->oPPath);
+    if(iStatus != SUCCESS) {
+        free(psNew);
+        *poNResult = NULL;
+        return iStatus;
     }
-    psNew->oNParent = oNParent;
 
-    /* initialize the new node */
     psNew->oDChildren = DynArray_new(0);
     if(psNew->oDChildren == NULL) {
         Path_free(psNew->oPPath);
@@ -159,20 +452,129 @@ int Node_new(Path_T oPPath, nodeType type, Node_T oNParent,
         *poNResult = NULL;
         return MEMORY_ERROR;
     }
+    iStatus = Node_initLock(psNew);
+    if(iStatus != SUCCESS) {
+        DynArray_free(psNew->oDChildren);
+        Path_free(psNew->oPPath);
+        free(psNew);
+        *poNResult = NULL;
+        return iStatus;
+    }
+
+    *poNResult = psNew;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+int Node_newUnlinked(Path_T oPPath, nodeType type, Node_T *poNResult) {
+    return Node_allocate(oPPath, type, 0, poNResult);
+}
+
+/* ------------------------------------------------------------------ */
+
+int Node_newInline(Path_T oPPath, const void *pvData, size_t ulLength,
+                   Node_T *poNResult) {
+    Node_T oNNew;
+    int iStatus;
+
+    assert(pvData != NULL);
+    assert(ulLength > 0);
+
+    iStatus = Node_allocate(oPPath, IS_FILE, ulLength, poNResult);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    oNNew = *poNResult;
+    memcpy(oNNew + 1, pvData, ulLength);
+    oNNew->pvContents = oNNew + 1;
+    oNNew->ulSize = ulLength;
+    oNNew->bInline = TRUE;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+int Node_link(Node_T oNParent, Node_T oNChild) {
+    Path_T oPParentPath;
+    size_t ulSharedDepth;
+    size_t ulParentDepth;
+    size_t ulIndex = 0;
+
+    assert(oNParent != NULL);
+    assert(oNChild != NULL);
+    assert(oNChild->oNParent == NULL);
+
+    oPParentPath = oNParent->oPPath;
+    ulParentDepth = Path_getDepth(oPParentPath);
+    ulSharedDepth = Path_getSharedPrefixDepth(oNChild->oPPath,
+                                              oPParentPath);
+
+    /* parent must be a directory */
+    if(oNParent->type == IS_FILE)
+        return NOT_A_DIRECTORY;
+
+    /* parent must be an ancestor of child */
+    if(ulSharedDepth < ulParentDepth)
+        return CONFLICTING_PATH;
+
+    /* parent must be exactly one level up from child */
+    if(Path_getDepth(oNChild->oPPath) != ulParentDepth + 1)
+        return NO_SUCH_PATH;
+
+    /* parent must not already have child with this path */
+    if(Node_hasChild(oNParent, oNChild->oPPath, &ulIndex))
+        return ALREADY_IN_TREE;
 
     /* Link into parent's children list */
-    if(oNParent != NULL) {
-        iStatus = Node_addChild(oNParent, psNew, ulIndex);
-        if (iStatus != SUCCESS) {
-            Path_free(psNew->oPPath);
-            free(psNew);
-            *poNResult = NULL;
-            return iStatus;
-        }
+    oNChild->oNParent = oNParent;
+    if(Node_addChild(oNParent, oNChild, ulIndex) != SUCCESS) {
+        oNChild->oNParent = NULL;
+        return MEMORY_ERROR;
     }
+    return SUCCESS;
+}
 
-    *poNResult = psNew;
+/* ------------------------------------------------------------------ */
+
+int Node_adoptChildren(Node_T oNParent, DynArray_T oDPending,
+                       size_t ulFirst) {
+    DynArray_T oDExact;
+    size_t ulLength;
+    size_t i;
+
+    assert(oNParent != NULL);
+    assert(oDPending != NULL);
+    assert(ulFirst <= DynArray_getLength(oDPending));
+    assert(DynArray_getLength(oNParent->oDChildren) == 0);
+
+    if(oNParent->type != IS_DIRECTORY)
+        return NOT_A_DIRECTORY;
+
+    ulLength = DynArray_getLength(oDPending) - ulFirst;
+    if(ulLength == 0)
+        return SUCCESS;
 
+    /* exactly-sized array, filled in order: no addAt shifting */
+    oDExact = DynArray_new(ulLength);
+    if(oDExact == NULL)
+        return MEMORY_ERROR;
+
+    for(i = 0; i < ulLength; i++) {
+        Node_T oNChild = DynArray_get(oDPending, ulFirst + i);
+        assert(oNChild->oNParent == NULL);
+        oNChild->oNParent = oNParent;
+        (void) DynArray_set(oDExact, i, oNChild);
+    }
+
+    /* pop the adopted nodes off the end of the pending array */
+    for(i = 0; i < ulLength; i++)
+        (void) DynArray_removeAt(oDPending,
+                                 DynArray_getLength(oDPending) - 1);
+
+    DynArray_free(oNParent->oDChildren);
+    oNParent->oDChildren = oDExact;
+    Node_markStale(oNParent);
     return SUCCESS;
 }
 
@@ -191,33 +593,40 @@ int Node_compare(Node_T oNFirst, Node_T oNSecond) {
 
 size_t Node_free(Node_T oNNode) {
     size_t ulIndex = 0;
-    size_t ulCount = 0;
+    size_t ulCount;
+    boolean bLinked = FALSE;
+    DynArray_T oDNew = NULL;
 
     assert(oNNode != NULL);
 
-    /* remove from parent's list */
-    if(oNNode->oNParent != NULL) {
-        if(DynArray_bsearch(
+    /* find the node in its parent's list, and in thread-safe builds
+       copy the list without it, before anything is torn down */
+    if(oNNode->oNParent != NULL)
+        bLinked = (boolean) DynArray_bsearch(
                 oNNode->oNParent->oDChildren,
                 oNNode, &ulIndex,
-                (int (*)(const void *, const void *)) Node_compare)
-            )
-            (void) DynArray_removeAt(oNNode->oNParent->oDChildren,
-                                    ulIndex);
+                (int (*)(const void *, const void *)) Node_compare);
+#ifdef FT_THREADSAFE
+    if(bLinked) {
+        oDNew = Node_copyWithout(oNNode->oNParent, ulIndex);
+        if(oDNew == NULL)
+            return 0;
     }
 
-    /* recursively remove children */
-    while(DynArray_getLength(oNNode->oDChildren) != 0) {
-        ulCount += Node_free(DynArray_get(oNNode->oDChildren, 0));
-    }
-    DynArray_free(oNNode->oDChildren);
-
-    /* remove path */
-    Path_free(oNNode->oPPath);
+    /* turn writers away from the subtree before unlinking it */
+    ulCount = Node_markRemoved(oNNode);
+#endif
 
-    /* finally, free the struct node */
-    free(oNNode);
-    ulCount++;
+    /* remove from parent's list */
+    if(bLinked)
+        Node_removeChild(oNNode->oNParent, ulIndex, oDNew);
+
+    /* free the whole subtree, once no reader can be visiting it */
+#ifdef FT_THREADSAFE
+    Epoch_retire(oNNode, Node_destroyRetired);
+#else
+    ulCount = Node_destroy(oNNode);
+#endif
     return ulCount;
 }
 
@@ -251,6 +660,47 @@ boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
 
 /* ------------------------------------------------------------------ */
 
+boolean Node_findChild(Node_T oNParent, const char *pcName,
+                       size_t ulLength, Node_T *poNResult) {
+    DynArray_T oDChildren;
+    size_t ulIndex = 0;
+
+    assert(oNParent != NULL);
+    assert(pcName != NULL);
+    assert(poNResult != NULL);
+
+    *poNResult = NULL;
+    if(oNParent->type == IS_FILE)
+        return FALSE;
+
+    /* one snapshot of the children serves the search and the result */
+    oDChildren = Epoch_load(&oNParent->oDChildren);
+    if(!Node_findChildIndex(oDChildren, pcName, ulLength, &ulIndex))
+        return FALSE;
+
+    *poNResult = DynArray_get(oDChildren, ulIndex);
+    return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Node_findChildIndex(DynArray_T oDChildren, const char *pcName,
+                            size_t ulLength, size_t *pulIndex) {
+    struct name sName;
+
+    assert(oDChildren != NULL);
+    assert(pcName != NULL);
+    assert(pulIndex != NULL);
+
+    sName.pcName = pcName;
+    sName.ulLength = ulLength;
+    return (boolean) DynArray_bsearch(oDChildren, &sName, pulIndex,
+                                      (int (*)(const void*, const void*))
+                                      Node_compareName);
+}
+
+/* ------------------------------------------------------------------ */
+
 int Node_getNumChildren(Node_T oNParent, size_t *pulNum) {
     assert(oNParent != NULL);
     assert(pulNum != NULL);
@@ -302,6 +752,312 @@ Node_T Node_getParent(Node_T oNNode) {
 
 /* ------------------------------------------------------------------ */
 
+DynArray_T Node_getChildren(Node_T oNParent) {
+    assert(oNParent != NULL);
+
+    if(oNParent->type == IS_FILE)
+        return NULL;
+    return Epoch_load(&oNParent->oDChildren);
+}
+
+/* ------------------------------------------------------------------ */
+
+void Node_lock(Node_T oNNode) {
+#ifdef FT_THREADSAFE
+    int iRet;
+
+    assert(oNNode != NULL);
+
+    iRet = pthread_mutex_lock(&oNNode->sLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    assert(oNNode != NULL);
+    (void) oNNode;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+void Node_unlock(Node_T oNNode) {
+#ifdef FT_THREADSAFE
+    int iRet;
+
+    assert(oNNode != NULL);
+
+    iRet = pthread_mutex_unlock(&oNNode->sLock);
+    assert(iRet == 0);
+    (void) iRet;
+#else
+    assert(oNNode != NULL);
+    (void) oNNode;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Node_isRemoved(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+#ifdef FT_THREADSAFE
+    return oNNode->bRemoved;
+#else
+    (void) oNNode;
+    return FALSE;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+void *Node_getIndexData(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return oNNode->pvIndex;
+}
+
+/* ------------------------------------------------------------------ */
+
+void Node_setIndexData(Node_T oNNode, void *pvIndex) {
+    assert(oNNode != NULL);
+
+    oNNode->pvIndex = pvIndex;
+}
+
+/* ------------------------------------------------------------------ */
+
+/*
+  Rebuilds oNDir's own listing lines, and its children in listing
+  order, from oDChildren, its current children. Returns SUCCESS, or
+  MEMORY_ERROR (leaving the old ones in place).
+*/
+static int Node_buildListing(Node_T oNDir, DynArray_T oDChildren) {
+    size_t ulLength;
+    size_t ulChildren;
+    size_t ulFiles = 0;
+    size_t ulDirs;
+    char *pcListing;
+    char *pcCursor;
+    Node_T *poNOrder;
+    size_t *pulOrderEnds;
+    size_t i;
+
+    assert(oNDir != NULL);
+    assert(oDChildren != NULL);
+
+    ulChildren = DynArray_getLength(oDChildren);
+    ulLength = Path_getStrLength(oNDir->oPPath) + 1;
+    for(i = 0; i < ulChildren; i++) {
+        Node_T oNChild = DynArray_get(oDChildren, i);
+        if(oNChild->type == IS_FILE) {
+            ulLength += Path_getStrLength(oNChild->oPPath) + 1;
+            ulFiles++;
+        }
+    }
+
+    /* one more slot each, so that nothing is allocated with size 0 */
+    pcListing = malloc(ulLength);
+    poNOrder = malloc((ulChildren + 1) * sizeof(Node_T));
+    pulOrderEnds = malloc((ulChildren + 1) * sizeof(size_t));
+    if(pcListing == NULL || poNOrder == NULL || pulOrderEnds == NULL) {
+        free(pcListing);
+        free(poNOrder);
+        free(pulOrderEnds);
+        return MEMORY_ERROR;
+    }
+
+    pcCursor = pcListing;
+    ulDirs = ulFiles;
+    ulFiles = 0;
+    for(i = 0; i <= ulChildren; i++) {
+        /* the directory itself, then each of its files */
+        Node_T oNLine = oNDir;
+        size_t ulLineLength;
+
+        if(i > 0) {
+            oNLine = DynArray_get(oDChildren, i - 1);
+            if(oNLine->type != IS_FILE) {
+                poNOrder[ulDirs++] = oNLine;
+                continue;
+            }
+            poNOrder[ulFiles++] = oNLine;
+        }
+        ulLineLength = Path_getStrLength(oNLine->oPPath);
+        memcpy(pcCursor, Path_getPathname(oNLine->oPPath), ulLineLength);
+        pcCursor[ulLineLength] = '\n';
+        pcCursor += ulLineLength + 1;
+    }
+    assert((size_t) (pcCursor - pcListing) == ulLength);
+    assert(ulDirs == ulChildren);
+
+    free(oNDir->pcListing);
+    oNDir->pcListing = pcListing;
+    oNDir->ulListingLength = ulLength;
+    free(oNDir->poNOrder);
+    oNDir->poNOrder = poNOrder;
+    free(oNDir->pulOrderEnds);
+    oNDir->pulOrderEnds = pulOrderEnds;
+    oNDir->ulOrderLength = ulChildren;
+    oNDir->ulOrderFiles = ulFiles;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+int Node_refreshListing(Node_T oNDir, size_t *pulLength) {
+    size_t ulTotal;
+    size_t ulCount;
+    size_t i;
+
+    assert(oNDir != NULL);
+    assert(oNDir->type == IS_DIRECTORY);
+    assert(pulLength != NULL);
+
+    /* nothing changed below oNDir since its length was computed */
+    if(!Node_takeFlag(&oNDir->bSubtreeStale)) {
+        *pulLength = oNDir->ulSubtreeLength;
+        return SUCCESS;
+    }
+
+    /* take the flags before reading the children they describe */
+    if(Node_takeFlag(&oNDir->bListingStale) &&
+       Node_buildListing(oNDir, Epoch_load(&oNDir->oDChildren))
+       != SUCCESS) {
+        Epoch_store(&oNDir->bListingStale, TRUE);
+        Epoch_store(&oNDir->bSubtreeStale, TRUE);
+        return MEMORY_ERROR;
+    }
+
+    /* the files' lines are in oNDir's own; add each directory's */
+    ulTotal = oNDir->ulListingLength;
+    ulCount = 0;
+    for(i = 0; i < oNDir->ulOrderLength; i++) {
+        Node_T oNChild = oNDir->poNOrder[i];
+        size_t ulChildLength;
+
+        if(oNChild->type == IS_FILE)
+            ulCount++;
+        else if(Node_refreshListing(oNChild, &ulChildLength)
+                != SUCCESS) {
+            Epoch_store(&oNDir->bSubtreeStale, TRUE);
+            return MEMORY_ERROR;
+        }
+        else {
+            ulTotal += ulChildLength;
+            ulCount += oNChild->ulSubtreeCount;
+        }
+        oNDir->pulOrderEnds[i] = ulCount;
+    }
+
+    oNDir->ulSubtreeLength = ulTotal;
+    oNDir->ulSubtreeCount = ulCount + 1;
+    *pulLength = ulTotal;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+int Node_refreshOwnListing(Node_T oNDir, size_t *pulLength) {
+    assert(oNDir != NULL);
+    assert(oNDir->type == IS_DIRECTORY);
+    assert(pulLength != NULL);
+
+    /* a stale listing always comes with a stale subtree, whose flag
+       is left set so that the lengths are recomputed later */
+    if(Node_takeFlag(&oNDir->bListingStale) &&
+       Node_buildListing(oNDir, Epoch_load(&oNDir->oDChildren))
+       != SUCCESS) {
+        Epoch_store(&oNDir->bListingStale, TRUE);
+        return MEMORY_ERROR;
+    }
+    *pulLength = oNDir->ulListingLength;
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+const char *Node_getListing(Node_T oNDir, size_t *pulLength) {
+    assert(oNDir != NULL);
+    assert(oNDir->type == IS_DIRECTORY);
+    assert(oNDir->pcListing != NULL);
+    assert(pulLength != NULL);
+
+    *pulLength = oNDir->ulListingLength;
+    return oNDir->pcListing;
+}
+
+/* ------------------------------------------------------------------ */
+
+size_t Node_getListingCount(Node_T oNDir) {
+    assert(oNDir != NULL);
+    assert(oNDir->type == IS_DIRECTORY);
+
+    return oNDir->ulSubtreeCount;
+}
+
+/* ------------------------------------------------------------------ */
+
+Node_T Node_getListingChild(Node_T oNDir, size_t ulIndex,
+                            size_t *pulBefore) {
+    size_t ulLow = 0;
+    size_t ulHigh;
+
+    assert(oNDir != NULL);
+    assert(oNDir->type == IS_DIRECTORY);
+    assert(pulBefore != NULL);
+
+    /* the first child whose part of the listing ends after ulIndex */
+    ulHigh = oNDir->ulOrderLength;
+    while(ulLow < ulHigh) {
+        size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+        if(oNDir->pulOrderEnds[ulMid] <= ulIndex)
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    if(ulLow == oNDir->ulOrderLength)
+        return NULL;
+
+    *pulBefore = ulLow == 0 ? 0 : oNDir->pulOrderEnds[ulLow - 1];
+    return oNDir->poNOrder[ulLow];
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Node_getListingRank(Node_T oNDir, Node_T oNChild,
+                            size_t *pulBefore) {
+    size_t ulLow;
+    size_t ulHigh;
+
+    assert(oNDir != NULL);
+    assert(oNDir->type == IS_DIRECTORY);
+    assert(oNChild != NULL);
+    assert(pulBefore != NULL);
+
+    /* files and directories are each sorted within their own run */
+    ulLow = 0;
+    ulHigh = oNDir->ulOrderFiles;
+    if(oNChild->type == IS_DIRECTORY) {
+        ulLow = ulHigh;
+        ulHigh = oNDir->ulOrderLength;
+    }
+    while(ulLow < ulHigh) {
+        size_t ulMid = ulLow + (ulHigh - ulLow) / 2;
+        int iCompare = Node_compare(oNDir->poNOrder[ulMid], oNChild);
+
+        if(iCompare == 0) {
+            *pulBefore = ulMid == 0 ? 0 : oNDir->pulOrderEnds[ulMid - 1];
+            return oNDir->poNOrder[ulMid] == oNChild;
+        }
+        if(iCompare < 0)
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    return FALSE;
+}
+
+/* ------------------------------------------------------------------ */
+
 char *Node_toString(Node_T oNNode) {
    char *copyPath;
 
@@ -316,6 +1072,64 @@ char *Node_toString(Node_T oNNode) {
 
 /* ------------------------------------------------------------------ */
 
+/*
+  Releases the file oNNode's reference to its old contents, pvContent,
+  once readers that might have loaded it are done. Used as an
+  Epoch_retire callback.
+*/
+static void Node_releaseContent(void *pvContent) {
+    Content_release(pvContent);
+}
+
+/*
+  Makes oContent, to which the caller has given oNNode a reference, or
+  NULL, the buffer oNNode owns, releasing the old one after readers
+  leave.
+*/
+static void Node_swapContent(Node_T oNNode, Content_T oContent) {
+    Content_T oOldContent;
+
+    assert(oNNode != NULL);
+
+    oOldContent = oNNode->oContent;
+    /* a reader that loads the new buffer sees the pin cleared */
+    if(oContent != oOldContent)
+        Epoch_store(&oNNode->bPinned, FALSE);
+    Epoch_store(&oNNode->oContent, oContent);
+    if(oOldContent != NULL)
+        Epoch_retire(oOldContent, Node_releaseContent);
+}
+
+/*
+  Makes pvContents and ulSize the contents and size of file oNNode
+  together, for Node_getContentsAndSize. Writers never overlap, since
+  each holds the lock of oNNode's parent in thread-safe builds.
+*/
+static void Node_publishContents(Node_T oNNode, void *pvContents,
+                                 size_t ulSize) {
+    assert(oNNode != NULL);
+
+#ifdef FT_THREADSAFE
+    {
+        unsigned long ulSeq = oNNode->ulContentsSeq;
+
+        __atomic_store_n(&oNNode->ulContentsSeq, ulSeq + 1,
+                         __ATOMIC_RELAXED);
+        /* keeps the stores below from overtaking the odd count */
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        Epoch_store(&oNNode->pvContents, pvContents);
+        Epoch_store(&oNNode->ulSize, ulSize);
+        __atomic_store_n(&oNNode->ulContentsSeq, ulSeq + 2,
+                         __ATOMIC_RELEASE);
+    }
+#else
+    oNNode->pvContents = pvContents;
+    oNNode->ulSize = ulSize;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
 int Node_insertFileContents(Node_T oNNode, void *pvContents, size_t 
 ulLength){
     assert(oNNode !=NULL);
@@ -323,17 +1137,137 @@ ulLength){
     if (oNNode -> type == IS_DIRECTORY)
         return BAD_PATH;
     
-    oNNode -> pvContents = pvContents;
-    oNNode -> ulSize = ulLength;
+    Node_publishContents(oNNode, pvContents, ulLength);
+    Node_swapContent(oNNode, NULL);
+
+    return SUCCESS;
+}
+
+/* ------------------------------------------------------------------ */
+
+int Node_setContent(Node_T oNNode, Content_T oContent) {
+    assert(oNNode != NULL);
+    assert(oContent != NULL);
+
+    if(oNNode->type == IS_DIRECTORY)
+        return BAD_PATH;
+
+    Node_swapContent(oNNode, Content_retain(oContent));
+    Node_publishContents(oNNode, (void *) Content_getData(oContent),
+                         Content_getLength(oContent));
 
     return SUCCESS;
 }
 
 /* ------------------------------------------------------------------ */
 
+Content_T Node_getContent(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return Epoch_load(&oNNode->oContent);
+}
+
+/* ------------------------------------------------------------------ */
+
+void Node_updateSize(Node_T oNNode) {
+    assert(oNNode != NULL);
+    assert(oNNode->oContent != NULL);
+
+    Node_publishContents(oNNode, oNNode->pvContents,
+                         Content_getLength(oNNode->oContent));
+}
+
+/* ------------------------------------------------------------------ */
+
+void Node_markUsed(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+#ifdef FT_THREADSAFE
+    /* readers mostly find the mark set, so only load it then */
+    if(!__atomic_load_n(&oNNode->bUsed, __ATOMIC_RELAXED))
+        __atomic_store_n(&oNNode->bUsed, TRUE, __ATOMIC_RELAXED);
+#else
+    oNNode->bUsed = TRUE;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+void Node_pin(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    Epoch_store(&oNNode->bPinned, TRUE);
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Node_isPinned(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return Epoch_load(&oNNode->bPinned);
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Node_clearUsed(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+#ifdef FT_THREADSAFE
+    return __atomic_exchange_n(&oNNode->bUsed, FALSE, __ATOMIC_RELAXED);
+#else
+    {
+        boolean bUsed = oNNode->bUsed;
+
+        oNNode->bUsed = FALSE;
+        return bUsed;
+    }
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
 void *Node_getContents(Node_T oNNode){
     assert(oNNode != NULL);
-    return oNNode -> pvContents;
+    return Epoch_load(&oNNode->pvContents);
+}
+
+/* ------------------------------------------------------------------ */
+
+void *Node_getContentsAndSize(Node_T oNNode, size_t *pulSize) {
+    void *pvContents;
+
+    assert(oNNode != NULL);
+    assert(pulSize != NULL);
+
+#ifdef FT_THREADSAFE
+    for(;;) {
+        unsigned long ulSeq = __atomic_load_n(&oNNode->ulContentsSeq,
+                                              __ATOMIC_ACQUIRE);
+
+        pvContents = Epoch_load(&oNNode->pvContents);
+        *pulSize = Epoch_load(&oNNode->ulSize);
+        /* keeps the loads above from drifting past the check */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(ulSeq % 2 == 0 &&
+           __atomic_load_n(&oNNode->ulContentsSeq, __ATOMIC_RELAXED)
+           == ulSeq)
+            return pvContents;
+    }
+#else
+    pvContents = oNNode->pvContents;
+    *pulSize = oNNode->ulSize;
+    return pvContents;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+
+boolean Node_hasInlineContents(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    return (boolean) (oNNode->bInline &&
+                      Epoch_load(&oNNode->pvContents) ==
+                      (void *) (oNNode + 1));
 }
 
 /* ------------------------------------------------------------------ */
@@ -347,5 +1281,5 @@ nodeType Node_getType(Node_T oNNode){
 
 size_t Node_getSize(Node_T oNNode) {
     assert(oNNode != NULL);
-    return oNNode -> ulSize;
+    return Epoch_load(&oNNode->ulSize);
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include <stddef.h>
 #include "a4def.h"
 #include "path.h"
+#include "dynarray.h"
+#include "content.h"
 
 
 /* A Node_T is a node in a Directory Tree */
@@ -29,10 +31,66 @@ typedef struct node *Node_T;
 int Node_new(Path_T oPPath, nodeType type, Node_T oNParent,
              Node_T *poNResult);
 
+/*
+  Creates a new node with nodeType type and path oPPath that is not
+  linked under any parent; it is later attached with Node_link or
+  Node_adoptChildren. Returns an int SUCCESS status and sets *poNResult
+  to be the new node if successful. Otherwise, sets *poNResult to NULL
+  and returns status:
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  * NO_SUCH_PATH if oPPath is of depth 0
+*/
+int Node_newUnlinked(Path_T oPPath, nodeType type, Node_T *poNResult);
+
+/*
+  Creates a new unlinked file node, as Node_newUnlinked does, with a
+  copy of the ulLength (> 0) bytes at pvData as its contents, held in
+  the node's own allocation so reading them touches no other memory.
+  The copy is never written; giving the file other contents leaves it
+  unused until the node is freed. Returns SUCCESS or a status as
+  Node_newUnlinked does.
+*/
+int Node_newInline(Path_T oPPath, const void *pvData, size_t ulLength,
+                   Node_T *poNResult);
+
+/*
+  Links oNChild, which is not yet linked under any parent, into
+  oNParent's children. In thread-safe builds the caller must hold
+  oNParent's lock if oNParent is in a tree; oNChild and whatever has
+  been linked under it become visible to readers all at once. Returns
+  SUCCESS, or leaves oNChild unlinked and returns status:
+  * NOT_A_DIRECTORY if oNParent is a file
+  * CONFLICTING_PATH if oNParent's path is not an ancestor of oNChild's
+  * NO_SUCH_PATH if oNParent's path is not oNChild's direct parent
+  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_link(Node_T oNParent, Node_T oNChild);
+
+/*
+  Makes every unlinked node in oDPending from index ulFirst onward a
+  child of directory oNParent, in order, and removes them from
+  oDPending. Those nodes must be direct children of oNParent, sorted
+  and distinct, and oNParent must not have any children yet. The new
+  child array is allocated with exactly the number of adopted nodes.
+  Returns SUCCESS, or NOT_A_DIRECTORY if oNParent is a file, or
+  MEMORY_ERROR if the child array could not be allocated (in which
+  case neither oNParent nor oDPending is changed).
+*/
+int Node_adoptChildren(Node_T oNParent, DynArray_T oDPending,
+                       size_t ulFirst);
+
 /*
   Destroys and frees all memory allocated for the subtree rooted at
   oNNode, i.e., deletes this node and all its descendents. Returns the
-  number of nodes deleted.
+  number of nodes deleted, or 0 if memory to unlink oNNode from its
+  parent could not be allocated, in which case the subtree is left as
+  it was (this happens only in thread-safe builds, and never for a
+  node with no parent). In thread-safe builds the caller must hold
+  the lock of oNNode's parent (if any); every node in the subtree is
+  marked removed, waiting for writers already inside it to finish, and
+  the subtree is unlinked immediately but freed only after concurrent
+  readers leave.
 */
 size_t Node_free(Node_T oNNode);
 
@@ -51,6 +109,29 @@ Path_T Node_getPath(Node_T oNNode);
 boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
                          size_t *pulChildID);
 
+/*
+  Returns TRUE and sets *poNResult to the child of oNParent whose
+  final path component is the ulLength characters at pcName (which
+  need not be '\0'-terminated). Otherwise returns FALSE and sets
+  *poNResult to NULL. Allocates no memory, and reads a single
+  consistent snapshot of the children, so it is safe for lock-free
+  readers in thread-safe builds (unlike Node_hasChild followed by
+  Node_getChild, which only writers may use).
+*/
+boolean Node_findChild(Node_T oNParent, const char *pcName,
+                       size_t ulLength, Node_T *poNResult);
+
+/*
+  Searches oDChildren, a child array returned by Node_getChildren, for
+  the child whose final path component is the ulLength characters at
+  pcName. Returns TRUE and stores its index in *pulIndex if there is
+  one; otherwise returns FALSE and stores in *pulIndex the index such
+  a child would have, i.e., that of the first child whose name sorts
+  after pcName. Takes O(log n) time for n children.
+*/
+boolean Node_findChildIndex(DynArray_T oDChildren, const char *pcName,
+                            size_t ulLength, size_t *pulIndex);
+
 /* Returns an int SUCCESS status and sets *pulNum to be the number
 of children of oNParent if oNParent is a directory, otherwise returns
 NOT_A_DIRECTORY. */
@@ -65,6 +146,104 @@ int Node_getNumChildren(Node_T oNParent, size_t *pulNum);
 int Node_getChild(Node_T oNParent, size_t ulChildID,
                   Node_T *poNResult);
 
+/*
+  Returns oNParent's children, sorted by path, or NULL if oNParent is
+  a file. The array belongs to oNParent and must not be modified. In
+  thread-safe builds it is an immutable snapshot, valid until the
+  caller's epoch critical section ends; otherwise it is valid until
+  oNParent's children next change.
+*/
+DynArray_T Node_getChildren(Node_T oNParent);
+
+/*
+  Node_lock and Node_unlock acquire and release oNNode's writer lock.
+  In thread-safe builds, a writer holds a directory's lock while it
+  adds or removes that directory's children or replaces the contents
+  of one of its files; locks are always taken parent before child.
+  Readers never take them. Otherwise both do nothing.
+*/
+void Node_lock(Node_T oNNode);
+void Node_unlock(Node_T oNNode);
+
+/*
+  Returns TRUE if oNNode has been removed from its tree by Node_free,
+  in which case a writer that reached it by a lock-free lookup must
+  start over. The caller must hold oNNode's lock. Always FALSE unless
+  built with FT_THREADSAFE.
+*/
+boolean Node_isRemoved(Node_T oNNode);
+
+/*
+  Node_getIndexData and Node_setIndexData get and set oNNode's index
+  slot, which a name index (see nameindex.h) uses to find oNNode's
+  place in it. The slot is NULL until set, and is not otherwise used
+  or freed by the node; its users serialize access to it.
+*/
+void *Node_getIndexData(Node_T oNNode);
+void Node_setIndexData(Node_T oNNode, void *pvIndex);
+
+/*
+  Brings the cached listing of the subtree rooted at directory oNDir
+  up to date, and stores the length of that subtree's part of the FT
+  listing in *pulLength. Only directories whose children changed since
+  the last call are rebuilt, and only subtrees containing one are
+  visited, so the cost grows with the change rather than with the
+  subtree. Returns SUCCESS, or MEMORY_ERROR if a rebuild could not be
+  allocated (the rest of the cache stays valid, and a later call
+  retries). In thread-safe builds, calls for the same tree must be
+  serialized by the caller, inside an epoch critical section; writers
+  may run concurrently, and what they change is picked up next time.
+*/
+int Node_refreshListing(Node_T oNDir, size_t *pulLength);
+
+/*
+  Brings the cached lines of directory oNDir's own listing (see
+  Node_getListing) up to date, and stores their length in *pulLength,
+  without visiting its subtree, whose length is left for
+  Node_refreshListing to recompute. Returns SUCCESS or MEMORY_ERROR,
+  as Node_refreshListing does, under the same serialization.
+*/
+int Node_refreshOwnListing(Node_T oNDir, size_t *pulLength);
+
+/*
+  Returns the cached lines of the FT listing that belong to directory
+  oNDir itself, i.e., its path and then its files' paths, each
+  followed by a newline and not '\0'-terminated, and stores their
+  length in *pulLength. oNDir's listing must have been refreshed by
+  Node_refreshListing, under the same serialization.
+*/
+const char *Node_getListing(Node_T oNDir, size_t *pulLength);
+
+/*
+  Node_getListingCount, Node_getListingChild, and Node_getListingRank
+  give random access to the cached listing of directory oNDir's
+  subtree, which must have been refreshed by Node_refreshListing,
+  under the same serialization. Entries are numbered from 0 in
+  listing order, with oNDir's own path as entry 0.
+*/
+
+/* Returns the number of entries in oNDir's subtree listing. */
+size_t Node_getListingCount(Node_T oNDir);
+
+/*
+  Returns the child of oNDir whose part of the subtree listing holds
+  entry ulIndex + 1 (the entry ulIndex places after oNDir's own), and
+  stores in *pulBefore the number of entries between oNDir's own and
+  that child's part; or returns NULL if there is no such entry. Takes
+  O(log n) time for n children.
+*/
+Node_T Node_getListingChild(Node_T oNDir, size_t ulIndex,
+                            size_t *pulBefore);
+
+/*
+  Returns TRUE and stores in *pulBefore the number of entries between
+  oNDir's own and child oNChild's part of the subtree listing, or
+  returns FALSE if oNChild is not among the children the listing was
+  built from. Takes O(log n) time for n children.
+*/
+boolean Node_getListingRank(Node_T oNDir, Node_T oNChild,
+                            size_t *pulBefore);
+
 /*
   Returns a the parent node of oNNode.
   Returns NULL if oNNode is the root and thus has no parent.
@@ -97,10 +276,70 @@ Otherwise return SUCCESS.*/
 int Node_insertFileContents(Node_T oNNode, void *pvContents, size_t 
 ulLength);
 
+/*
+  Makes oContent the contents of file oNNode, which takes a reference
+  to it, and returns SUCCESS; or returns BAD_PATH if oNNode is a
+  directory. Whatever oNNode held before is released, in thread-safe
+  builds only once concurrent readers leave. (Node_insertFileContents
+  likewise releases a buffer oNNode owned.) In thread-safe builds the
+  caller must hold the lock of oNNode's parent.
+*/
+int Node_setContent(Node_T oNNode, Content_T oContent);
+
+/*
+  Returns the buffer file oNNode owns a reference to, or NULL if its
+  contents are borrowed from the caller of Node_insertFileContents or
+  oNNode is a directory. Lock-free readers in thread-safe builds may
+  take their own reference to it with Content_retain until their
+  epoch critical section ends.
+*/
+Content_T Node_getContent(Node_T oNNode);
+
+/*
+  Records the current length of the writable buffer file oNNode owns
+  as its size, after the caller, holding the lock of oNNode's parent
+  in thread-safe builds, wrote to the buffer in place.
+*/
+void Node_updateSize(Node_T oNNode);
+
+/*
+  Node_markUsed marks file oNNode's contents as used, and
+  Node_clearUsed clears the mark and returns whether it was set, so
+  that a periodic sweep can tell contents used since the last one from
+  cold ones. Either may be called from any thread without locks.
+*/
+void Node_markUsed(Node_T oNNode);
+boolean Node_clearUsed(Node_T oNNode);
+
+/*
+  Node_pin marks the buffer file oNNode owns as having had its bytes
+  handed out, so that a sweep leaves it in place, until oNNode owns
+  another; Node_isPinned returns whether it is marked. In thread-safe
+  builds the caller of Node_pin must hold the lock of oNNode's parent,
+  and Node_isPinned, which may be called without it, sees the mark
+  cleared once it sees the buffer replaced.
+*/
+void Node_pin(Node_T oNNode);
+boolean Node_isPinned(Node_T oNNode);
+
+/*
+  Returns TRUE if oNNode's contents are still the copy Node_newInline
+  made in its own allocation, or FALSE otherwise.
+*/
+boolean Node_hasInlineContents(Node_T oNNode);
+
 /*  Return a pointer to the contents of oNNode.*/
 void *Node_getContents(Node_T oNNode);
 
 /*  Return the size in bytes of oNNode's contents.*/
 size_t Node_getSize(Node_T oNNode);
 
+/*
+  Returns a pointer to the contents of oNNode and stores their size in
+  *pulSize, both as of the same moment. Lock-free readers in
+  thread-safe builds need this: a writer may replace the contents
+  between separate calls to Node_getContents and Node_getSize.
+*/
+void *Node_getContentsAndSize(Node_T oNNode, size_t *pulSize);
+
 #endif